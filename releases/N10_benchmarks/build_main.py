@@ -0,0 +1,23 @@
+import sys
+from pathlib import Path
+sys.path.append(str(Path(__file__).resolve().parents[2])) 
+sys.path.append(str(Path(__file__).resolve().parents[0])) 
+
+import vicmil_lib.N1_vicmil_std_lib as build
+
+builder = build.CppBuilder()
+
+current_path = build.path_traverse_up(__file__, 0)
+
+builder.N1_add_compiler_path_arg("g++")
+builder.N2_add_cpp_file_arg(current_path + "/main.cpp")
+builder.N3_add_optimization_level(3)
+builder.add_argument("-march=native") # Use AVX if the processor supports it
+builder.add_argument("-pthread")
+builder.N9_add_output_file_arg(current_path + "/a.out")
+
+build.change_active_directory(current_path)
+build.delete_file("a.out")
+builder.build()
+
+build.run_command("./a.out " + " ".join(sys.argv[1:]))
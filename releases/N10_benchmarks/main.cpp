@@ -0,0 +1,60 @@
+#define USE_DEBUG
+#define DEBUG_KEYWORDS "!vicmil_lib,main()" 
+#define USE_BENCHMARKS
+#include "../../source/N15_convex_collision.h"
+#include <fstream>
+
+/**
+ * Measure how fast the collision and dynamics functions are, see BenchmarkWrapper in L2_test.h
+ * Usage: ./a.out [results_file] [baseline_file] [keywords]
+ *  The results are written as csv to results_file(benchmark_results.csv by default)
+ *  If a baseline file from an earlier run is given, each benchmark is compared to it
+ *  keywords selects which benchmarks to run, e.g. "N5_collision" or "get_cube_cube", by default all are run
+*/
+
+// Read the median of each benchmark from a results file
+std::map<std::string, double> read_baseline_medians_ns(const std::string& filename) {
+    std::map<std::string, double> medians_ns;
+    std::vector<std::string> lines = vicmil::read_file_contents_line_by_line(filename);
+    for(int i = 1; i < lines.size(); i++) {
+        size_t name_end = lines[i].find("\",");
+        if(lines[i].size() == 0 || lines[i][0] != '"' || name_end == std::string::npos) {
+            continue;
+        }
+        std::string name = lines[i].substr(1, name_end - 1);
+        std::vector<std::string> values = vicmil::split_string(lines[i].substr(name_end + 2), ',');
+        if(values.size() >= 3) {
+            medians_ns[name] = std::atof(values[2].c_str());
+        }
+    }
+    return medians_ns;
+}
+
+int main(int argc, char *argv[]) {
+    std::string results_filename = "benchmark_results.csv";
+    std::string baseline_filename = "";
+    std::string keywords = ".";
+    if(argc > 1) results_filename = argv[1];
+    if(argc > 2) baseline_filename = argv[2];
+    if(argc > 3) keywords = argv[3];
+
+    std::vector<vicmil::BenchmarkResult> results = vicmil::BenchmarkClass::run_all_benchmarks(vicmil::split_string(keywords, ','));
+    std::ofstream results_file = std::ofstream(results_filename, std::ios::out | std::ios::trunc);
+    vicmil::BenchmarkClass::write_results_csv(results, results_file);
+    std::cout << "results written to " << results_filename << std::endl;
+
+    if(baseline_filename != "") {
+        std::map<std::string, double> baseline_medians_ns = read_baseline_medians_ns(baseline_filename);
+        std::cout << "compared to " << baseline_filename << ":" << std::endl;
+        for(int i = 0; i < results.size(); i++) {
+            if(baseline_medians_ns.count(results[i].name) == 0) {
+                std::cout << results[i].name << ": not in baseline" << std::endl;
+                continue;
+            }
+            double baseline_ns = baseline_medians_ns[results[i].name];
+            std::cout << results[i].name << ": " << baseline_ns << "ns -> " << results[i].median_ns << "ns  (" 
+                << baseline_ns / results[i].median_ns << "x speedup)" << std::endl;
+        }
+    }
+    return 0;
+}
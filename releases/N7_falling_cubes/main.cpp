@@ -6,12 +6,12 @@ using namespace vicmil;
 
 FPSCounter fps_counter;
 
-// Used when applying force
-std::vector<Cube> cubes;
-Plane ground_plane;
-glm::dvec3 gravity_m_s2 = glm::dvec3(0, -1, 0);
+// Holds all the cubes and the ground plane
+World world;
 
-const int FPS = 30;
+// The physics runs at a fixed rate, independent of how fast the frames are drawn
+const int UPDATES_PER_S = 240;
+const int MAX_UPDATES_PER_FRAME = 16;
 bool start_pressed = false;
 
 void render() {
@@ -24,15 +24,16 @@ void render() {
     double screen_aspect_ratio = vicmil::app::globals::screen_width / vicmil::app::globals::screen_height;
     vicmil::app::globals::main_app->camera.screen_aspect_ratio = screen_aspect_ratio;
 
-    // Draw cubes
-    for(int i = 0; i < cubes.size(); i++) {
-        ModelOrientation cube_orientation = get_model_orientation_from_obj_trajectory(cubes[i].trajectory);
+    // Draw cubes, in between the last two updates so the motion looks smooth
+    double interpolation_factor = vicmil::app::get_game_update_interpolation_factor();
+    for(int i = 0; i < world.cubes.size(); i++) {
+        ModelOrientation cube_orientation = get_model_orientation_from_obj_orientation(world.get_interpolated_orientation(i, interpolation_factor));
         vicmil::app::draw_3d_model(graphics_help::BLUE_CUBE_INDEX, cube_orientation, 0.5);
     }
 
     // Draw ground plane
     ModelOrientation ground_orientation = ModelOrientation();
-    ground_orientation.position = ground_plane.point;
+    ground_orientation.position = world.planes[0].point;
     vicmil::app::draw_3d_model(graphics_help::RED_PLANE_INDEX, ground_orientation, 100);
 
 
@@ -72,20 +73,10 @@ void render() {
         -0.9, 0.8, 0.02, screen_aspect_ratio);
 }
 
-// Runs at a fixed framerate
+// Runs UPDATES_PER_S times per second, possibly several times per frame
 void game_loop() {
     if(start_pressed) {
-        for(int i = 0; i < cubes.size(); i++) {
-            apply_acceleration(gravity_m_s2, 1.0 / FPS, cubes[i].trajectory);
-            cubes[i].trajectory.move_time_step_s(1.0 / FPS);
-        }
-
-        for(int i = 0; i < cubes.size(); i++) {
-            for(int i2 = 0; i2 < i; i2++) {
-                handle_cube_cube_collision(cubes[i], cubes[i2], 1.0);
-            }
-            handle_cube_plane_collision(cubes[i], ground_plane, 0.8);
-        }
+        world.step(1.0 / UPDATES_PER_S);
     }
 }
 
@@ -93,9 +84,15 @@ void init() {
     Debug("C++ init!");
     vicmil::app::set_render_func(VoidFuncRef(render));
     vicmil::app::set_game_update_func(VoidFuncRef(game_loop));
-    vicmil::app::set_game_updates_per_second(FPS);
+    vicmil::app::set_game_updates_per_second(UPDATES_PER_S);
+    vicmil::app::set_max_game_updates_per_frame(MAX_UPDATES_PER_FRAME);
     fps_counter = FPSCounter();
 
+    world = World();
+    world.gravity_m_s2 = glm::dvec3(0, -1, 0);
+    world.cube_cube_restitution_constant = 1.0;
+    world.cube_plane_restitution_constant = 0.8;
+    std::vector<Cube>& cubes = world.cubes;
     cubes.resize(10);
 
     srand(time(0));
@@ -117,8 +114,10 @@ void init() {
         cubes[i].mass_kg = 10;
     }
 
+    Plane ground_plane;
     ground_plane.point = glm::dvec3(0, 0, 0);
     ground_plane.normal = glm::dvec3(0, 1, 0);
+    world.planes.push_back(ground_plane);
 
     vicmil::app::globals::main_app->camera.position.y = 6;
 }
@@ -1,26 +1,81 @@
 """
 Plot the data that was recieved from the collision simulation
+The data is a binary recording, see source/N13_trajectory_recording.h for the layout
 """
 import matplotlib.pyplot as plt
 import numpy as np
-import json
+import struct
 import sys
 from pathlib import Path
 import pathlib
-sys.path.append(str(Path(__file__).resolve().parents[0])) 
+sys.path.append(str(Path(__file__).resolve().parents[0]))
+
+
+def read_fields(data, offset):
+    fields = []
+    field_count = struct.unpack_from("<I", data, offset)[0]
+    offset += 4
+    for i in range(field_count):
+        name_length = struct.unpack_from("<I", data, offset)[0]
+        offset += 4
+        name = data[offset:offset + name_length].decode()
+        offset += name_length
+        value_count = struct.unpack_from("<I", data, offset)[0]
+        offset += 4
+        fields.append((name, value_count))
+    return fields, offset
+
+
+def read_recording(filename):
+    """
+    Read a recording, returns the step values as {field name: array with one row per step}
+    and the cube values as {field name: array with shape (step, cube, value)}
+    """
+    with open(filename, "rb") as f:
+        data = f.read()
+    if data[0:8] != b"CUBEREC\0":
+        raise ValueError("Not a cube trajectory recording")
+    offset = 12 # Skip the version
+    step_fields, offset = read_fields(data, offset)
+    cube_fields, offset = read_fields(data, offset)
+    step_value_count = sum(value_count for name, value_count in step_fields)
+    cube_value_count = sum(value_count for name, value_count in cube_fields)
+
+    step_rows = []
+    cube_rows = []
+    while offset < len(data):
+        step_count, cube_count = struct.unpack_from("<II", data, offset + 4)
+        offset += 12
+        values_per_step = step_value_count + cube_count * cube_value_count
+        chunk = np.frombuffer(data, dtype="<f8", count=step_count * values_per_step, offset=offset)
+        chunk = chunk.reshape(step_count, values_per_step)
+        offset += chunk.nbytes
+        step_rows.append(chunk[:, :step_value_count])
+        cube_rows.append(chunk[:, step_value_count:].reshape(step_count, cube_count, cube_value_count))
+
+    step_values = np.concatenate(step_rows)
+    cube_values = np.concatenate(cube_rows)
+    steps = {}
+    start = 0
+    for name, value_count in step_fields:
+        steps[name] = step_values[:, start:start + value_count]
+        start += value_count
+    cubes = {}
+    start = 0
+    for name, value_count in cube_fields:
+        cubes[name] = cube_values[:, :, start:start + value_count]
+        start += value_count
+    return steps, cubes
 
 
 parents = pathlib.Path(__file__).parents
 dir_path = str(parents[0].resolve())
-with open(dir_path + '/falling_cube.json') as f:
-  data = json.load(f)
-
-print(data)
+steps, cubes = read_recording(dir_path + '/falling_cube.cuberec')
 
-x = data["time_data_s"]
-y1 = data["total_energy_data_J"]
-y2 = data["kinetic_energy_J"]
-y3 = data["potential_energy_J"]
+x = steps["time_s"][:, 0]
+y2 = cubes["kinetic_energy_J"].sum(axis=(1, 2))
+y3 = cubes["potential_energy_J"].sum(axis=(1, 2))
+y1 = y2 + y3
 
 plt.plot(x, y1, label="total energy")
 plt.plot(x, y2, label ="kinetic energy")
@@ -30,4 +85,4 @@ plt.title("Dropped cube energy plot")
 plt.legend()
 plt.xlabel("Time[s]")
 plt.ylabel("Energy[joule]")
-plt.show()
\ No newline at end of file
+plt.show()
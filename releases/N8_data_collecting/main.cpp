@@ -6,21 +6,16 @@ using namespace vicmil;
 
 FPSCounter fps_counter;
 
-// Used when applying force
-Cube cube;
-Plane ground_plane;
-glm::dvec3 gravity_m_s2 = glm::dvec3(0, -1, 0);
+// Holds the cube and the ground plane
+World world;
 
 const int FPS = 30;
 bool start_pressed = false;
-ContactImpulse cube_impulse = ContactImpulse::zero();
 
-// Save the simulation data over time
-std::vector<double> time_data_s = {};
-std::vector<double> total_energy_J = {};
-std::vector<double> potential_energy_J = {};
-std::vector<double> kinetic_energy_J = {};
-double simulated_time = 0;
+// Save the simulation data over time, it is written to the file in chunks while the simulation runs
+const std::string RECORDING_FILENAME = "falling_cube.cuberec";
+std::ofstream recording_file;
+TrajectoryRecordingWriter recording_writer;
 
 
 void render() {
@@ -34,12 +29,12 @@ void render() {
     vicmil::app::globals::main_app->camera.screen_aspect_ratio = screen_aspect_ratio;
 
     // Draw cube
-    ModelOrientation cube_orientation = get_model_orientation_from_obj_trajectory(cube.trajectory);
+    ModelOrientation cube_orientation = get_model_orientation_from_obj_trajectory(world.cubes[0].trajectory);
     vicmil::app::draw_3d_model(graphics_help::BLUE_CUBE_INDEX, cube_orientation, 0.5);
 
     // Draw ground plane
     ModelOrientation sphere_orientation = ModelOrientation();
-    sphere_orientation.position = ground_plane.point;
+    sphere_orientation.position = world.planes[0].point;
     vicmil::app::draw_3d_model(graphics_help::RED_PLANE_INDEX, sphere_orientation, 100);
 
 
@@ -50,7 +45,6 @@ void render() {
     MouseState mouse_state = MouseState();
     info_str += "   x: " + std::to_string(vicmil::x_pixel_to_opengl(mouse_state.x(), screen_width_pixels));
     info_str += "   y: " + std::to_string(vicmil::y_pixel_to_opengl(mouse_state.y(), screen_height_pixels));
-    info_str += "   impulse: " + std::to_string(glm::length(cube_impulse.impulse.impulse_newton_s));
 
     vicmil::app::draw2d_text(info_str, -1.0, 1.0, 0.02, screen_aspect_ratio);
 
@@ -65,16 +59,16 @@ void render() {
 
     text_button.draw();
     if(text_button.is_pressed(mouse_state) && start_pressed == false) {
-        cube.trajectory.orientation.rotational_orientation =
-            cube.trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(0.02, glm::dvec3(1, 0, 0)));
+        world.cubes[0].trajectory.orientation.rotational_orientation =
+            world.cubes[0].trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(0.02, glm::dvec3(1, 0, 0)));
     }
 
     text_button.center_y = 0.1;
     text_button.text = "DOWN";
     text_button.draw();
     if(text_button.is_pressed(mouse_state) && start_pressed == false) {
-        cube.trajectory.orientation.rotational_orientation =
-            cube.trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(-0.02, glm::dvec3(1, 0, 0)));
+        world.cubes[0].trajectory.orientation.rotational_orientation =
+            world.cubes[0].trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(-0.02, glm::dvec3(1, 0, 0)));
     }
 
     text_button.center_y = 0.15;
@@ -82,8 +76,8 @@ void render() {
     text_button.text = "LEFT";
     text_button.draw();
     if(text_button.is_pressed(mouse_state) && start_pressed == false) {
-        cube.trajectory.orientation.rotational_orientation =
-            cube.trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(0.02, glm::dvec3(0, 1, 0)));
+        world.cubes[0].trajectory.orientation.rotational_orientation =
+            world.cubes[0].trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(0.02, glm::dvec3(0, 1, 0)));
     }
 
     text_button.center_y = 0.15;
@@ -91,8 +85,8 @@ void render() {
     text_button.text = "RIGHT";
     text_button.draw();
     if(text_button.is_pressed(mouse_state) && start_pressed == false) {
-        cube.trajectory.orientation.rotational_orientation =
-            cube.trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(-0.02, glm::dvec3(0, 1, 0)));
+        world.cubes[0].trajectory.orientation.rotational_orientation =
+            world.cubes[0].trajectory.orientation.rotational_orientation.rotate(Rotation::from_axis_rotation(-0.02, glm::dvec3(0, 1, 0)));
     }
 
 
@@ -108,16 +102,11 @@ void render() {
     text_button.text = "DOWNLOAD DATA";
     text_button.draw();
     if(text_button.is_pressed(mouse_state) && start_pressed == true) {
-        vicmil::browser::alert("Hello from c++");
-        vicmil::json::Json j = vicmil::json::Json();
-        j["description"] = "This is some energy data over time!";
-        j["time_data_s"] = time_data_s;
-        j["total_energy_data_J"] = total_energy_J;
-        j["kinetic_energy_J"] = kinetic_energy_J;
-        j["potential_energy_J"] = potential_energy_J;
-        
-        std::string json_str = j.to_string();
-        vicmil::browser::download_text_file("falling_cube.json", json_str);
+        recording_writer.flush();
+        FileManager recording_file_reader = FileManager(RECORDING_FILENAME);
+        unsigned int file_size = recording_file_reader.get_file_size();
+        recording_file_reader.set_read_write_position(0);
+        vicmil::browser::download_file(RECORDING_FILENAME, recording_file_reader.read_bytes(file_size));
     }
 
     vicmil::app::draw2d_text(
@@ -134,17 +123,10 @@ void render() {
 // Runs at a fixed framerate
 void game_loop() {
     if(start_pressed) {
-        apply_acceleration(gravity_m_s2, 1.0 / FPS, cube.trajectory);
-        cube.trajectory.move_time_step_s(1.0 / FPS);
-        cube_impulse = handle_cube_plane_collision(cube, ground_plane, 0.8);
+        world.step(1.0 / FPS);
 
         // Record the simulation data
-        time_data_s.push_back(simulated_time);
-        ObjectEnergyInfo cube_energy = get_cube_energy_information(cube, 1);
-        total_energy_J.push_back(cube_energy.potential_energy + cube_energy.linear_kin_energy + cube_energy.rotational_kin_energy);
-        kinetic_energy_J.push_back(cube_energy.linear_kin_energy + cube_energy.rotational_kin_energy);
-        potential_energy_J.push_back(cube_energy.potential_energy);
-        simulated_time += 1.0 / FPS;
+        recording_writer.record_step(world);
     }
 }
 
@@ -155,7 +137,14 @@ void init() {
     vicmil::app::set_game_updates_per_second(FPS);
     fps_counter = FPSCounter();
 
-    cube = Cube();
+    recording_file.open(RECORDING_FILENAME, std::ios::out | std::ios::binary | std::ios::trunc);
+    recording_writer = TrajectoryRecordingWriter(recording_file);
+
+    world = World();
+    world.gravity_m_s2 = glm::dvec3(0, -1, 0);
+    world.cube_plane_restitution_constant = 0.8;
+    world.cubes.push_back(Cube());
+    Cube& cube = world.cubes[0];
     cube.trajectory.orientation.center_of_mass.x = 0.0;
     cube.trajectory.orientation.center_of_mass.y = 4.0;
     cube.trajectory.orientation.center_of_mass.z = -15.0;
@@ -163,8 +152,10 @@ void init() {
     cube.side_length_m = 1;
     cube.mass_kg = 10;
 
+    Plane ground_plane;
     ground_plane.point = glm::dvec3(0, 0, 0);
     ground_plane.normal = glm::dvec3(0, 1, 0);
+    world.planes.push_back(ground_plane);
 
     vicmil::app::globals::main_app->camera.position.y = 6;
 }
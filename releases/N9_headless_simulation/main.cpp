@@ -0,0 +1,136 @@
+#define USE_DEBUG
+#define DEBUG_KEYWORDS "!vicmil_lib,main()" 
+#include "../../source/N14_scene_loading.h"
+#include <fstream>
+
+/**
+ * Run the falling cubes simulation without any graphics, as fast as the computer allows
+ * Usage: ./a.out [cube_count] [step_count] [time_step_s] [seed] [thread_count] [recording_file] [snapshot_file]
+ * If a recording file is given, every step is recorded to it(see N13_trajectory_recording.h), use "" to skip it
+ * If a snapshot file is given, the simulation continues from it if it exists, and is saved to it at the end
+ * Build with -DUSE_TRACING to also write a chrome trace of the steps to headless_trace.json
+ * Build with count_heap_allocations.cpp to count the heap allocations of each step, build_main.py adds it
+ *  when given --count-heap-allocations
+ * The first argument can also be a json scene file, then the cubes are loaded from it instead(see N14_scene_loading.h)
+ *  e.g. ./a.out falling_cubes_scene.json 1000
+*/
+
+World create_falling_cubes_world(int cube_count, unsigned int seed) {
+    World world;
+    world.cubes.resize(cube_count);
+
+    srand(seed);
+
+    // Spread the cubes out more if there are many of them
+    double spread = std::cbrt(cube_count / 10.0);
+    if(spread < 1.0) {
+        spread = 1.0;
+    }
+
+    for(int i = 0; i < world.cubes.size(); i++) {
+        world.cubes[i] = Cube();
+        world.cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(-2.0, 4.0, -15.0);
+        world.cubes[i].trajectory.orientation.center_of_mass += 
+            glm::dvec3((rand()%120)/40.0, (rand()%120)/20.0, (rand()%120)/40.0) * spread;
+
+        // Setup random rotation
+        double rad = 2 * vicmil::PI * (rand()%100) / 100.0;
+        glm::dvec3 axis = glm::dvec3((rand()%10000) / 10000.0, (rand()%10000) / 10000.0, (rand()%10000) / 10000.0);
+        world.cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation(rad, glm::normalize(axis));
+        
+        // Setup other properties
+        world.cubes[i].side_length_m = 1;
+        world.cubes[i].mass_kg = 10;
+    }
+
+    vicmil::Plane ground_plane;
+    ground_plane.point = glm::dvec3(0, 0, 0);
+    ground_plane.normal = glm::dvec3(0, 1, 0);
+    world.planes.push_back(ground_plane);
+
+    return world;
+}
+
+int main(int argc, char *argv[]) {
+    int cube_count = 10;
+    std::string scene_filename = "";
+    int step_count = 1000;
+    double time_step_s = 1.0 / 30;
+    unsigned int seed = 0;
+    int thread_count = 1;
+    if(argc > 1) {
+        std::string first_arg = argv[1];
+        if(first_arg.size() > 5 && first_arg.substr(first_arg.size() - 5) == ".json") {
+            scene_filename = first_arg;
+        }
+        else {
+            cube_count = std::atoi(argv[1]);
+        }
+    }
+    if(argc > 2) step_count = std::atoi(argv[2]);
+    if(argc > 3) time_step_s = std::atof(argv[3]);
+    if(argc > 4) seed = std::atoi(argv[4]);
+    if(argc > 5) thread_count = std::atoi(argv[5]);
+    std::string recording_filename = "";
+    if(argc > 6) recording_filename = argv[6];
+    std::string snapshot_filename = "";
+    if(argc > 7) snapshot_filename = argv[7];
+
+    World world;
+    if(scene_filename != "") {
+        try {
+            world = load_scene_file(scene_filename);
+        }
+        catch(const vicmil::json::JsonParseError& error) {
+            std::cout << scene_filename << ": " << error.what() << std::endl;
+            return 1;
+        }
+        cube_count = world.cubes.size();
+    }
+    else {
+        world = create_falling_cubes_world(cube_count, seed);
+    }
+    if(snapshot_filename != "" && world.load_snapshot(snapshot_filename)) {
+        std::cout << "continuing from " << snapshot_filename << " at " << world.simulated_time_s << "s" << std::endl;
+        cube_count = world.cubes.size();
+    }
+    world.thread_count = thread_count;
+    std::cout << "cubes: " << cube_count << "  steps: " << step_count << "  time step: " << time_step_s << "s"
+        << "  threads: " << thread_count << std::endl;
+    std::cout << "start    " << world.get_total_energy_information().to_string() << std::endl;
+
+    // Optionally record every step to a file, it is written as the simulation runs
+    std::ofstream recording_file;
+    TrajectoryRecordingWriter recording_writer;
+    if(recording_filename != "") {
+        recording_file.open(recording_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        recording_writer = TrajectoryRecordingWriter(recording_file);
+    }
+
+    double start_time_s = vicmil::get_steady_time_s();
+    for(int i = 0; i < step_count; i++) {
+        world.step(time_step_s);
+        if(recording_filename != "") {
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(world.phase_statistics, "record");
+            recording_writer.record_step(world);
+        }
+    }
+    recording_writer.flush();
+    double elapsed_time_s = vicmil::get_steady_time_s() - start_time_s;
+
+    if(snapshot_filename != "" && !world.save_snapshot(snapshot_filename)) {
+        std::cout << "could not save " << snapshot_filename << std::endl;
+    }
+
+#ifdef USE_TRACING
+    vicmil::Tracer::get().write_chrome_trace_file("headless_trace.json");
+#endif
+
+    std::cout << "end      " << world.get_total_energy_information().to_string() << std::endl;
+    std::cout << "last step " << world.step_counters.to_string() << std::endl;
+    std::cout << "sleeping " << world.sleep_manager.get_sleeping_count() << "/" << world.cubes.size() << " cubes" << std::endl;
+    std::cout << "simulated " << world.simulated_time_s << "s in " << elapsed_time_s << "s, " 
+        << step_count / elapsed_time_s << " steps/s" << std::endl;
+    world.phase_statistics.write_summary(std::cout);
+    return 0;
+}
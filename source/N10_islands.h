@@ -0,0 +1,206 @@
+/* Islands and sleeping
+ * Cubes that touch each other, directly or through other cubes, form an island. When all cubes in an island
+ * have been almost still for a while the whole island is put to sleep, and is not moved or collision tested
+ * until something touches it
+*/
+#include "N9_contact_solver.h"
+
+/**
+ * Keeps track of which elements belong to the same group, groups can be merged but never split
+*/
+class UnionFind {
+    std::vector<int> _parents;
+public:
+    void reset(int element_count) {
+        _parents.resize(element_count);
+        for(int i = 0; i < element_count; i++) {
+            _parents[i] = i;
+        }
+    }
+    int find(int element) {
+        while(_parents[element] != element) {
+            _parents[element] = _parents[_parents[element]]; // Point every other element to its grandparent, to keep the tree flat
+            element = _parents[element];
+        }
+        return element;
+    }
+    // The element with the lowest index becomes the root, so the result does not depend on the order of the merges
+    void merge(int element1, int element2) {
+        int root1 = find(element1);
+        int root2 = find(element2);
+        if(root1 < root2) {
+            _parents[root2] = root1;
+        }
+        else {
+            _parents[root1] = root2;
+        }
+    }
+};
+TestWrapper(TEST_UnionFind,
+    void test() {
+        UnionFind union_find;
+        union_find.reset(6);
+        union_find.merge(4, 1);
+        union_find.merge(2, 4);
+        union_find.merge(5, 3);
+        Assert(union_find.find(2) == 1);
+        Assert(union_find.find(4) == 1);
+        Assert(union_find.find(3) == 3);
+        Assert(union_find.find(5) == 3);
+        Assert(union_find.find(0) == 0);
+    }
+);
+
+/**
+ * Keep track of which cubes are sleeping
+ *  Sleeping cubes have zero velocity, and the world skips integrating them and testing them against each other
+*/
+class SleepManager {
+    std::vector<int> _still_step_counts; // How many steps in a row each cube has had low energy
+    std::vector<int> _sleeping_island_ids; // The island each cube was in when it fell asleep, -1 if it is awake
+    std::vector<std::vector<int>> _sleeping_island_cubes; // The cubes of each sleeping island, by island id
+    UnionFind _islands;
+
+    void _rebuild_sleeping_island_cubes() {
+        _sleeping_island_cubes.assign(_sleeping_island_ids.size(), std::vector<int>());
+        for(int i = 0; i < _sleeping_island_ids.size(); i++) {
+            if(is_sleeping(i)) {
+                _sleeping_island_cubes[_sleeping_island_ids[i]].push_back(i);
+            }
+        }
+    }
+public:
+    bool sleeping_enabled = true;
+    double sleep_energy_threshold_j_kg = 0.0005; // Kinetic energy per kg below which a cube counts as still
+    int sleep_step_count = 30; // How many steps all cubes in an island have to be still before it falls asleep
+
+    void resize(int cube_count) {
+        bool removed_cubes = cube_count < _sleeping_island_ids.size();
+        _still_step_counts.resize(cube_count, 0);
+        _sleeping_island_ids.resize(cube_count, -1);
+        if(removed_cubes) {
+            _rebuild_sleeping_island_cubes(); // The removed cubes may still be in the lists
+        }
+        else {
+            _sleeping_island_cubes.resize(cube_count);
+        }
+    }
+    inline bool is_sleeping(int cube_index) const {
+        return _sleeping_island_ids[cube_index] != -1;
+    }
+    const std::vector<int>& get_still_step_counts() const {
+        return _still_step_counts;
+    }
+    const std::vector<int>& get_sleeping_island_ids() const {
+        return _sleeping_island_ids;
+    }
+    // Restore the state from get_still_step_counts and get_sleeping_island_ids, e.g. from a snapshot
+    void set_state(const std::vector<int>& still_step_counts, const std::vector<int>& sleeping_island_ids) {
+        _still_step_counts = still_step_counts;
+        _sleeping_island_ids = sleeping_island_ids;
+        _rebuild_sleeping_island_cubes();
+    }
+    int get_sleeping_count() const {
+        int sleeping_count = 0;
+        for(int i = 0; i < _sleeping_island_ids.size(); i++) {
+            sleeping_count += is_sleeping(i);
+        }
+        return sleeping_count;
+    }
+
+    /**
+     * Wake up a cube and all the other cubes that were in the same island when it fell asleep
+     *  Only the cubes of that island are visited, so waking a small island is cheap in a large world
+    */
+    void wake(int cube_index) {
+        int island_id = _sleeping_island_ids[cube_index];
+        if(island_id == -1) {
+            return;
+        }
+        std::vector<int>& island_cubes = _sleeping_island_cubes[island_id];
+        for(int i = 0; i < island_cubes.size(); i++) {
+            _sleeping_island_ids[island_cubes[i]] = -1;
+            _still_step_counts[island_cubes[i]] = 0;
+        }
+        island_cubes.clear();
+    }
+
+    /**
+     * Build the islands from the contacts, and put the islands that have been still long enough to sleep
+     * @param kinetic_energies_j The kinetic energy of each cube
+    */
+    void update(std::vector<Cube>& cubes, const std::vector<SolverContact>& contacts, const std::vector<double>& kinetic_energies_j) {
+        START_TRACE_FUNCTION();
+        resize(cubes.size());
+        if(!sleeping_enabled) {
+            return;
+        }
+        for(int i = 0; i < cubes.size(); i++) {
+            if(is_sleeping(i)) {
+                continue;
+            }
+            if(kinetic_energies_j[i] < sleep_energy_threshold_j_kg * cubes[i].mass_kg) {
+                _still_step_counts[i] += 1;
+            }
+            else {
+                _still_step_counts[i] = 0;
+            }
+        }
+
+        // Cubes touching each other are in the same island, planes do not connect islands since they never move
+        _islands.reset(cubes.size());
+        for(int c = 0; c < contacts.size(); c++) {
+            if(contacts[c].body1 >= 0 && contacts[c].body2 >= 0) {
+                _islands.merge(contacts[c].body1, contacts[c].body2);
+            }
+        }
+
+        // An island can only sleep if all of its cubes are still
+        std::vector<int> island_still_step_counts = std::vector<int>(cubes.size(), sleep_step_count);
+        for(int i = 0; i < cubes.size(); i++) {
+            int island = _islands.find(i);
+            island_still_step_counts[island] = std::min(island_still_step_counts[island], _still_step_counts[i]);
+        }
+        for(int i = 0; i < cubes.size(); i++) {
+            if(is_sleeping(i)) {
+                continue;
+            }
+            int island = _islands.find(i);
+            if(island_still_step_counts[island] >= sleep_step_count) {
+                _sleeping_island_ids[i] = island;
+                _sleeping_island_cubes[island].push_back(i);
+                cubes[i].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, 0, 0);
+                cubes[i].trajectory.rotational_velocity.rotation = glm::dvec3(0, 0, 0);
+            }
+        }
+    }
+};
+TestWrapper(TEST_SleepManager_wake,
+    /** Waking a cube should only wake the island it fell asleep in
+    */
+    void test() {
+        std::vector<Cube> cubes = std::vector<Cube>(5);
+        std::vector<SolverContact> contacts = std::vector<SolverContact>(2);
+        contacts[0].body1 = 0;
+        contacts[0].body2 = 3;
+        contacts[1].body1 = 1;
+        contacts[1].body2 = 4;
+        SleepManager sleep_manager;
+        sleep_manager.sleep_step_count = 2;
+        for(int i = 0; i < 2; i++) {
+            sleep_manager.update(cubes, contacts, std::vector<double>(5, 0.0));
+        }
+        Assert(sleep_manager.get_sleeping_count() == 5);
+        sleep_manager.wake(3);
+        Assert(!sleep_manager.is_sleeping(0) && !sleep_manager.is_sleeping(3));
+        Assert(sleep_manager.is_sleeping(1) && sleep_manager.is_sleeping(2) && sleep_manager.is_sleeping(4));
+        sleep_manager.wake(4);
+        Assert(sleep_manager.get_sleeping_count() == 1);
+
+        // The island lists are rebuilt from a restored state
+        SleepManager restored;
+        restored.set_state(sleep_manager.get_still_step_counts(), sleep_manager.get_sleeping_island_ids());
+        restored.wake(2);
+        Assert(restored.get_sleeping_count() == 0);
+    }
+);
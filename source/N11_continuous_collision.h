@@ -0,0 +1,156 @@
+/* Continuous collision detection
+ * A cube that moves further than its own size in one step can pass straight through a plane or another cube
+ * without ever overlapping it at the end of a step. For those cubes, find when during the step they would first
+ * touch something, and only move them that far
+*/
+#include "N10_islands.h"
+
+/**
+ * Get the distance from the center of the cube to its corners
+*/
+inline double get_cube_bounding_radius(const Cube& cube) {
+    return std::sqrt(3.0) * cube.side_length_m / 2;
+}
+
+/**
+ * Get the box that contains the cube during the whole time step, if it moves in a straight line
+*/
+AxisAlignedBoundingBox get_swept_bounding_box(AxisAlignedBoundingBox bounding_box, const glm::dvec3& velocity_m_s, double time_step_s) {
+    glm::dvec3 displacement = velocity_m_s * time_step_s;
+    bounding_box.min += glm::min(displacement, glm::dvec3(0, 0, 0));
+    bounding_box.max += glm::max(displacement, glm::dvec3(0, 0, 0));
+    return bounding_box;
+}
+AxisAlignedBoundingBox get_swept_cube_bounding_box(const Cube& cube, double time_step_s, double margin_m = 0.0) {
+    return get_swept_bounding_box(get_cube_bounding_box(cube, margin_m), cube.trajectory.linear_velocity.speed_m_per_s, time_step_s);
+}
+
+/**
+ * Get the cube as it would be after moving time_s along its trajectory
+*/
+inline Cube get_cube_at_time(const Cube& cube, double time_s) {
+    Cube moved_cube = cube;
+    moved_cube.trajectory.move_time_step_s(time_s);
+    return moved_cube;
+}
+
+/**
+ * Find when the separation first reaches target_separation_m using conservative advancement
+ *  The time is moved forward as far as it can be without the separation possibly going past the target,
+ *  assuming that the separation never shrinks faster than the closing speed along the axis that separates them
+ * @param get_separation_m Function(time_s, separating_axis) that gets the separation at a given time, negative
+ *  if they overlap, and sets the axis it was measured along
+ * @param get_max_closing_speed_m_s Function(separating_axis) that gets how fast the separation can shrink along the axis
+ * @return The time of impact, or time_step_s if they do not reach the target during the step.
+ *  If they are already at the target at the start, e.g. a cube sliding along another, the contact solver handles
+ *  them and time_step_s is returned as well
+*/
+template<class SeparationFunction, class ClosingSpeedFunction>
+double get_time_of_impact(SeparationFunction get_separation_m, ClosingSpeedFunction get_max_closing_speed_m_s, double time_step_s, double target_separation_m, double tolerance_m = 0.001) {
+    double time_s = 0;
+    for(int iteration = 0; iteration < 32; iteration++) {
+        glm::dvec3 separating_axis;
+        double distance_to_target_m = get_separation_m(time_s, separating_axis) - target_separation_m;
+        if(distance_to_target_m < tolerance_m) {
+            return iteration == 0 ? time_step_s : time_s;
+        }
+        double max_closing_speed_m_s = get_max_closing_speed_m_s(separating_axis);
+        if(max_closing_speed_m_s <= 0) {
+            return time_step_s; // They can not get any closer along the axis that separates them
+        }
+        time_s += distance_to_target_m / max_closing_speed_m_s;
+        if(time_s >= time_step_s) {
+            return time_step_s;
+        }
+    }
+    return time_s;
+}
+
+/**
+ * Get when the cube first reaches the plane during the step
+ * @param penetration_m How far into the plane the cube may go, so the contact is found in the next step
+*/
+double get_cube_plane_time_of_impact(const Cube& cube, const vicmil::Plane& plane, double time_step_s, double penetration_m) {
+    glm::dvec3 normal = glm::normalize(plane.normal);
+    return get_time_of_impact([&](double time_s, glm::dvec3& separating_axis) {
+        separating_axis = normal;
+        return -get_plane_cube_overlap(get_cube_at_time(cube, time_s), plane).overlap;
+    }, [&](const glm::dvec3& separating_axis) {
+        return -glm::dot(cube.trajectory.linear_velocity.speed_m_per_s, separating_axis) +
+            glm::length(cube.trajectory.rotational_velocity.rotation) * get_cube_bounding_radius(cube);
+    }, time_step_s, -penetration_m);
+}
+
+/**
+ * Get when the two cubes first touch during the step, both cubes are moved along their trajectory
+ *  The separation is the largest gap along any of the separating axis, which is never larger than the real distance
+ *  Only the part of the relative velocity along that axis closes the gap, sliding past each other does not
+ * @param penetration_m How far into each other the cubes may go, so the contact is found in the next step
+*/
+double get_cube_cube_time_of_impact(const Cube& cube1, const Cube& cube2, double time_step_s, double penetration_m) {
+    glm::dvec3 relative_velocity_m_s = cube1.trajectory.linear_velocity.speed_m_per_s - cube2.trajectory.linear_velocity.speed_m_per_s;
+    double max_rotation_speed_m_s =
+        glm::length(cube1.trajectory.rotational_velocity.rotation) * get_cube_bounding_radius(cube1) +
+        glm::length(cube2.trajectory.rotational_velocity.rotation) * get_cube_bounding_radius(cube2);
+    return get_time_of_impact([&](double time_s, glm::dvec3& separating_axis) {
+        OrientedBox box1 = OrientedBox::from_cube(get_cube_at_time(cube1, time_s));
+        OrientedBox box2 = OrientedBox::from_cube(get_cube_at_time(cube2, time_s));
+        Overlap min_overlap = get_box_box_overlap_along_faces(box1, box2);
+        Overlap overlap = get_box_box_overlap_along_faces(box2, box1);
+        if(overlap.overlap < min_overlap.overlap) {
+            min_overlap = overlap;
+        }
+        overlap = get_box_box_overlap_along_edge_pairs(box1, box2);
+        if(overlap.overlap < min_overlap.overlap) {
+            min_overlap = overlap;
+        }
+        // Point the axis from cube2 to cube1, the direction the gap grows when cube1 moves along it
+        separating_axis = align_axis_along_vector(min_overlap.axis, box1.center - box2.center);
+        return -min_overlap.overlap;
+    }, [&](const glm::dvec3& separating_axis) {
+        return -glm::dot(relative_velocity_m_s, separating_axis) + max_rotation_speed_m_s;
+    }, time_step_s, -penetration_m);
+}
+TestWrapper(TEST_get_cube_plane_time_of_impact,
+    void test() {
+        Cube cube = Cube();
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(0, 5.5, 0);
+        cube.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, -10, 0);
+        // The bottom of the cube is 5m above the plane, so it should hit after 0.5s
+        double time_of_impact_s = get_cube_plane_time_of_impact(cube, vicmil::Plane(), 1.0, 0.0);
+        Assert(abs(time_of_impact_s - 0.5) < 0.001);
+
+        // Moving away, it never hits
+        cube.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, 10, 0);
+        Assert(get_cube_plane_time_of_impact(cube, vicmil::Plane(), 1.0, 0.0) == 1.0);
+
+        // Already resting on the plane and sliding along it, the contact solver handles it
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(0, 0.49, 0);
+        cube.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(10, -1, 0);
+        Assert(get_cube_plane_time_of_impact(cube, vicmil::Plane(), 1.0, 0.01) == 1.0);
+    }
+);
+TestWrapper(TEST_get_cube_cube_time_of_impact,
+    void test() {
+        Cube cube1 = Cube();
+        Cube cube2 = Cube();
+        cube1.trajectory.orientation.center_of_mass = glm::dvec3(-5, 0, 0);
+        cube1.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(20, 0, 0);
+        cube1.trajectory.rotational_velocity.rotation = glm::dvec3(0, 0.3, 0);
+        // The gap is 4m, so it should hit after about 0.2s, it rotates a little so it hits a bit earlier
+        double time_of_impact_s = get_cube_cube_time_of_impact(cube1, cube2, 1.0, 0.0);
+        Assert(time_of_impact_s > 0.18 && time_of_impact_s <= 0.2);
+        Cube moved_cube = get_cube_at_time(cube1, time_of_impact_s);
+        Assert(!get_cube_cube_intersection_resolution(moved_cube, cube2).is_collision);
+
+        // A cube sliding past a cube it already touches is left to the contact solver
+        Cube sliding_cube = Cube();
+        sliding_cube.trajectory.orientation.center_of_mass = glm::dvec3(-0.98, 0, 0);
+        sliding_cube.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(1, 0, 10);
+        Assert(get_cube_cube_time_of_impact(sliding_cube, cube2, 1.0, 0.01) == 1.0);
+        // Sliding past with a gap, it never gets closer
+        sliding_cube.trajectory.orientation.center_of_mass = glm::dvec3(-1.5, 0, 0);
+        sliding_cube.trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, 0, 10);
+        Assert(get_cube_cube_time_of_impact(sliding_cube, cube2, 1.0, 0.01) == 1.0);
+    }
+);
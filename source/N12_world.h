@@ -0,0 +1,1008 @@
+/* The world owns all the objects in the simulation, and knows how to move them forward in time
+ * It does not depend on any graphics, so it can be run both in the browser and natively from the command line
+*/
+#include "N11_continuous_collision.h"
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+#include <type_traits>
+#include <tuple>
+
+/* World snapshot files
+ * A snapshot holds everything needed to continue a simulation exactly where it was saved
+ * The sections are raw arrays of the in memory structs, so a snapshot can be memory mapped and read in place
+ *
+ * File layout, all numbers in the byte order of the computer that saved it:
+ *  WorldSnapshotHeader, then each section starting at a multiple of WORLD_SNAPSHOT_ALIGNMENT bytes:
+ *  cubes, previous orientations, planes, still step counts(int32), sleeping island ids(int32), contact impulses
+*/
+const uint32_t WORLD_SNAPSHOT_VERSION = 1;
+const uint64_t WORLD_SNAPSHOT_ALIGNMENT = 64;
+
+struct WorldSnapshotHeader {
+    char magic[8]; // "CUBESNAP"
+    uint32_t version;
+    uint32_t cube_size_bytes; // sizeof(Cube), snapshots can only be read by a build with the same struct layout
+    uint64_t file_size_bytes;
+    uint64_t step_count;
+    double simulated_time_s;
+    double gravity_m_s2[3];
+    double cube_cube_restitution_constant;
+    double cube_plane_restitution_constant;
+
+    // Where each section starts in the file, and how many elements it has
+    uint64_t cubes_offset;
+    uint64_t cube_count;
+    uint64_t previous_orientations_offset;
+    uint64_t previous_orientation_count;
+    uint64_t planes_offset;
+    uint64_t plane_count;
+    uint64_t still_step_counts_offset;
+    uint64_t sleeping_island_ids_offset;
+    uint64_t sleep_state_count; // The number of elements in both sleep sections
+    uint64_t contact_impulses_offset;
+    uint64_t contact_impulse_count;
+};
+
+struct WorldSnapshotContactImpulse {
+    ContactKey key;
+    int32_t padding;
+    double impulse_newton_s;
+};
+
+static_assert(std::is_trivially_copyable<Cube>::value, "Cubes are saved as raw bytes in snapshots");
+static_assert(std::is_trivially_copyable<ObjectOrientation>::value, "Orientations are saved as raw bytes in snapshots");
+static_assert(std::is_trivially_copyable<vicmil::Plane>::value, "Planes are saved as raw bytes in snapshots");
+
+inline uint64_t get_world_snapshot_aligned_size(uint64_t size_bytes) {
+    return (size_bytes + WORLD_SNAPSHOT_ALIGNMENT - 1) / WORLD_SNAPSHOT_ALIGNMENT * WORLD_SNAPSHOT_ALIGNMENT;
+}
+
+/**
+ * A snapshot file mapped into memory, the sections can be read in place without loading them into a world
+ *  Opening it only reads the header, the rest is read from disk when it is used
+*/
+class WorldSnapshotView {
+    vicmil::MappedFile _file;
+
+    template<class T>
+    const T* _get_section(uint64_t offset) const {
+        return reinterpret_cast<const T*>(_file.data() + offset);
+    }
+    bool _section_fits(uint64_t offset, uint64_t count, uint64_t element_size) const {
+        return offset % WORLD_SNAPSHOT_ALIGNMENT == 0 && offset <= _file.size() && 
+            count <= (_file.size() - offset) / element_size;
+    }
+public:
+    const WorldSnapshotHeader* header = nullptr;
+
+    /**
+     * @return false if the file does not exist, or is not a snapshot that this build can read
+    */
+    bool open(const std::string& filename) {
+        header = nullptr;
+        _file = vicmil::MappedFile(filename);
+        if(!_file.is_open() || _file.size() < sizeof(WorldSnapshotHeader)) {
+            return false;
+        }
+        const WorldSnapshotHeader* file_header = _get_section<WorldSnapshotHeader>(0);
+        if(std::string(file_header->magic, 8) != std::string("CUBESNAP", 8) ||
+            file_header->version != WORLD_SNAPSHOT_VERSION ||
+            file_header->cube_size_bytes != sizeof(Cube) ||
+            file_header->file_size_bytes != _file.size()) {
+            return false;
+        }
+        if(!_section_fits(file_header->cubes_offset, file_header->cube_count, sizeof(Cube)) ||
+            !_section_fits(file_header->previous_orientations_offset, file_header->previous_orientation_count, sizeof(ObjectOrientation)) ||
+            !_section_fits(file_header->planes_offset, file_header->plane_count, sizeof(vicmil::Plane)) ||
+            !_section_fits(file_header->still_step_counts_offset, file_header->sleep_state_count, sizeof(int32_t)) ||
+            !_section_fits(file_header->sleeping_island_ids_offset, file_header->sleep_state_count, sizeof(int32_t)) ||
+            !_section_fits(file_header->contact_impulses_offset, file_header->contact_impulse_count, sizeof(WorldSnapshotContactImpulse))) {
+            return false;
+        }
+        header = file_header;
+        return true;
+    }
+    const Cube* get_cubes() const {
+        return _get_section<Cube>(header->cubes_offset);
+    }
+    const ObjectOrientation* get_previous_orientations() const {
+        return _get_section<ObjectOrientation>(header->previous_orientations_offset);
+    }
+    const vicmil::Plane* get_planes() const {
+        return _get_section<vicmil::Plane>(header->planes_offset);
+    }
+    const int32_t* get_still_step_counts() const {
+        return _get_section<int32_t>(header->still_step_counts_offset);
+    }
+    const int32_t* get_sleeping_island_ids() const {
+        return _get_section<int32_t>(header->sleeping_island_ids_offset);
+    }
+    const WorldSnapshotContactImpulse* get_contact_impulses() const {
+        return _get_section<WorldSnapshotContactImpulse>(header->contact_impulses_offset);
+    }
+};
+
+/**
+ * Counts what happened during one step, to find out why the steps get slow when a scene grows
+*/
+struct StepCounters {
+    uint64_t candidate_pairs = 0; // The pairs found by the broad phase
+    uint64_t pairs_tested = 0; // The pairs tested by the narrow phase, pairs of two sleeping cubes are skipped
+    uint64_t pairs_rejected_faces1 = 0; // Tested pairs that were separated along a face of the first cube
+    uint64_t pairs_rejected_faces2 = 0; // Separated along a face of the second cube, but none of the first
+    uint64_t pairs_rejected_edge_pairs = 0; // Only separated along an edge pair
+    uint64_t pairs_rejected_cached_axis = 0; // Rejected by the axis from the last step, these are also counted in the three above
+    uint64_t contacts = 0; // The contact points given to the contact solver
+    uint64_t impulses_applied = 0;
+    uint64_t awake_cubes = 0;
+    uint64_t heap_allocations = 0; // Only counted if count_heap_allocations.cpp is built into the program
+
+    std::string to_string() const {
+        return "pairs: " + std::to_string(candidate_pairs) + 
+            "  tested: " + std::to_string(pairs_tested) + 
+            "  rejected faces1/faces2/edges: " + std::to_string(pairs_rejected_faces1) + "/" + 
+                std::to_string(pairs_rejected_faces2) + "/" + std::to_string(pairs_rejected_edge_pairs) + 
+            "  cached axis: " + std::to_string(pairs_rejected_cached_axis) + 
+            "  contacts: " + std::to_string(contacts) + 
+            "  impulses: " + std::to_string(impulses_applied) + 
+            "  awake: " + std::to_string(awake_cubes) + 
+            "  allocations: " + std::to_string(heap_allocations);
+    }
+};
+
+/**
+ * What the world keeps for each pair of cubes the broad phase finds, see PairManager
+*/
+struct CubePairData {
+    CachedSeparatingAxis separating_axis; // Tested first in the next step
+    bool touching = false; // If the cubes were touching after the last step
+};
+
+/**
+ * Pairs of cubes that started touching, kept touching or stopped touching during the last step, sorted
+ *  Only cube pairs, not cubes against planes
+*/
+struct ContactEvents {
+    std::vector<CollisionPair> began;
+    std::vector<CollisionPair> persisted;
+    std::vector<CollisionPair> ended;
+
+    void clear() {
+        began.clear();
+        persisted.clear();
+        ended.clear();
+    }
+};
+
+class World {
+    std::vector<IntersectionResolution> _cube_cube_intersections; // One for each pair in the broad phase
+    static const int NARROW_PHASE_PACKET_SIZE = 8;
+    std::vector<int> _pair_packet_starts; // Where each packet of pairs starts in the broad phase pairs, and the end of the last one
+    std::shared_ptr<vicmil::JobSystem> _job_system;
+    std::vector<double> _kinetic_energies_j;
+    std::vector<double> _move_time_steps_s; // How far each cube is moved this step, shorter than the step if it would hit something
+    std::vector<int> _fast_cube_indices; // The awake cubes that need continuous collision this step
+    std::vector<bool> _is_fast_cube;
+    double _max_slow_cube_displacement_m = 0; // How far the cubes that are not fast move during the step at most
+
+    vicmil::JobSystem& _get_job_system() {
+        if(!_job_system || _job_system->get_thread_count() != thread_count) {
+            _job_system = std::make_shared<vicmil::JobSystem>(thread_count);
+        }
+        return *_job_system;
+    }
+    /**
+     * The pairs are sorted by index1, so all pairs of a cube come one after another
+     *  Up to NARROW_PHASE_PACKET_SIZE of them are tested together, see get_box_box_overlaps_packet
+    */
+    void _find_pair_packets() {
+        const std::vector<CollisionPair>& pairs = broad_phase.pairs;
+        _pair_packet_starts.clear();
+        for(int pair_index = 0; pair_index < pairs.size(); pair_index++) {
+            if(pair_index == 0 || pairs[pair_index].index1 != pairs[pair_index - 1].index1 ||
+                pair_index - _pair_packet_starts.back() >= NARROW_PHASE_PACKET_SIZE) {
+                _pair_packet_starts.push_back(pair_index);
+            }
+        }
+        _pair_packet_starts.push_back(pairs.size());
+    }
+    void _find_cube_cube_intersections() {
+        _cube_cube_intersections.resize(broad_phase.pairs.size());
+        _find_pair_packets();
+        _get_job_system().parallel_for(_pair_packet_starts.size() - 1, [this](int packet_index) {
+            int index1 = broad_phase.pairs[_pair_packet_starts[packet_index]].index1;
+            const OrientedBox* boxes2[NARROW_PHASE_PACKET_SIZE];
+            int pair_indices[NARROW_PHASE_PACKET_SIZE];
+            int box_count = 0;
+            for(int pair_index = _pair_packet_starts[packet_index]; pair_index < _pair_packet_starts[packet_index + 1]; pair_index++) {
+                int index2 = broad_phase.pairs[pair_index].index2;
+                if(sleep_manager.is_sleeping(index1) && sleep_manager.is_sleeping(index2)) {
+                    // Sleeping cubes have not moved since they fell asleep
+                    _cube_cube_intersections[pair_index].is_collision = false;
+                    continue;
+                }
+                const CachedSeparatingAxis& cached_axis = pair_manager.get_pair_data(pair_index).separating_axis;
+                if(separating_axis_cache_enabled && is_box_box_separated_along_cached_axis(body_states[index1].box, body_states[index2].box, cached_axis)) {
+                    IntersectionResolution& intersection = _cube_cube_intersections[pair_index];
+                    intersection.is_collision = false;
+                    intersection.separating_axis_class = cached_axis.axis_class;
+                    intersection.separated_by_cached_axis = true;
+                    continue;
+                }
+                boxes2[box_count] = &body_states[index2].box;
+                pair_indices[box_count] = pair_index;
+                box_count += 1;
+            }
+            BoxBoxOverlaps overlaps[NARROW_PHASE_PACKET_SIZE];
+            get_box_box_overlaps_packet(body_states[index1].box, boxes2, box_count, overlaps);
+            for(int i = 0; i < box_count; i++) {
+                int index2 = broad_phase.pairs[pair_indices[i]].index2;
+                _cube_cube_intersections[pair_indices[i]] = get_cube_cube_intersection_resolution(body_states[index1], body_states[index2], overlaps[i]);
+                pair_manager.get_pair_data(pair_indices[i]).separating_axis = CachedSeparatingAxis::from_overlaps(overlaps[i]);
+            }
+        });
+    }
+    // If an awake cube might touch a sleeping cube, the sleeping cube and its island has to wake up
+    void _wake_touched_islands() {
+        for(int pair_index = 0; pair_index < broad_phase.pairs.size(); pair_index++) {
+            const CollisionPair& pair = broad_phase.pairs[pair_index];
+            bool sleeping1 = sleep_manager.is_sleeping(pair.index1);
+            bool sleeping2 = sleep_manager.is_sleeping(pair.index2);
+            if(sleeping1 && !sleeping2) {
+                sleep_manager.wake(pair.index1);
+            }
+            if(sleeping2 && !sleeping1) {
+                sleep_manager.wake(pair.index2);
+            }
+        }
+    }
+    void _count_narrow_phase_results() {
+        step_counters.candidate_pairs = broad_phase.pairs.size();
+        for(int pair_index = 0; pair_index < broad_phase.pairs.size(); pair_index++) {
+            const CollisionPair& pair = broad_phase.pairs[pair_index];
+            if(sleep_manager.is_sleeping(pair.index1) && sleep_manager.is_sleeping(pair.index2)) {
+                continue;
+            }
+            step_counters.pairs_tested += 1;
+            SeparatingAxisClass separating_axis_class = _cube_cube_intersections[pair_index].separating_axis_class;
+            step_counters.pairs_rejected_faces1 += (separating_axis_class == SEPARATING_AXIS_FACES1);
+            step_counters.pairs_rejected_faces2 += (separating_axis_class == SEPARATING_AXIS_FACES2);
+            step_counters.pairs_rejected_edge_pairs += (separating_axis_class == SEPARATING_AXIS_EDGE_PAIRS);
+            step_counters.pairs_rejected_cached_axis += _cube_cube_intersections[pair_index].separated_by_cached_axis;
+        }
+    }
+    void _find_contact_events() {
+        contact_events.clear();
+        for(int pair_index = 0; pair_index < broad_phase.pairs.size(); pair_index++) {
+            const CollisionPair& pair = broad_phase.pairs[pair_index];
+            CubePairData& pair_data = pair_manager.get_pair_data(pair_index);
+            bool was_touching = pair_data.touching;
+            // Sleeping cubes are not tested, they stay the way they were when they fell asleep
+            if(!sleep_manager.is_sleeping(pair.index1) || !sleep_manager.is_sleeping(pair.index2)) {
+                pair_data.touching = _cube_cube_intersections[pair_index].is_collision;
+            }
+            if(pair_data.touching && !was_touching) {
+                contact_events.began.push_back(pair);
+            }
+            else if(pair_data.touching) {
+                contact_events.persisted.push_back(pair);
+            }
+            else if(was_touching) {
+                contact_events.ended.push_back(pair);
+            }
+        }
+        // Pairs that were touching and moved so far apart that the broad phase dropped them
+        for(int i = 0; i < pair_manager.removed_pairs.size(); i++) {
+            if(pair_manager.removed_pairs[i].data.touching) {
+                contact_events.ended.push_back(pair_manager.removed_pairs[i].pair);
+            }
+        }
+        std::sort(contact_events.ended.begin(), contact_events.ended.end());
+    }
+    // Gather all contact points in a fixed order, first all cube pairs and then all cubes against the planes
+    void _gather_contacts() {
+        std::vector<SolverContact>& contacts = contact_solver.contacts;
+        contacts.clear();
+        for(int pair_index = 0; pair_index < broad_phase.pairs.size(); pair_index++) {
+            const IntersectionResolution& intersection = _cube_cube_intersections[pair_index];
+            if(!intersection.is_collision) {
+                continue;
+            }
+            const ContactManifold& manifold = intersection.manifold;
+            for(int m = 0; m < manifold.point_count; m++) {
+                SolverContact contact;
+                contact.body1 = broad_phase.pairs[pair_index].index1;
+                contact.body2 = broad_phase.pairs[pair_index].index2;
+                contact.feature_id = manifold.feature_ids[m];
+                contact.position = manifold.positions[m];
+                contact.normal = intersection.collision_axis;
+                contact.penetration_depth_m = manifold.penetration_depths_m[m];
+                contact.restitution_constant = cube_cube_restitution_constant;
+                contacts.push_back(contact);
+            }
+        }
+        for(int i = 0; i < cubes.size(); i++) {
+            if(sleep_manager.is_sleeping(i)) {
+                continue;
+            }
+            for(int p = 0; p < planes.size(); p++) {
+                ContactManifold manifold = get_cube_plane_contact_manifold(body_states[i], planes[p]);
+                for(int m = 0; m < manifold.point_count; m++) {
+                    SolverContact contact;
+                    contact.body1 = i;
+                    contact.body2 = -1 - p;
+                    contact.feature_id = manifold.feature_ids[m];
+                    contact.position = manifold.positions[m];
+                    contact.normal = glm::normalize(planes[p].normal);
+                    contact.penetration_depth_m = manifold.penetration_depths_m[m];
+                    contact.restitution_constant = cube_plane_restitution_constant;
+                    contacts.push_back(contact);
+                }
+            }
+        }
+    }
+    inline bool _needs_continuous_collision(int cube_index, double time_step_s) const {
+        const Cube& cube = cubes[cube_index];
+        double displacement_m = glm::length(cube.trajectory.linear_velocity.speed_m_per_s) * time_step_s;
+        return continuous_collision_enabled && !sleep_manager.is_sleeping(cube_index) &&
+            displacement_m > continuous_collision_displacement_fraction * cube.side_length_m;
+    }
+    /**
+     * Find the cubes that move far during the step, and how far the other cubes move at most
+    */
+    void _find_fast_cubes(double time_step_s) {
+        _fast_cube_indices.clear();
+        _is_fast_cube.assign(cubes.size(), false);
+        _max_slow_cube_displacement_m = 0;
+        for(int i = 0; i < cubes.size(); i++) {
+            if(_needs_continuous_collision(i, time_step_s)) {
+                _fast_cube_indices.push_back(i);
+                _is_fast_cube[i] = true;
+            }
+            else {
+                double displacement_m = glm::length(cubes[i].trajectory.linear_velocity.speed_m_per_s) * time_step_s;
+                _max_slow_cube_displacement_m = std::max(_max_slow_cube_displacement_m, displacement_m);
+            }
+        }
+    }
+    /**
+     * Get how long a cube can move before it hits something, only checked for the fast cubes, see _find_fast_cubes
+     *  Only reads the cubes, so it can be done in parallel
+    */
+    double _get_move_time_step_s(int cube_index, double time_step_s) {
+        if(!_is_fast_cube[cube_index]) {
+            return time_step_s;
+        }
+        const Cube& cube = cubes[cube_index];
+        double move_time_step_s = time_step_s;
+        for(int p = 0; p < planes.size(); p++) {
+            move_time_step_s = std::min(move_time_step_s, 
+                get_cube_plane_time_of_impact(cube, planes[p], time_step_s, continuous_collision_penetration_m));
+        }
+        // The broad phase only covers where the cubes are now, so look for anything in the way along the whole path
+        AxisAlignedBoundingBox swept_box = get_swept_bounding_box(body_states[cube_index].bounding_box, cube.trajectory.linear_velocity.speed_m_per_s, time_step_s);
+        auto test_cube = [&](int i) {
+            AxisAlignedBoundingBox other_swept_box = get_swept_bounding_box(body_states[i].bounding_box, cubes[i].trajectory.linear_velocity.speed_m_per_s, time_step_s);
+            if(!swept_box.overlaps(other_swept_box)) {
+                return;
+            }
+            move_time_step_s = std::min(move_time_step_s, 
+                get_cube_cube_time_of_impact(cube, cubes[i], time_step_s, continuous_collision_penetration_m));
+        };
+        // A slow cube can only reach the path if its box is within its displacement of it, the broad phase finds those
+        broad_phase.for_each_overlapping_box(swept_box.expanded(_max_slow_cube_displacement_m), [&](int i) {
+            if(!_is_fast_cube[i]) {
+                test_cube(i);
+            }
+        });
+        // There are few fast cubes, but they can come from far away, so test all of them
+        for(int f = 0; f < _fast_cube_indices.size(); f++) {
+            if(_fast_cube_indices[f] != cube_index) {
+                test_cube(_fast_cube_indices[f]);
+            }
+        }
+        return move_time_step_s;
+    }
+public:
+    std::vector<Cube> cubes;
+    std::vector<vicmil::Plane> planes;
+    glm::dvec3 gravity_m_s2 = glm::dvec3(0, -1, 0);
+
+    // 1 means no loss of energy(perfect bounce)
+    // 0 means maximum energy loss(They stick together)
+    double cube_cube_restitution_constant = 1.0;
+    double cube_plane_restitution_constant = 0.8;
+
+    double simulated_time_s = 0;
+    unsigned int step_count = 0;
+
+    // Where the cubes were before the last step, used to draw them in between steps
+    std::vector<ObjectOrientation> previous_orientations;
+
+    // Derived from the cubes at the start of each step, nothing in the step moves the cubes until they are integrated
+    // Calculating them before the step, instead of after the last integration, also covers cubes moved from outside the world
+    std::vector<CubeBodyState> body_states;
+    RigidBodyStore body_store; // The cubes are copied into it to be integrated
+
+    SweepAndPrune broad_phase;
+    PairManager<CubePairData> pair_manager; // Keeps the broad phase pairs between steps
+    bool separating_axis_cache_enabled = true; // Test the axis that separated each pair in the last step first
+    ContactEvents contact_events; // Which cubes started and stopped touching during the last step
+    ContactSolver contact_solver;
+    SleepManager sleep_manager;
+
+    // Cubes that move further than this fraction of their side length in one step are stopped at the first thing they hit
+    bool continuous_collision_enabled = true;
+    double continuous_collision_displacement_fraction = 0.25;
+    double continuous_collision_penetration_m = 0.01; // Stop them a bit inside, so the contact is found in the next step
+
+    // The number of threads used to run the step
+    // The result is exactly the same no matter how many threads are used
+    int thread_count = 1;
+
+    // How long each phase of the step takes, e.g. phase_statistics.find_histogram("narrow phase")->get_percentile_s(99)
+    vicmil::PhaseStatistics phase_statistics;
+    StepCounters step_counters; // What happened during the last step
+
+    /**
+     * Move all objects forward one time step
+     *  The velocities are updated first, then the contacts are solved so that nothing moves into 
+     *  each other, and last the cubes are moved with the new velocities
+     *  Sleeping cubes are skipped, unless an awake cube comes close to them
+     *  Fast cubes are only moved until they hit something, so they can not pass through it
+    */
+    void step(double time_step_s) {
+        START_TRACE_FUNCTION();
+        vicmil::ScopedPhaseTimer step_timer = vicmil::ScopedPhaseTimer(phase_statistics, "step");
+        vicmil::JobSystem& job_system = _get_job_system();
+        uint64_t heap_allocation_count_at_start = vicmil::get_heap_allocation_count();
+        step_counters = StepCounters();
+        sleep_manager.resize(cubes.size());
+        previous_orientations.resize(cubes.size());
+        for(int i = 0; i < cubes.size(); i++) {
+            previous_orientations[i] = cubes[i].trajectory.orientation;
+        }
+        {
+            TRACE_ZONE("body states");
+            body_states.resize(cubes.size());
+            body_store.resize(cubes.size());
+            job_system.parallel_for(cubes.size(), [this](int i) {
+                body_states[i] = CubeBodyState::from_cube(cubes[i]);
+                // The cube is already being read, so fill the store in the same pass
+                body_store.set_trajectory(i, cubes[i].trajectory);
+                body_store.inverse_mass_kg[i] = body_states[i].inverse_mass_kg;
+                body_store.side_length_m[i] = cubes[i].side_length_m;
+            }, 64);
+        }
+
+        // Find which cubes might be colliding
+        {
+            TRACE_ZONE("broad phase");
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(phase_statistics, "broad phase");
+            broad_phase.update(body_states);
+            pair_manager.update(broad_phase.pairs);
+            _wake_touched_islands();
+        }
+
+        // Apply gravity in the store, the contact solver reads the velocities from the cubes so they are copied back
+        vicmil::JobHandle acceleration = job_system.add_job([this, time_step_s] {
+            apply_acceleration_batch(gravity_m_s2, time_step_s, body_store);
+            for(int i = 0; i < cubes.size(); i++) {
+                if(!sleep_manager.is_sleeping(i)) {
+                    body_store.get_linear_velocity(i, cubes[i].trajectory.linear_velocity);
+                }
+            }
+        });
+
+        // Find the intersections, this only reads the positions so it can be done in parallel
+        int narrow_phase_index = phase_statistics.get_phase_index("narrow phase");
+        vicmil::JobHandle narrow_phase_job = job_system.add_job([this, narrow_phase_index] {
+            TRACE_ZONE("narrow phase");
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(phase_statistics, narrow_phase_index);
+            _find_cube_cube_intersections();
+        });
+        {
+            TRACE_ZONE("wait for gravity and narrow phase");
+            job_system.wait(acceleration);
+            job_system.wait(narrow_phase_job);
+        }
+        _count_narrow_phase_results();
+        _find_contact_events();
+
+        // Solve the contacts on one thread, in the same order every time
+        {
+            TRACE_ZONE("contact solver");
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(phase_statistics, "solve");
+            _gather_contacts();
+            contact_solver.solve(cubes, body_states, time_step_s);
+            step_counters.contacts = contact_solver.contacts.size();
+            step_counters.impulses_applied = contact_solver.applied_impulse_count;
+        }
+
+        // Find how far the cubes can move, before moving any of them
+        {
+            TRACE_ZONE("continuous collision");
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(phase_statistics, "continuous collision");
+            _find_fast_cubes(time_step_s);
+            _move_time_steps_s.resize(cubes.size());
+            job_system.parallel_for(cubes.size(), [this, time_step_s](int i) {
+                _move_time_steps_s[i] = sleep_manager.is_sleeping(i) ? 0 : _get_move_time_step_s(i, time_step_s);
+            }, 64);
+        }
+
+        // Move all the cubes according to their new trajectory, in a structure of arrays so that it is vectorized
+        {
+            TRACE_ZONE("integration");
+            vicmil::ScopedPhaseTimer timer = vicmil::ScopedPhaseTimer(phase_statistics, "integration");
+            // Only the velocities changed since the store was filled, the contact solver changed them
+            job_system.parallel_for(cubes.size(), [this](int i) {
+                body_store.set_velocities(i, cubes[i].trajectory);
+            }, 256);
+            move_time_step_s_batch(_move_time_steps_s.data(), body_store);
+            _kinetic_energies_j.resize(cubes.size());
+            get_kinetic_energies_batch(body_store, _kinetic_energies_j.data());
+            job_system.parallel_for(cubes.size(), [this, time_step_s](int i) {
+                if(!sleep_manager.is_sleeping(i)) { // Sleeping cubes have a time step of 0, but keep them exactly as they are
+                    body_store.get_orientation(i, cubes[i].trajectory.orientation);
+                    contact_solver.move_push_apart(cubes[i].trajectory, i, time_step_s);
+                }
+            }, 64);
+        }
+
+        // Put the islands that have been still for a while to sleep
+        sleep_manager.update(cubes, contact_solver.contacts, _kinetic_energies_j);
+        step_counters.awake_cubes = cubes.size() - sleep_manager.get_sleeping_count();
+        step_counters.heap_allocations = vicmil::get_heap_allocation_count() - heap_allocation_count_at_start;
+
+        simulated_time_s += time_step_s;
+        step_count += 1;
+    }
+
+    /**
+     * Save everything needed to continue the simulation later, see WorldSnapshotHeader for the layout
+     *  The snapshot is first written to a temporary file that replaces the old file when it is complete,
+     *  so a crash while saving never leaves a broken snapshot behind
+     *  Settings such as thread_count and the solver settings are not saved
+     * @return false if the file could not be written
+    */
+    bool save_snapshot(const std::string& filename) const {
+        START_TRACE_FUNCTION();
+        const std::vector<int>& still_step_counts = sleep_manager.get_still_step_counts();
+        const std::vector<int>& sleeping_island_ids = sleep_manager.get_sleeping_island_ids();
+        static_assert(sizeof(int) == sizeof(int32_t), "The sleep state is saved as int32");
+
+        // Sort the cached impulses, so the same world always gives the same file
+        std::vector<WorldSnapshotContactImpulse> contact_impulses;
+        contact_impulses.reserve(contact_solver.get_impulse_cache().size());
+        for(const auto& cached_impulse : contact_solver.get_impulse_cache()) {
+            WorldSnapshotContactImpulse contact_impulse;
+            std::memset(&contact_impulse, 0, sizeof(contact_impulse));
+            contact_impulse.key = cached_impulse.first;
+            contact_impulse.impulse_newton_s = cached_impulse.second;
+            contact_impulses.push_back(contact_impulse);
+        }
+        std::sort(contact_impulses.begin(), contact_impulses.end(), [](const WorldSnapshotContactImpulse& a, const WorldSnapshotContactImpulse& b) {
+            return std::make_tuple(a.key.body1, a.key.body2, a.key.feature_id) < std::make_tuple(b.key.body1, b.key.body2, b.key.feature_id);
+        });
+
+        WorldSnapshotHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, "CUBESNAP", 8);
+        header.version = WORLD_SNAPSHOT_VERSION;
+        header.cube_size_bytes = sizeof(Cube);
+        header.step_count = step_count;
+        header.simulated_time_s = simulated_time_s;
+        header.gravity_m_s2[0] = gravity_m_s2.x;
+        header.gravity_m_s2[1] = gravity_m_s2.y;
+        header.gravity_m_s2[2] = gravity_m_s2.z;
+        header.cube_cube_restitution_constant = cube_cube_restitution_constant;
+        header.cube_plane_restitution_constant = cube_plane_restitution_constant;
+        header.cube_count = cubes.size();
+        header.previous_orientation_count = previous_orientations.size();
+        header.plane_count = planes.size();
+        header.sleep_state_count = still_step_counts.size();
+        header.contact_impulse_count = contact_impulses.size();
+
+        // Place the sections one after another
+        struct Section {
+            uint64_t* offset;
+            const void* data;
+            uint64_t size_bytes;
+        };
+        Section sections[] = {
+            {&header.cubes_offset, cubes.data(), cubes.size() * sizeof(Cube)},
+            {&header.previous_orientations_offset, previous_orientations.data(), previous_orientations.size() * sizeof(ObjectOrientation)},
+            {&header.planes_offset, planes.data(), planes.size() * sizeof(vicmil::Plane)},
+            {&header.still_step_counts_offset, still_step_counts.data(), still_step_counts.size() * sizeof(int32_t)},
+            {&header.sleeping_island_ids_offset, sleeping_island_ids.data(), sleeping_island_ids.size() * sizeof(int32_t)},
+            {&header.contact_impulses_offset, contact_impulses.data(), contact_impulses.size() * sizeof(WorldSnapshotContactImpulse)}
+        };
+        uint64_t offset = get_world_snapshot_aligned_size(sizeof(WorldSnapshotHeader));
+        for(Section& section : sections) {
+            *section.offset = offset;
+            offset += get_world_snapshot_aligned_size(section.size_bytes);
+        }
+        header.file_size_bytes = offset;
+
+        std::string temporary_filename = filename + ".tmp";
+        std::ofstream file = std::ofstream(temporary_filename, std::ios::out | std::ios::binary | std::ios::trunc);
+        if(!file.is_open()) {
+            return false;
+        }
+        const char zeros[WORLD_SNAPSHOT_ALIGNMENT] = {};
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(zeros, get_world_snapshot_aligned_size(sizeof(header)) - sizeof(header));
+        for(Section& section : sections) {
+            file.write(reinterpret_cast<const char*>(section.data), section.size_bytes);
+            file.write(zeros, get_world_snapshot_aligned_size(section.size_bytes) - section.size_bytes);
+        }
+        file.close();
+        if(!file) {
+            std::remove(temporary_filename.c_str());
+            return false;
+        }
+        return std::rename(temporary_filename.c_str(), filename.c_str()) == 0;
+    }
+
+    /**
+     * Continue from a snapshot saved with save_snapshot, the simulation then continues exactly as it would have
+     *  The file is memory mapped, so loading it is mostly copying memory
+     * @return false if the file does not exist or is not a valid snapshot, then the world is left unchanged
+    */
+    bool load_snapshot(const std::string& filename) {
+        START_TRACE_FUNCTION();
+        WorldSnapshotView snapshot;
+        if(!snapshot.open(filename)) {
+            return false;
+        }
+        const WorldSnapshotHeader& header = *snapshot.header;
+        step_count = header.step_count;
+        simulated_time_s = header.simulated_time_s;
+        gravity_m_s2 = glm::dvec3(header.gravity_m_s2[0], header.gravity_m_s2[1], header.gravity_m_s2[2]);
+        cube_cube_restitution_constant = header.cube_cube_restitution_constant;
+        cube_plane_restitution_constant = header.cube_plane_restitution_constant;
+        cubes.assign(snapshot.get_cubes(), snapshot.get_cubes() + header.cube_count);
+        previous_orientations.assign(snapshot.get_previous_orientations(), snapshot.get_previous_orientations() + header.previous_orientation_count);
+        planes.assign(snapshot.get_planes(), snapshot.get_planes() + header.plane_count);
+        sleep_manager.set_state(
+            std::vector<int>(snapshot.get_still_step_counts(), snapshot.get_still_step_counts() + header.sleep_state_count),
+            std::vector<int>(snapshot.get_sleeping_island_ids(), snapshot.get_sleeping_island_ids() + header.sleep_state_count));
+        contact_solver.contacts.clear();
+        contact_solver.clear_impulse_cache();
+        pair_manager.clear(); // Not saved, so the pairs that touch will be reported as began again after loading
+        for(uint64_t i = 0; i < header.contact_impulse_count; i++) {
+            const WorldSnapshotContactImpulse& contact_impulse = snapshot.get_contact_impulses()[i];
+            contact_solver.set_cached_impulse(contact_impulse.key, contact_impulse.impulse_newton_s);
+        }
+        return true;
+    }
+
+    /**
+     * Get where a cube is between the last step and the current state
+     * @param factor 0 gives where it was before the last step, 1 gives where it is now
+    */
+    ObjectOrientation get_interpolated_orientation(int cube_index, double factor) const {
+        if(cube_index >= previous_orientations.size()) {
+            return cubes[cube_index].trajectory.orientation; // It was added after the last step
+        }
+        return ObjectOrientation::interpolate(previous_orientations[cube_index], cubes[cube_index].trajectory.orientation, factor);
+    }
+
+    /**
+     * Get the energy of all cubes summed together, the potential energy is measured from height 0
+    */
+    ObjectEnergyInfo get_total_energy_information() {
+        ObjectEnergyInfo total_energy;
+        total_energy.potential_energy = 0;
+        total_energy.rotational_kin_energy = 0;
+        total_energy.linear_kin_energy = 0;
+        // Calculate the energy of each cube in parallel, then sum them up in order so the result is always the same
+        std::vector<ObjectEnergyInfo> cube_energies = std::vector<ObjectEnergyInfo>(cubes.size());
+        _get_job_system().parallel_for(cubes.size(), [this, &cube_energies](int i) {
+            cube_energies[i] = get_cube_energy_information(cubes[i], -gravity_m_s2.y);
+        }, 64);
+        for(int i = 0; i < cubes.size(); i++) {
+            const ObjectEnergyInfo& cube_energy = cube_energies[i];
+            total_energy.potential_energy += cube_energy.potential_energy;
+            total_energy.rotational_kin_energy += cube_energy.rotational_kin_energy;
+            total_energy.linear_kin_energy += cube_energy.linear_kin_energy;
+        }
+        return total_energy;
+    }
+};
+TestWrapper(TEST_World_step,
+    /** A cube dropped on the ground should come to rest on top of it, and not fall through
+    */
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.push_back(Cube());
+        world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 3, 0);
+        // It lands flat on all 4 corners, so it bounces straight up a number of times before it stops
+        for(int i = 0; i < 900; i++) {
+            world.step(1.0 / 30);
+        }
+        Assert(world.step_count == 900);
+        Assert(abs(world.simulated_time_s - 30.0) < 0.0001);
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass.y > 0.4);
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass.y < 1.0);
+    }
+);
+TestWrapper(TEST_World_stack_comes_to_rest,
+    /** A stack of cubes placed on the ground should stay upright and come to rest
+    */
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.resize(3);
+        for(int i = 0; i < world.cubes.size(); i++) {
+            world.cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(0.1 * i, 0.5 + i * 1.01, 0);
+        }
+        for(int i = 0; i < 300; i++) {
+            world.step(1.0 / 30);
+        }
+        for(int i = 0; i < world.cubes.size(); i++) {
+            const ObjectTrajectory& trajectory = world.cubes[i].trajectory;
+            DebugExpr(glm::to_string(trajectory.orientation.center_of_mass));
+            Assert(abs(trajectory.orientation.center_of_mass.y - (0.5 + i)) < 0.02);
+            Assert(abs(trajectory.orientation.center_of_mass.x - 0.1 * i) < 0.05); // There is no friction, so it may slide a little
+            Assert(glm::length(trajectory.linear_velocity.speed_m_per_s) < 0.01);
+            Assert(glm::length(trajectory.rotational_velocity.rotation) < 0.01);
+        }
+    }
+);
+TestWrapper(TEST_World_overlap_is_removed_without_bouncing,
+    /** A cube that starts 10cm into the ground should be moved out of it, without being thrown up into the air
+    */
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.push_back(Cube());
+        world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 0.4, 0);
+        double highest_y_m = 0;
+        for(int i = 0; i < 60; i++) {
+            world.step(1.0 / 30);
+            highest_y_m = std::max(highest_y_m, world.cubes[0].trajectory.orientation.center_of_mass.y);
+        }
+        Assert(highest_y_m < 0.51);
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass.y > 0.49);
+    }
+);
+TestWrapper(TEST_World_sleeping,
+    /** A cube resting on the ground should fall asleep, and wake up when another cube lands on it
+    */
+    void test() {
+        World world;
+        world.cube_cube_restitution_constant = 0.0; // Make the second cube stay on top
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.push_back(Cube());
+        world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 0.5, 0);
+        for(int i = 0; i < 100; i++) {
+            world.step(1.0 / 30);
+        }
+        Assert(world.sleep_manager.is_sleeping(0));
+        glm::dvec3 sleeping_position = world.cubes[0].trajectory.orientation.center_of_mass;
+        for(int i = 0; i < 10; i++) {
+            world.step(1.0 / 30);
+        }
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass == sleeping_position); // Sleeping cubes are not moved
+
+        world.cubes.push_back(Cube());
+        world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(0.2, 3, 0);
+        bool woke_up = false;
+        for(int i = 0; i < 600; i++) {
+            world.step(1.0 / 30);
+            woke_up = woke_up || !world.sleep_manager.is_sleeping(0);
+        }
+        Assert(woke_up);
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass.y > 0.45);
+        Assert(world.cubes[1].trajectory.orientation.center_of_mass.y > 1.45);
+        Assert(world.sleep_manager.get_sleeping_count() == 2);
+    }
+);
+TestWrapper(TEST_World_continuous_collision,
+    /** A cube moving much further than its size each step should still hit the cube in its way
+    */
+    void test() {
+        World world;
+        world.gravity_m_s2 = glm::dvec3(0, 0, 0);
+        world.cubes.resize(2);
+        world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(-5, 0, 0);
+        world.cubes[0].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(300, 0, 0); // 10m per step
+        for(int i = 0; i < 10; i++) {
+            world.step(1.0 / 30);
+        }
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass.x < world.cubes[1].trajectory.orientation.center_of_mass.x);
+        Assert(world.cubes[1].trajectory.linear_velocity.speed_m_per_s.x > 200);
+
+        // Without it, the cube passes straight through
+        World world_without_ccd;
+        world_without_ccd.continuous_collision_enabled = false;
+        world_without_ccd.gravity_m_s2 = glm::dvec3(0, 0, 0);
+        world_without_ccd.cubes.resize(2);
+        world_without_ccd.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(-5, 0, 0);
+        world_without_ccd.cubes[0].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(300, 0, 0);
+        for(int i = 0; i < 10; i++) {
+            world_without_ccd.step(1.0 / 30);
+        }
+        Assert(world_without_ccd.cubes[0].trajectory.orientation.center_of_mass.x > world_without_ccd.cubes[1].trajectory.orientation.center_of_mass.x);
+
+        // A fast cube sliding past a cube it already touches should keep moving
+        World sliding_world;
+        sliding_world.gravity_m_s2 = glm::dvec3(0, 0, 0);
+        sliding_world.cubes.resize(2);
+        sliding_world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 5, 0);
+        sliding_world.cubes[0].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, 0, 10);
+        sliding_world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(0.98, 5, 0);
+        sliding_world.step(1.0 / 30);
+        Assert(sliding_world.cubes[0].trajectory.orientation.center_of_mass.z > 0.3);
+    }
+);
+TestWrapper(TEST_World_thread_count_gives_same_result,
+    /** The simulation should be exactly the same regardless of how many threads are used
+    */
+    void test() {
+        std::vector<World> worlds;
+        for(int thread_count = 1; thread_count <= 4; thread_count *= 2) {
+            World world;
+            world.thread_count = thread_count;
+            world.planes.push_back(vicmil::Plane());
+            srand(5);
+            world.cubes.resize(60);
+            for(int i = 0; i < world.cubes.size(); i++) {
+                world.cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(rand()%40, 5 + rand()%40, rand()%40) / 10.0;
+                world.cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            }
+            for(int step = 0; step < 100; step++) {
+                world.step(1.0 / 30);
+            }
+            worlds.push_back(world);
+        }
+        for(int w = 1; w < worlds.size(); w++) {
+            for(int i = 0; i < worlds[0].cubes.size(); i++) {
+                Assert(worlds[w].cubes[i].trajectory.orientation.center_of_mass == worlds[0].cubes[i].trajectory.orientation.center_of_mass);
+                Assert(worlds[w].cubes[i].trajectory.linear_velocity.speed_m_per_s == worlds[0].cubes[i].trajectory.linear_velocity.speed_m_per_s);
+                Assert(worlds[w].cubes[i].trajectory.orientation.rotational_orientation.quaternion == worlds[0].cubes[i].trajectory.orientation.rotational_orientation.quaternion);
+            }
+        }
+    }
+);
+TestWrapper(TEST_World_separating_axis_cache_gives_same_result,
+    /** Testing the cached axis first should only skip work, the cubes should move exactly the same without it
+    */
+    void test() {
+        std::vector<World> worlds;
+        uint64_t cached_axis_rejections = 0;
+        for(int cache_enabled = 0; cache_enabled < 2; cache_enabled++) {
+            World world;
+            world.separating_axis_cache_enabled = cache_enabled;
+            world.planes.push_back(vicmil::Plane());
+            srand(6);
+            world.cubes.resize(60);
+            for(int i = 0; i < world.cubes.size(); i++) {
+                world.cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(rand()%40, 1 + rand()%40, rand()%40) / 10.0;
+                world.cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            }
+            for(int step = 0; step < 150; step++) {
+                world.step(1.0 / 30);
+                cached_axis_rejections += world.step_counters.pairs_rejected_cached_axis;
+            }
+            worlds.push_back(world);
+        }
+        Assert(cached_axis_rejections > 0);
+        for(int i = 0; i < worlds[0].cubes.size(); i++) {
+            Assert(worlds[1].cubes[i].trajectory.orientation.center_of_mass == worlds[0].cubes[i].trajectory.orientation.center_of_mass);
+            Assert(worlds[1].cubes[i].trajectory.orientation.rotational_orientation.quaternion == worlds[0].cubes[i].trajectory.orientation.rotational_orientation.quaternion);
+        }
+    }
+);
+TestWrapper(TEST_World_phase_statistics,
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.resize(2);
+        world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(0.3, 1.5, 0);
+        for(int i = 0; i < 10; i++) {
+            world.step(1.0 / 30);
+        }
+        std::vector<std::string> phases = std::vector<std::string>({"step", "broad phase", "narrow phase", "solve", "continuous collision", "integration"});
+        for(const std::string& phase : phases) {
+            const vicmil::LatencyHistogram* histogram = world.phase_statistics.find_histogram(phase);
+            Assert(histogram != nullptr);
+            Assert(histogram->get_count() == 10);
+            Assert(histogram->get_percentile_s(50) <= histogram->get_percentile_s(99));
+        }
+        Assert(world.phase_statistics.find_histogram("step")->get_max_s() >= world.phase_statistics.find_histogram("solve")->get_max_s());
+    }
+);
+TestWrapper(TEST_World_step_counters,
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.resize(2);
+        // The bounding boxes overlap, but the cubes are separated along the x axis of the first cube
+        world.cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 0.49, 0);
+        world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(1.005, 0.49, 0);
+        world.step(1.0 / 30);
+        Assert(world.step_counters.candidate_pairs == 1);
+        Assert(world.step_counters.pairs_tested == 1);
+        Assert(world.step_counters.pairs_rejected_faces1 == 1);
+        Assert(world.step_counters.pairs_rejected_faces2 == 0);
+        Assert(world.step_counters.contacts == 8); // 4 corners of each cube against the ground
+        Assert(world.step_counters.impulses_applied > 0);
+        Assert(world.step_counters.awake_cubes == 2);
+        Assert(world.step_counters.pairs_rejected_cached_axis == 0);
+
+        // The axis from the first step should separate them again
+        world.step(1.0 / 30);
+        Assert(world.step_counters.pairs_rejected_faces1 == 1);
+        Assert(world.step_counters.pairs_rejected_cached_axis == 1);
+    }
+);
+TestWrapper(TEST_World_contact_events,
+    /** A cube that hits another cube and bounces off should begin and end touching once
+    */
+    void test() {
+        World world;
+        world.gravity_m_s2 = glm::dvec3(0, 0, 0);
+        world.cubes.resize(2);
+        world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(1.2, 0, 0);
+        world.cubes[1].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(-1, 0, 0);
+        int began_count = 0;
+        int ended_count = 0;
+        bool ended_after_began = false;
+        for(int i = 0; i < 60; i++) {
+            world.step(1.0 / 30);
+            began_count += world.contact_events.began.size();
+            ended_count += world.contact_events.ended.size();
+            ended_after_began = ended_after_began || (began_count == 1 && ended_count == 1);
+            for(int e = 0; e < world.contact_events.began.size(); e++) {
+                Assert(world.contact_events.began[e].index1 == 1 && world.contact_events.began[e].index2 == 0);
+            }
+        }
+        Assert(began_count == 1);
+        Assert(ended_count == 1);
+        Assert(ended_after_began);
+        Assert(world.contact_events.persisted.size() == 0);
+    }
+);
+TestWrapper(TEST_World_snapshot,
+    /** A world loaded from a snapshot should continue exactly like the world that was saved
+    */
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        srand(7);
+        world.cubes.resize(40);
+        for(int i = 0; i < world.cubes.size(); i++) {
+            world.cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(rand()%30, 1 + rand()%30, rand()%30) / 10.0;
+            world.cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+        }
+        for(int step = 0; step < 150; step++) {
+            world.step(1.0 / 30);
+        }
+        Assert(world.contact_solver.get_impulse_cache().size() > 0);
+        std::string filename = "test_world_snapshot.cubesnap";
+        Assert(world.save_snapshot(filename));
+
+        World loaded_world;
+        Assert(loaded_world.load_snapshot(filename));
+        std::remove(filename.c_str());
+        Assert(loaded_world.step_count == world.step_count);
+        Assert(loaded_world.contact_solver.get_impulse_cache().size() == world.contact_solver.get_impulse_cache().size());
+
+        for(int step = 0; step < 50; step++) {
+            world.step(1.0 / 30);
+            loaded_world.step(1.0 / 30);
+        }
+        for(int i = 0; i < world.cubes.size(); i++) {
+            Assert(loaded_world.cubes[i].trajectory.orientation.center_of_mass == world.cubes[i].trajectory.orientation.center_of_mass);
+            Assert(loaded_world.cubes[i].trajectory.rotational_velocity.rotation == world.cubes[i].trajectory.rotational_velocity.rotation);
+            Assert(loaded_world.sleep_manager.is_sleeping(i) == world.sleep_manager.is_sleeping(i));
+        }
+
+        Assert(!loaded_world.load_snapshot("missing_file.cubesnap"));
+    }
+);
@@ -0,0 +1,348 @@
+/* Binary recording of how the cubes move over time
+ * The recording is written in chunks while the simulation runs, so it never has to be kept in memory
+ *
+ * File layout, all numbers are little endian:
+ *  header: "CUBEREC" + '\0', uint32 version,
+ *      uint32 step field count, then for each field: uint32 name length, name, uint32 value count
+ *      uint32 cube field count, then the cube fields in the same way
+ *  chunks: "CHNK", uint32 step count, uint32 cube count,
+ *      then for each step: the step fields followed by the cube fields of each cube, as float64
+*/
+#include "N12_world.h"
+#include <ostream>
+#include <istream>
+#include <cstdint>
+#include <algorithm>
+
+/**
+ * Describes one value that is recorded, e.g. a position which is 3 numbers
+*/
+struct RecordingField {
+    std::string name;
+    uint32_t value_count;
+};
+
+const uint32_t TRAJECTORY_RECORDING_VERSION = 3; // Version 2 added the step counters, version 3 pairs_rejected_cached_axis
+
+// Recorded once per step, the counters are from World::step_counters
+inline std::vector<RecordingField> get_recording_step_fields() {
+    return {
+        {"time_s", 1},
+        {"candidate_pairs", 1},
+        {"pairs_tested", 1},
+        {"pairs_rejected_faces1", 1},
+        {"pairs_rejected_faces2", 1},
+        {"pairs_rejected_edge_pairs", 1},
+        {"contacts", 1},
+        {"impulses_applied", 1},
+        {"awake_cubes", 1},
+        {"heap_allocations", 1},
+        {"pairs_rejected_cached_axis", 1}
+    };
+}
+// Recorded once per cube and step
+inline std::vector<RecordingField> get_recording_cube_fields() {
+    return {
+        {"position_m", 3},
+        {"quaternion_wxyz", 4},
+        {"linear_velocity_m_s", 3},
+        {"rotational_velocity_rad_s", 3},
+        {"kinetic_energy_J", 1},
+        {"potential_energy_J", 1}
+    };
+}
+/**
+ * Convert values between the native byte order and little endian, the same call converts in both directions
+ *  Does nothing on little endian platforms, which is almost all of them
+*/
+template<class T>
+inline void convert_little_endian(T* values, size_t count) {
+    const uint16_t one = 1;
+    if(*reinterpret_cast<const uint8_t*>(&one) == 1) {
+        return;
+    }
+    for(size_t i = 0; i < count; i++) {
+        uint8_t* bytes = reinterpret_cast<uint8_t*>(&values[i]);
+        std::reverse(bytes, bytes + sizeof(T));
+    }
+}
+
+inline int get_recording_value_count(const std::vector<RecordingField>& fields) {
+    int value_count = 0;
+    for(int i = 0; i < fields.size(); i++) {
+        value_count += fields[i].value_count;
+    }
+    return value_count;
+}
+
+/**
+ * Writes the recording to a stream, e.g. a std::ofstream
+ *  The steps are kept in a small buffer and written as a chunk once steps_per_chunk steps have been recorded
+*/
+class TrajectoryRecordingWriter {
+    std::ostream* _output = nullptr;
+    std::vector<double> _chunk_values;
+    uint32_t _chunk_step_count = 0;
+    uint32_t _chunk_cube_count = 0;
+
+    void _write_uint32(uint32_t value) {
+        convert_little_endian(&value, 1);
+        _output->write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    void _write_fields(const std::vector<RecordingField>& fields) {
+        _write_uint32(fields.size());
+        for(int i = 0; i < fields.size(); i++) {
+            _write_uint32(fields[i].name.size());
+            _output->write(fields[i].name.data(), fields[i].name.size());
+            _write_uint32(fields[i].value_count);
+        }
+    }
+    inline void _add_vec3(const glm::dvec3& vec) {
+        _chunk_values.push_back(vec.x);
+        _chunk_values.push_back(vec.y);
+        _chunk_values.push_back(vec.z);
+    }
+public:
+    int steps_per_chunk = 64;
+
+    // A writer without an output, it ignores all steps until another writer is moved into it
+    TrajectoryRecordingWriter() {}
+    TrajectoryRecordingWriter(std::ostream& output) {
+        _output = &output;
+        _output->write("CUBEREC\0", 8);
+        _write_uint32(TRAJECTORY_RECORDING_VERSION);
+        _write_fields(get_recording_step_fields());
+        _write_fields(get_recording_cube_fields());
+    }
+    // Only one writer can own the output, otherwise the same steps could be written twice
+    TrajectoryRecordingWriter(const TrajectoryRecordingWriter&) = delete;
+    TrajectoryRecordingWriter& operator=(const TrajectoryRecordingWriter&) = delete;
+    TrajectoryRecordingWriter(TrajectoryRecordingWriter&& other) {
+        *this = std::move(other);
+    }
+    TrajectoryRecordingWriter& operator=(TrajectoryRecordingWriter&& other) {
+        if(this != &other) {
+            flush();
+            _output = other._output;
+            _chunk_values.swap(other._chunk_values);
+            _chunk_step_count = other._chunk_step_count;
+            _chunk_cube_count = other._chunk_cube_count;
+            steps_per_chunk = other.steps_per_chunk;
+            other._output = nullptr;
+            other._chunk_values.clear();
+            other._chunk_step_count = 0;
+        }
+        return *this;
+    }
+    // The last steps are written even if flush was not called, the output has to still be open
+    ~TrajectoryRecordingWriter() {
+        flush();
+    }
+
+    /**
+     * Add the current state of the world to the recording
+    */
+    void record_step(World& world) {
+        if(_output == nullptr) {
+            return;
+        }
+        if(_chunk_step_count != 0 && _chunk_cube_count != world.cubes.size()) {
+            flush(); // All steps in a chunk have the same number of cubes
+        }
+        _chunk_cube_count = world.cubes.size();
+        const StepCounters& counters = world.step_counters;
+        _chunk_values.push_back(world.simulated_time_s);
+        _chunk_values.push_back(counters.candidate_pairs);
+        _chunk_values.push_back(counters.pairs_tested);
+        _chunk_values.push_back(counters.pairs_rejected_faces1);
+        _chunk_values.push_back(counters.pairs_rejected_faces2);
+        _chunk_values.push_back(counters.pairs_rejected_edge_pairs);
+        _chunk_values.push_back(counters.contacts);
+        _chunk_values.push_back(counters.impulses_applied);
+        _chunk_values.push_back(counters.awake_cubes);
+        _chunk_values.push_back(counters.heap_allocations);
+        _chunk_values.push_back(counters.pairs_rejected_cached_axis);
+        for(int i = 0; i < world.cubes.size(); i++) {
+            Cube& cube = world.cubes[i];
+            const ObjectTrajectory& trajectory = cube.trajectory;
+            const glm::dquat& quaternion = trajectory.orientation.rotational_orientation.quaternion;
+            _add_vec3(trajectory.orientation.center_of_mass);
+            _chunk_values.push_back(quaternion.w);
+            _chunk_values.push_back(quaternion.x);
+            _chunk_values.push_back(quaternion.y);
+            _chunk_values.push_back(quaternion.z);
+            _add_vec3(trajectory.linear_velocity.speed_m_per_s);
+            _add_vec3(trajectory.rotational_velocity.rotation);
+            ObjectEnergyInfo energy = get_cube_energy_information(cube, -world.gravity_m_s2.y);
+            _chunk_values.push_back(energy.linear_kin_energy + energy.rotational_kin_energy);
+            _chunk_values.push_back(energy.potential_energy);
+        }
+        _chunk_step_count += 1;
+        if(_chunk_step_count >= steps_per_chunk) {
+            flush();
+        }
+    }
+
+    /**
+     * Write the steps that have not been written yet, call it before reading the recording
+    */
+    void flush() {
+        if(_output == nullptr || _chunk_step_count == 0) {
+            return;
+        }
+        _output->write("CHNK", 4);
+        _write_uint32(_chunk_step_count);
+        _write_uint32(_chunk_cube_count);
+        convert_little_endian(_chunk_values.data(), _chunk_values.size());
+        _output->write(reinterpret_cast<const char*>(_chunk_values.data()), _chunk_values.size() * sizeof(double));
+        _output->flush();
+        _chunk_values.clear();
+        _chunk_step_count = 0;
+    }
+};
+
+/**
+ * One step read from a recording
+*/
+struct RecordedStep {
+    std::vector<double> step_values; // In the order of the step fields
+    std::vector<double> cube_values; // For each cube, the values in the order of the cube fields
+    int cube_count = 0;
+};
+
+/**
+ * Reads a recording one step at a time
+*/
+class TrajectoryRecordingReader {
+    std::istream* _input = nullptr;
+    uint32_t _chunk_steps_left = 0;
+    uint32_t _chunk_cube_count = 0;
+
+    uint32_t _read_uint32() {
+        uint32_t value = 0;
+        _input->read(reinterpret_cast<char*>(&value), sizeof(value));
+        convert_little_endian(&value, 1);
+        return value;
+    }
+    std::vector<RecordingField> _read_fields() {
+        std::vector<RecordingField> fields = std::vector<RecordingField>(_read_uint32());
+        for(int i = 0; i < fields.size(); i++) {
+            fields[i].name.resize(_read_uint32());
+            _input->read(&fields[i].name[0], fields[i].name.size());
+            fields[i].value_count = _read_uint32();
+        }
+        return fields;
+    }
+public:
+    uint32_t version = 0;
+    std::vector<RecordingField> step_fields;
+    std::vector<RecordingField> cube_fields;
+
+    TrajectoryRecordingReader(std::istream& input) {
+        _input = &input;
+        char magic[8];
+        _input->read(magic, 8);
+        if(!*_input || std::string(magic, 8) != std::string("CUBEREC\0", 8)) {
+            ThrowError("Not a cube trajectory recording");
+        }
+        version = _read_uint32();
+        step_fields = _read_fields();
+        cube_fields = _read_fields();
+    }
+
+    /**
+     * @return false if there are no more steps
+    */
+    bool read_step(RecordedStep& step) {
+        if(_chunk_steps_left == 0) {
+            char magic[4];
+            _input->read(magic, 4);
+            if(!*_input) {
+                return false;
+            }
+            if(std::string(magic, 4) != "CHNK") {
+                ThrowError("Broken chunk in cube trajectory recording");
+            }
+            _chunk_steps_left = _read_uint32();
+            _chunk_cube_count = _read_uint32();
+        }
+        step.cube_count = _chunk_cube_count;
+        step.step_values.resize(get_recording_value_count(step_fields));
+        step.cube_values.resize(get_recording_value_count(cube_fields) * _chunk_cube_count);
+        _input->read(reinterpret_cast<char*>(step.step_values.data()), step.step_values.size() * sizeof(double));
+        _input->read(reinterpret_cast<char*>(step.cube_values.data()), step.cube_values.size() * sizeof(double));
+        convert_little_endian(step.step_values.data(), step.step_values.size());
+        convert_little_endian(step.cube_values.data(), step.cube_values.size());
+        _chunk_steps_left -= 1;
+        return (bool)*_input;
+    }
+};
+TestWrapper(TEST_TrajectoryRecording_write_and_read,
+    /** Reading the recording should give back exactly the values that were recorded
+    */
+    void test() {
+        World world;
+        world.planes.push_back(vicmil::Plane());
+        world.cubes.resize(2);
+        world.cubes[1].trajectory.orientation.center_of_mass = glm::dvec3(0.1, 3.123456789, 0);
+
+        std::stringstream stream;
+        TrajectoryRecordingWriter writer = TrajectoryRecordingWriter(stream);
+        writer.steps_per_chunk = 4;
+        std::vector<World> recorded_worlds;
+        for(int i = 0; i < 10; i++) {
+            world.step(1.0 / 30);
+            writer.record_step(world);
+            recorded_worlds.push_back(world);
+        }
+        writer.flush();
+
+        TrajectoryRecordingReader reader = TrajectoryRecordingReader(stream);
+        Assert(reader.version == TRAJECTORY_RECORDING_VERSION);
+        Assert(reader.cube_fields.size() == get_recording_cube_fields().size());
+        int values_per_cube = get_recording_value_count(reader.cube_fields);
+        RecordedStep step;
+        for(int i = 0; i < recorded_worlds.size(); i++) {
+            Assert(reader.read_step(step));
+            Assert(step.cube_count == 2);
+            Assert(step.step_values[0] == recorded_worlds[i].simulated_time_s);
+            Assert(step.step_values[1] == recorded_worlds[i].step_counters.candidate_pairs);
+            Assert(step.step_values[6] == recorded_worlds[i].step_counters.contacts);
+            Assert(step.step_values[8] == recorded_worlds[i].step_counters.awake_cubes);
+            glm::dvec3 position = recorded_worlds[i].cubes[1].trajectory.orientation.center_of_mass;
+            Assert(step.cube_values[values_per_cube + 0] == position.x);
+            Assert(step.cube_values[values_per_cube + 1] == position.y);
+            Assert(step.cube_values[values_per_cube + 2] == position.z);
+        }
+        Assert(!reader.read_step(step));
+    }
+);
+TestWrapper(TEST_TrajectoryRecordingWriter_without_flush,
+    /** A writer without an output should ignore the steps, and the last steps should be written when the writer is destroyed
+    */
+    void test() {
+        World world;
+        world.cubes.resize(1);
+        TrajectoryRecordingWriter writer;
+        writer.record_step(world);
+        writer.flush();
+
+        std::stringstream stream;
+        {
+            writer = TrajectoryRecordingWriter(stream);
+            for(int i = 0; i < 3; i++) {
+                world.step(1.0 / 30);
+                writer.record_step(world);
+            }
+            TrajectoryRecordingWriter moved_writer = std::move(writer);
+            writer.record_step(world); // Does nothing, the output was moved
+        }
+        TrajectoryRecordingReader reader = TrajectoryRecordingReader(stream);
+        RecordedStep step;
+        for(int i = 0; i < 3; i++) {
+            Assert(reader.read_step(step));
+        }
+        Assert(step.step_values[0] == world.simulated_time_s);
+        Assert(!reader.read_step(step));
+    }
+);
@@ -0,0 +1,149 @@
+/* Load the starting state of a world from a json scene, so runs can be set up without recompiling
+ *
+ * Scene layout, every key is optional:
+ *  "gravity_m_s2": [x, y, z]
+ *  "cube_cube_restitution_constant": number, "cube_plane_restitution_constant": number
+ *  "planes": [{"point_m": [x, y, z], "normal": [x, y, z]}, ...]
+ *  "cubes": [{"position_m": [x, y, z], "quaternion_wxyz": [w, x, y, z], "linear_velocity_m_s": [x, y, z],
+ *      "rotational_velocity_rad_s": [x, y, z], "side_length_m": number, "mass_kg": number}, ...]
+ *  "cube_generators": [{"count": number, "seed": number, "min_position_m": [x, y, z], "max_position_m": [x, y, z],
+ *      "random_rotation": true/false, and the same cube keys as above except position_m}, ...]
+ *      The generators add many cubes at random positions, the same seed always gives the same cubes
+*/
+#include "N13_trajectory_recording.h"
+#include <random>
+
+inline double get_json_double(const vicmil::json::Json& json, const std::string& key, double default_value) {
+    if(!json.contains(key)) {
+        return default_value;
+    }
+    return json.at(key).get_double();
+}
+inline glm::dvec3 get_json_vec3(const vicmil::json::Json& json, const std::string& key, glm::dvec3 default_value) {
+    if(!json.contains(key)) {
+        return default_value;
+    }
+    const std::vector<double>& values = json.at(key).get_double_vec();
+    if(values.size() != 3) {
+        ThrowError(key << " should have 3 values");
+    }
+    return glm::dvec3(values[0], values[1], values[2]);
+}
+
+/**
+ * Set the properties of a cube from the json, properties that are not in the json are left as they are
+*/
+void set_cube_from_json(Cube& cube, const vicmil::json::Json& json) {
+    ObjectTrajectory& trajectory = cube.trajectory;
+    trajectory.orientation.center_of_mass = get_json_vec3(json, "position_m", trajectory.orientation.center_of_mass);
+    if(json.contains("quaternion_wxyz")) {
+        const std::vector<double>& values = json.at("quaternion_wxyz").get_double_vec();
+        if(values.size() != 4) {
+            ThrowError("quaternion_wxyz should have 4 values");
+        }
+        glm::dquat quaternion = glm::normalize(glm::dquat(values[0], values[1], values[2], values[3]));
+        trajectory.orientation.rotational_orientation = Rotation::from_quaternion(quaternion);
+    }
+    trajectory.linear_velocity.speed_m_per_s = get_json_vec3(json, "linear_velocity_m_s", trajectory.linear_velocity.speed_m_per_s);
+    trajectory.rotational_velocity.rotation = get_json_vec3(json, "rotational_velocity_rad_s", trajectory.rotational_velocity.rotation);
+    cube.side_length_m = get_json_double(json, "side_length_m", cube.side_length_m);
+    cube.mass_kg = get_json_double(json, "mass_kg", cube.mass_kg);
+}
+
+/**
+ * Add the cubes of a cube generator to the world
+ *  The random numbers are taken straight from the generator, so the cubes are the same on every platform
+*/
+void add_generated_cubes(World& world, const vicmil::json::Json& generator) {
+    int count = get_json_double(generator, "count", 0);
+    std::mt19937 random_generator = std::mt19937((uint32_t)get_json_double(generator, "seed", 0));
+    auto get_random_0_to_1 = [&]() {
+        return random_generator() / 4294967296.0;
+    };
+    glm::dvec3 min_position_m = get_json_vec3(generator, "min_position_m", glm::dvec3(0, 0, 0));
+    glm::dvec3 max_position_m = get_json_vec3(generator, "max_position_m", min_position_m);
+    bool random_rotation = get_json_double(generator, "random_rotation", 1) != 0;
+
+    Cube template_cube = Cube();
+    set_cube_from_json(template_cube, generator);
+    world.cubes.reserve(world.cubes.size() + count);
+    for(int i = 0; i < count; i++) {
+        Cube cube = template_cube;
+        glm::dvec3 random_factor = glm::dvec3(get_random_0_to_1(), get_random_0_to_1(), get_random_0_to_1());
+        cube.trajectory.orientation.center_of_mass = min_position_m + (max_position_m - min_position_m) * random_factor;
+        if(random_rotation) {
+            double rad = 2 * vicmil::PI * get_random_0_to_1();
+            glm::dvec3 axis = glm::dvec3(get_random_0_to_1(), get_random_0_to_1(), get_random_0_to_1()) + glm::dvec3(0.0001, 0, 0);
+            cube.trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation(rad, glm::normalize(axis));
+        }
+        world.cubes.push_back(cube);
+    }
+}
+
+/**
+ * Create a world from a json scene, see the top of this file for the layout
+*/
+World load_scene(const vicmil::json::Json& scene) {
+    World world;
+    world.gravity_m_s2 = get_json_vec3(scene, "gravity_m_s2", world.gravity_m_s2);
+    world.cube_cube_restitution_constant = get_json_double(scene, "cube_cube_restitution_constant", world.cube_cube_restitution_constant);
+    world.cube_plane_restitution_constant = get_json_double(scene, "cube_plane_restitution_constant", world.cube_plane_restitution_constant);
+
+    if(scene.contains("planes")) {
+        for(const vicmil::json::Json& plane_json : scene.at("planes").get_array()) {
+            vicmil::Plane plane;
+            plane.point = get_json_vec3(plane_json, "point_m", plane.point);
+            plane.normal = get_json_vec3(plane_json, "normal", plane.normal);
+            world.planes.push_back(plane);
+        }
+    }
+    if(scene.contains("cubes")) {
+        const std::vector<vicmil::json::Json>& cubes = scene.at("cubes").get_array();
+        world.cubes.reserve(cubes.size());
+        for(int i = 0; i < cubes.size(); i++) {
+            Cube cube = Cube();
+            set_cube_from_json(cube, cubes[i]);
+            world.cubes.push_back(cube);
+        }
+    }
+    if(scene.contains("cube_generators")) {
+        for(const vicmil::json::Json& generator : scene.at("cube_generators").get_array()) {
+            add_generated_cubes(world, generator);
+        }
+    }
+    return world;
+}
+/**
+ * Create a world from a json scene file
+ *  Throws vicmil::json::JsonParseError if the file is not valid json, e.g. if it is cut off or missing
+*/
+World load_scene_file(const std::string& filename) {
+    std::string text = vicmil::read_file_contents(filename);
+    return load_scene(vicmil::json::Json::parse(text));
+}
+TestWrapper(TEST_load_scene,
+    void test() {
+        std::string text = R"({
+            "gravity_m_s2": [0, -9.82, 0],
+            "planes": [{"point_m": [0, 0, 0], "normal": [0, 1, 0]}],
+            "cubes": [{"position_m": [1, 2, 3], "linear_velocity_m_s": [0, -1, 0], "mass_kg": 5}],
+            "cube_generators": [{"count": 1000, "seed": 3, "min_position_m": [-10, 1, -10], "max_position_m": [10, 20, 10], "side_length_m": 0.5}]
+        })";
+        World world = load_scene(vicmil::json::Json::parse(text));
+        Assert(world.gravity_m_s2.y == -9.82);
+        Assert(world.planes.size() == 1);
+        Assert(world.cubes.size() == 1001);
+        Assert(world.cubes[0].trajectory.orientation.center_of_mass == glm::dvec3(1, 2, 3));
+        Assert(world.cubes[0].trajectory.linear_velocity.speed_m_per_s == glm::dvec3(0, -1, 0));
+        Assert(world.cubes[0].mass_kg == 5);
+        for(int i = 1; i < world.cubes.size(); i++) {
+            glm::dvec3 position = world.cubes[i].trajectory.orientation.center_of_mass;
+            Assert(position.x >= -10 && position.x <= 10 && position.y >= 1 && position.y <= 20);
+            Assert(world.cubes[i].side_length_m == 0.5);
+        }
+
+        // The same seed should give the same cubes
+        World world2 = load_scene(vicmil::json::Json::parse(text));
+        Assert(world2.cubes[500].trajectory.orientation.center_of_mass == world.cubes[500].trajectory.orientation.center_of_mass);
+    }
+);
@@ -0,0 +1,1061 @@
+/* Collision between any convex shapes: spheres, boxes, capsules and convex hulls
+ * Every shape only has to tell its support point, the point furthest along a direction. GJK uses those to find the
+ * distance between two shapes, and if they overlap EPA finds how far they overlap.
+ * Spheres and capsules are handled as a point or a line segment plus a radius(the margin). GJK runs on the
+ * point or segment, so shapes that only overlap in their margins never need EPA, and GJK converges in a few steps
+ * The pairs that are common and have faster exact functions(e.g. box against box with the separating axis test)
+ * use those instead, see ConvexCollisionDispatcher
+*/
+#include "N14_scene_loading.h"
+
+enum ConvexShapeType {
+    CONVEX_SHAPE_SPHERE,
+    CONVEX_SHAPE_BOX,
+    CONVEX_SHAPE_CAPSULE,
+    CONVEX_SHAPE_HULL,
+    CONVEX_SHAPE_TYPE_COUNT
+};
+
+/**
+ * The shape of a convex object in its own coordinate system, centered at the origin
+*/
+struct ConvexShape {
+    ConvexShapeType type = CONVEX_SHAPE_SPHERE;
+    double radius_m = 0; // Sphere and capsule
+    glm::dvec3 half_extents_m = glm::dvec3(0, 0, 0); // Box
+    double half_height_m = 0; // Capsule, the line segment goes from -half_height_m to half_height_m along the y axis
+    std::vector<glm::dvec3> hull_points; // Convex hull, the points do not all have to be corners
+
+    static ConvexShape sphere(double radius_m) {
+        ConvexShape shape;
+        shape.type = CONVEX_SHAPE_SPHERE;
+        shape.radius_m = radius_m;
+        return shape;
+    }
+    static ConvexShape box(const glm::dvec3& half_extents_m) {
+        ConvexShape shape;
+        shape.type = CONVEX_SHAPE_BOX;
+        shape.half_extents_m = half_extents_m;
+        return shape;
+    }
+    static ConvexShape capsule(double radius_m, double half_height_m) {
+        ConvexShape shape;
+        shape.type = CONVEX_SHAPE_CAPSULE;
+        shape.radius_m = radius_m;
+        shape.half_height_m = half_height_m;
+        return shape;
+    }
+    static ConvexShape hull(const std::vector<glm::dvec3>& points) {
+        if(points.size() == 0) {
+            ThrowError("A convex hull needs at least one point");
+        }
+        ConvexShape shape;
+        shape.type = CONVEX_SHAPE_HULL;
+        shape.hull_points = points;
+        return shape;
+    }
+    static ConvexShape from_sphere(const Sphere& sphere) {
+        return ConvexShape::sphere(sphere.radious);
+    }
+    static ConvexShape from_cube(const Cube& cube) {
+        double half_side_length_m = cube.side_length_m / 2;
+        return ConvexShape::box(glm::dvec3(half_side_length_m, half_side_length_m, half_side_length_m));
+    }
+
+    inline bool is_cube() const {
+        return type == CONVEX_SHAPE_BOX && half_extents_m.x == half_extents_m.y && half_extents_m.x == half_extents_m.z;
+    }
+    // The radius around the core shape, see get_local_core_support_point
+    inline double get_margin_m() const {
+        return (type == CONVEX_SHAPE_SPHERE || type == CONVEX_SHAPE_CAPSULE) ? radius_m : 0;
+    }
+    /**
+     * Get the point of the shape without its margin that is furthest along the direction
+     *  The core of a sphere is its center, and the core of a capsule is its line segment
+    */
+    glm::dvec3 get_local_core_support_point(const glm::dvec3& direction) const {
+        if(type == CONVEX_SHAPE_BOX) {
+            return glm::dvec3(
+                direction.x >= 0 ? half_extents_m.x : -half_extents_m.x,
+                direction.y >= 0 ? half_extents_m.y : -half_extents_m.y,
+                direction.z >= 0 ? half_extents_m.z : -half_extents_m.z);
+        }
+        if(type == CONVEX_SHAPE_CAPSULE) {
+            return glm::dvec3(0, direction.y >= 0 ? half_height_m : -half_height_m, 0);
+        }
+        if(type == CONVEX_SHAPE_HULL) {
+            int furthest_index = 0;
+            double furthest_distance = glm::dot(hull_points[0], direction);
+            for(int i = 1; i < hull_points.size(); i++) {
+                double distance = glm::dot(hull_points[i], direction);
+                if(distance > furthest_distance) {
+                    furthest_distance = distance;
+                    furthest_index = i;
+                }
+            }
+            return hull_points[furthest_index];
+        }
+        return glm::dvec3(0, 0, 0);
+    }
+};
+
+/**
+ * A convex shape placed in the world
+ *  The shape is not copied, so it has to be kept alive as long as the body is used
+*/
+struct ConvexBody {
+    const ConvexShape* shape = nullptr;
+    glm::dvec3 position = glm::dvec3(0, 0, 0);
+    glm::dmat3x3 rotation_matrix = glm::dmat3x3(1.0); // The columns are the axis of the shape in world space
+
+    static ConvexBody from_orientation(const ConvexShape& shape, const ObjectOrientation& orientation) {
+        ConvexBody body;
+        body.shape = &shape;
+        body.position = orientation.center_of_mass;
+        body.rotation_matrix = orientation.rotational_orientation.to_matrix3x3();
+        return body;
+    }
+
+    /**
+     * Get the point of the body that is furthest along the direction, in world space
+     * @param include_margin If false, the margin of spheres and capsules is left out, see ConvexShape::get_margin_m
+    */
+    inline glm::dvec3 get_support_point(const glm::dvec3& direction, bool include_margin) const {
+        glm::dvec3 local_direction = glm::transpose(rotation_matrix) * direction;
+        glm::dvec3 support_point = position + rotation_matrix * shape->get_local_core_support_point(local_direction);
+        double margin_m = shape->get_margin_m();
+        if(include_margin && margin_m > 0) {
+            double length = glm::length(direction);
+            if(length > 0) {
+                support_point += direction * (margin_m / length);
+            }
+        }
+        return support_point;
+    }
+};
+
+/**
+ * How two convex bodies touch, with the same conventions as IntersectionResolution so it can be given to the contact solver
+*/
+struct ConvexCollision {
+    bool is_collision = false;
+    glm::dvec3 normal = glm::dvec3(0, 1, 0); // The direction to push body1, body2 is pushed in the opposite direction
+    double penetration_depth_m = 0; // The deepest point
+    ContactManifold manifold;
+};
+
+/**
+ * A point on the Minkowski difference of two bodies(every point of body1 minus every point of body2)
+ *  The two bodies overlap if the difference contains the origin, and the distance between the bodies
+ *  is the distance from the origin to the difference
+*/
+struct SupportPoint {
+    glm::dvec3 point; // point1 - point2
+    glm::dvec3 point1; // The point on body1
+    glm::dvec3 point2; // The point on body2
+};
+inline SupportPoint get_minkowski_support_point(const ConvexBody& body1, const ConvexBody& body2, const glm::dvec3& direction, bool include_margins) {
+    SupportPoint support_point;
+    support_point.point1 = body1.get_support_point(direction, include_margins);
+    support_point.point2 = body2.get_support_point(-direction, include_margins);
+    support_point.point = support_point.point1 - support_point.point2;
+    return support_point;
+}
+
+/**
+ * Up to 4 points of the Minkowski difference, and the point in them closest to the origin as a weighted sum of them
+*/
+struct GjkSimplex {
+    SupportPoint points[4];
+    double weights[4];
+    int point_count = 0;
+
+    inline void add_point(const SupportPoint& point, double weight) {
+        points[point_count] = point;
+        weights[point_count] = weight;
+        point_count += 1;
+    }
+    glm::dvec3 get_closest_point() const {
+        glm::dvec3 closest_point = glm::dvec3(0, 0, 0);
+        for(int i = 0; i < point_count; i++) {
+            closest_point += points[i].point * weights[i];
+        }
+        return closest_point;
+    }
+    // The points on each body that the closest point comes from
+    void get_closest_points(glm::dvec3& closest_point1, glm::dvec3& closest_point2) const {
+        closest_point1 = glm::dvec3(0, 0, 0);
+        closest_point2 = glm::dvec3(0, 0, 0);
+        for(int i = 0; i < point_count; i++) {
+            closest_point1 += points[i].point1 * weights[i];
+            closest_point2 += points[i].point2 * weights[i];
+        }
+    }
+};
+
+/**
+ * Find the point on the line segment closest to the origin
+ * @param closest Set to the points needed to describe the closest point, and their weights
+*/
+void get_closest_simplex_on_segment(const SupportPoint& a, const SupportPoint& b, GjkSimplex& closest) {
+    closest.point_count = 0;
+    glm::dvec3 ab = b.point - a.point;
+    double length2 = glm::dot(ab, ab);
+    double t = length2 > 0 ? -glm::dot(a.point, ab) / length2 : 0;
+    if(t <= 0) {
+        closest.add_point(a, 1);
+    }
+    else if(t >= 1) {
+        closest.add_point(b, 1);
+    }
+    else {
+        closest.add_point(a, 1 - t);
+        closest.add_point(b, t);
+    }
+}
+
+/**
+ * Find the point on the triangle closest to the origin, by finding which corner, edge or the face it is closest to
+ *  See "Real-Time Collision Detection" by Christer Ericson, 5.1.5
+*/
+void get_closest_simplex_on_triangle(const SupportPoint& a, const SupportPoint& b, const SupportPoint& c, GjkSimplex& closest) {
+    closest.point_count = 0;
+    glm::dvec3 ab = b.point - a.point;
+    glm::dvec3 ac = c.point - a.point;
+    // If all the corners are on a line, the closest point is on one of the edges
+    if(glm::length2(glm::cross(ab, ac)) <= 1e-20 * glm::length2(ab) * glm::length2(ac)) {
+        const SupportPoint* edges[3][2] = {{&a, &b}, {&a, &c}, {&b, &c}};
+        double min_distance2 = std::numeric_limits<double>::infinity();
+        GjkSimplex edge_closest = GjkSimplex(); // Zeroed, so copying the unused points and weights is well defined
+        for(int i = 0; i < 3; i++) {
+            get_closest_simplex_on_segment(*edges[i][0], *edges[i][1], edge_closest);
+            double distance2 = glm::length2(edge_closest.get_closest_point());
+            if(distance2 < min_distance2) {
+                min_distance2 = distance2;
+                closest = edge_closest;
+            }
+        }
+        return;
+    }
+    double d1 = -glm::dot(ab, a.point);
+    double d2 = -glm::dot(ac, a.point);
+    if(d1 <= 0 && d2 <= 0) {
+        closest.add_point(a, 1);
+        return;
+    }
+    double d3 = -glm::dot(ab, b.point);
+    double d4 = -glm::dot(ac, b.point);
+    if(d3 >= 0 && d4 <= d3) {
+        closest.add_point(b, 1);
+        return;
+    }
+    double vc = d1 * d4 - d3 * d2;
+    if(vc <= 0 && d1 >= 0 && d3 <= 0) {
+        double v = d1 / (d1 - d3);
+        closest.add_point(a, 1 - v);
+        closest.add_point(b, v);
+        return;
+    }
+    double d5 = -glm::dot(ab, c.point);
+    double d6 = -glm::dot(ac, c.point);
+    if(d6 >= 0 && d5 <= d6) {
+        closest.add_point(c, 1);
+        return;
+    }
+    double vb = d5 * d2 - d1 * d6;
+    if(vb <= 0 && d2 >= 0 && d6 <= 0) {
+        double w = d2 / (d2 - d6);
+        closest.add_point(a, 1 - w);
+        closest.add_point(c, w);
+        return;
+    }
+    double va = d3 * d6 - d5 * d4;
+    if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) {
+        double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+        closest.add_point(b, 1 - w);
+        closest.add_point(c, w);
+        return;
+    }
+    double v = vb / (va + vb + vc);
+    double w = vc / (va + vb + vc);
+    closest.add_point(a, 1 - v - w);
+    closest.add_point(b, v);
+    closest.add_point(c, w);
+}
+
+/**
+ * Find the point on the tetrahedron closest to the origin
+ *  Only the faces that have the origin on their outside can have the closest point
+ * @return true if the origin is inside the tetrahedron, then closest is all four points
+*/
+bool get_closest_simplex_on_tetrahedron(const SupportPoint& a, const SupportPoint& b, const SupportPoint& c, const SupportPoint& d, GjkSimplex& closest) {
+    // The three corners of each face, and the corner that is not on it
+    const SupportPoint* faces[4][4] = {{&a, &b, &c, &d}, {&a, &c, &d, &b}, {&a, &d, &b, &c}, {&b, &d, &c, &a}};
+    // A flat tetrahedron can not contain the origin, so then all faces are tested
+    glm::dvec3 ab = b.point - a.point;
+    glm::dvec3 ac = c.point - a.point;
+    glm::dvec3 ad = d.point - a.point;
+    bool flat = std::abs(glm::dot(ab, glm::cross(ac, ad))) <= 1e-12 * glm::length(ab) * glm::length(ac) * glm::length(ad);
+    bool origin_outside = false;
+    double min_distance2 = std::numeric_limits<double>::infinity();
+    for(int f = 0; f < 4; f++) {
+        const SupportPoint& p0 = *faces[f][0];
+        const SupportPoint& p1 = *faces[f][1];
+        const SupportPoint& p2 = *faces[f][2];
+        glm::dvec3 normal = glm::cross(p1.point - p0.point, p2.point - p0.point);
+        double origin_side = -glm::dot(p0.point, normal);
+        double opposite_side = glm::dot(faces[f][3]->point - p0.point, normal);
+        if(!flat && origin_side * opposite_side >= 0) {
+            continue; // The origin is on the inside of this face
+        }
+        origin_outside = true;
+        GjkSimplex face_closest;
+        get_closest_simplex_on_triangle(p0, p1, p2, face_closest);
+        double distance2 = glm::length2(face_closest.get_closest_point());
+        if(distance2 < min_distance2) {
+            min_distance2 = distance2;
+            closest = face_closest;
+        }
+    }
+    if(origin_outside) {
+        return false;
+    }
+    closest.point_count = 0;
+    closest.add_point(a, 0.25);
+    closest.add_point(b, 0.25);
+    closest.add_point(c, 0.25);
+    closest.add_point(d, 0.25);
+    return true;
+}
+
+struct GjkResult {
+    bool intersecting = false;
+    double distance_m = 0; // Between the cores of the bodies, only set if they do not intersect
+    glm::dvec3 closest_point1 = glm::dvec3(0, 0, 0); // The closest point on the core of body1, only set if they do not intersect
+    glm::dvec3 closest_point2 = glm::dvec3(0, 0, 0);
+    GjkSimplex simplex; // If they intersect, the points around the origin, see get_epa_penetration
+};
+
+/**
+ * Find the distance between the cores of two bodies with GJK, the margins are not included, see ConvexShape::get_margin_m
+ *  The simplex is moved towards the origin one support point at a time, until no support point gets any closer
+*/
+GjkResult get_gjk_distance(const ConvexBody& body1, const ConvexBody& body2) {
+    const int max_iterations = 64;
+    const double intersection_distance2 = 1e-20; // Closer than this to the origin counts as touching
+    const double relative_tolerance = 1e-10;
+
+    GjkResult result;
+    GjkSimplex& simplex = result.simplex;
+    glm::dvec3 start_direction = body2.position - body1.position;
+    if(glm::length2(start_direction) == 0) {
+        start_direction = glm::dvec3(1, 0, 0);
+    }
+    simplex.add_point(get_minkowski_support_point(body1, body2, start_direction, false), 1);
+    glm::dvec3 closest_point = simplex.points[0].point;
+    for(int iteration = 0; iteration < max_iterations; iteration++) {
+        double distance2 = glm::length2(closest_point);
+        if(distance2 <= intersection_distance2) {
+            result.intersecting = true;
+            return result;
+        }
+        SupportPoint new_point = get_minkowski_support_point(body1, body2, -closest_point, false);
+        // No point of the difference is much closer to the origin than the closest point, so it is the closest
+        if(distance2 - glm::dot(closest_point, new_point.point) <= relative_tolerance * distance2) {
+            break;
+        }
+        GjkSimplex new_simplex;
+        if(simplex.point_count == 1) {
+            get_closest_simplex_on_segment(simplex.points[0], new_point, new_simplex);
+        }
+        else if(simplex.point_count == 2) {
+            get_closest_simplex_on_triangle(simplex.points[0], simplex.points[1], new_point, new_simplex);
+        }
+        else if(get_closest_simplex_on_tetrahedron(simplex.points[0], simplex.points[1], simplex.points[2], new_point, new_simplex)) {
+            simplex = new_simplex;
+            result.intersecting = true;
+            return result;
+        }
+        glm::dvec3 new_closest_point = new_simplex.get_closest_point();
+        if(glm::length2(new_closest_point) >= distance2) {
+            break; // Rounding errors stopped it from getting any closer
+        }
+        simplex = new_simplex;
+        closest_point = new_closest_point;
+    }
+    result.distance_m = glm::length(closest_point);
+    simplex.get_closest_points(result.closest_point1, result.closest_point2);
+    return result;
+}
+/**
+ * Get the distance between the surfaces of two bodies, 0 if they intersect
+*/
+double get_convex_convex_distance_m(const ConvexBody& body1, const ConvexBody& body2) {
+    GjkResult gjk = get_gjk_distance(body1, body2);
+    if(gjk.intersecting) {
+        return 0;
+    }
+    return std::max(gjk.distance_m - body1.shape->get_margin_m() - body2.shape->get_margin_m(), 0.0);
+}
+
+TestWrapper(TEST_get_gjk_distance,
+    void test() {
+        ConvexShape box = ConvexShape::box(glm::dvec3(0.5, 1, 2));
+        ConvexShape capsule = ConvexShape::capsule(0.25, 1);
+        std::vector<glm::dvec3> tetrahedron_points = std::vector<glm::dvec3>({glm::dvec3(0, 0, 0), glm::dvec3(1, 0, 0), glm::dvec3(0, 1, 0), glm::dvec3(0, 0, 1)});
+        ConvexShape tetrahedron = ConvexShape::hull(tetrahedron_points);
+
+        // The side of the tetrahedron facing the box is 0.5m from it
+        ConvexBody body1 = ConvexBody::from_orientation(box, ObjectOrientation::centered_at_0());
+        ConvexBody body2 = ConvexBody::from_orientation(tetrahedron, ObjectOrientation::centered_at_0());
+        body2.position = glm::dvec3(1, 0.2, 0.3);
+        GjkResult result = get_gjk_distance(body1, body2);
+        Assert(!result.intersecting);
+        Assert(abs(result.distance_m - 0.5) < 0.000001);
+        Assert(abs(result.closest_point1.x - 0.5) < 0.000001);
+        Assert(abs(result.closest_point2.x - 1) < 0.000001); // A whole face of the tetrahedron is closest
+
+        // The core of the capsule is a line segment, it is 1.5m above the box, and 1.25m with the margin
+        body2 = ConvexBody::from_orientation(capsule, ObjectOrientation::centered_at_0());
+        body2.rotation_matrix = Rotation::from_axis_rotation(vicmil::PI / 2, glm::dvec3(0, 0, 1)).to_matrix3x3();
+        body2.position = glm::dvec3(0.3, 2.5, 0);
+        Assert(abs(get_gjk_distance(body1, body2).distance_m - 1.5) < 0.000001);
+        Assert(abs(get_convex_convex_distance_m(body1, body2) - 1.25) < 0.000001);
+
+        body2.position = glm::dvec3(0.3, 0.5, 0);
+        Assert(get_gjk_distance(body1, body2).intersecting);
+        Assert(get_convex_convex_distance_m(body1, body2) == 0);
+    }
+);
+
+struct EpaResult {
+    glm::dvec3 normal; // The face of the Minkowski difference closest to the origin, pointing out of it
+    double depth_m; // The distance from the origin to that face
+    glm::dvec3 point1; // The deepest point on body1
+    glm::dvec3 point2; // The deepest point on body2
+};
+
+/**
+ * The Minkowski difference, as a polytope that grows one support point at a time
+ *  Stored in fixed size arrays so that no memory has to be allocated
+*/
+struct EpaPolytope {
+    struct Face {
+        int indices[3];
+        glm::dvec3 normal; // Pointing out of the polytope
+        double distance; // From the origin to the plane of the face
+    };
+    static const int MAX_VERTICES = 64;
+    static const int MAX_FACES = 128;
+    SupportPoint vertices[MAX_VERTICES];
+    int vertex_count = 0;
+    Face faces[MAX_FACES];
+    int face_count = 0;
+
+    void add_face(int index0, int index1, int index2) {
+        Face& face = faces[face_count];
+        face.indices[0] = index0;
+        face.indices[1] = index1;
+        face.indices[2] = index2;
+        face.normal = glm::cross(vertices[index1].point - vertices[index0].point, vertices[index2].point - vertices[index0].point);
+        double length = glm::length(face.normal);
+        face.normal = length > 0 ? face.normal / length : glm::dvec3(0, 1, 0);
+        face.distance = glm::dot(face.normal, vertices[index0].point);
+        face_count += 1;
+    }
+    int get_closest_face_index() const {
+        int closest_index = 0;
+        for(int i = 1; i < face_count; i++) {
+            if(faces[i].distance < faces[closest_index].distance) {
+                closest_index = i;
+            }
+        }
+        return closest_index;
+    }
+};
+
+/**
+ * GJK can stop with fewer than 4 points when the origin is on the surface of the simplex, e.g. when the bodies
+ * just touch. Add support points of the cores until it is a tetrahedron, which is needed to start EPA
+ * @return false if the Minkowski difference of the cores is flat, so no tetrahedron can be made
+*/
+bool blow_up_simplex_to_tetrahedron(const ConvexBody& body1, const ConvexBody& body2, GjkSimplex& simplex) {
+    const double min_distance_m = 1e-10;
+    const glm::dvec3 axis_directions[6] = {
+        glm::dvec3(1, 0, 0), glm::dvec3(-1, 0, 0), glm::dvec3(0, 1, 0), glm::dvec3(0, -1, 0), glm::dvec3(0, 0, 1), glm::dvec3(0, 0, -1)
+    };
+    if(simplex.point_count == 1) {
+        for(int i = 0; i < 6 && simplex.point_count == 1; i++) {
+            SupportPoint new_point = get_minkowski_support_point(body1, body2, axis_directions[i], false);
+            if(glm::length(new_point.point - simplex.points[0].point) > min_distance_m) {
+                simplex.add_point(new_point, 0);
+            }
+        }
+    }
+    if(simplex.point_count == 2) {
+        glm::dvec3 line_direction = glm::normalize(simplex.points[1].point - simplex.points[0].point);
+        // Search in the directions around the line, starting from the axis least aligned with it
+        glm::dvec3 abs_direction = glm::abs(line_direction);
+        int axis_index = abs_direction.x <= abs_direction.y && abs_direction.x <= abs_direction.z ? 0 : (abs_direction.y <= abs_direction.z ? 2 : 4);
+        glm::dvec3 perpendicular1 = glm::normalize(glm::cross(line_direction, axis_directions[axis_index]));
+        glm::dvec3 perpendicular2 = glm::cross(line_direction, perpendicular1);
+        const glm::dvec3 search_directions[4] = {perpendicular1, -perpendicular1, perpendicular2, -perpendicular2};
+        for(int i = 0; i < 4 && simplex.point_count == 2; i++) {
+            SupportPoint new_point = get_minkowski_support_point(body1, body2, search_directions[i], false);
+            glm::dvec3 offset = new_point.point - simplex.points[0].point;
+            if(glm::length(offset - line_direction * glm::dot(offset, line_direction)) > min_distance_m) {
+                simplex.add_point(new_point, 0);
+            }
+        }
+    }
+    if(simplex.point_count == 3) {
+        glm::dvec3 normal = glm::cross(simplex.points[1].point - simplex.points[0].point, simplex.points[2].point - simplex.points[0].point);
+        normal = glm::normalize(normal);
+        for(int side = 0; side < 2 && simplex.point_count == 3; side++) {
+            SupportPoint new_point = get_minkowski_support_point(body1, body2, side == 0 ? normal : -normal, false);
+            if(std::abs(glm::dot(new_point.point - simplex.points[0].point, normal)) > min_distance_m) {
+                simplex.add_point(new_point, 0);
+            }
+        }
+    }
+    return simplex.point_count == 4;
+}
+
+/**
+ * Find how far two intersecting bodies overlap with the expanding polytope algorithm(EPA)
+ *  The polytope starts as the simplex from GJK, and is grown towards its face closest to the origin until that face
+ *  is on the surface of the Minkowski difference. The distance to that face is how far the bodies overlap
+ *  Only the cores are used, they are always polytopes so the polytope can match them exactly
+ * @param tetrahedron The simplex from get_gjk_distance after blow_up_simplex_to_tetrahedron, it has to contain the origin
+*/
+void get_epa_penetration(const ConvexBody& body1, const ConvexBody& body2, const GjkSimplex& tetrahedron, EpaResult& result) {
+    const int max_iterations = 64;
+    const double tolerance_m = 1e-9;
+
+    EpaPolytope polytope;
+    for(int i = 0; i < 4; i++) {
+        polytope.vertices[i] = tetrahedron.points[i];
+    }
+    polytope.vertex_count = 4;
+    // Make all faces point away from the corner that is not on them
+    const int tetrahedron_faces[4][4] = {{0, 1, 2, 3}, {0, 3, 1, 2}, {0, 2, 3, 1}, {1, 3, 2, 0}};
+    for(int f = 0; f < 4; f++) {
+        const int* face = tetrahedron_faces[f];
+        glm::dvec3 normal = glm::cross(polytope.vertices[face[1]].point - polytope.vertices[face[0]].point, polytope.vertices[face[2]].point - polytope.vertices[face[0]].point);
+        if(glm::dot(normal, polytope.vertices[face[3]].point - polytope.vertices[face[0]].point) > 0) {
+            polytope.add_face(face[0], face[2], face[1]);
+        }
+        else {
+            polytope.add_face(face[0], face[1], face[2]);
+        }
+    }
+
+    int closest_face_index = polytope.get_closest_face_index();
+    bool face_visible[EpaPolytope::MAX_FACES];
+    int horizon_edges[EpaPolytope::MAX_FACES * 3][2];
+    for(int iteration = 0; iteration < max_iterations && polytope.vertex_count < EpaPolytope::MAX_VERTICES; iteration++) {
+        const EpaPolytope::Face& closest_face = polytope.faces[closest_face_index];
+        SupportPoint new_point = get_minkowski_support_point(body1, body2, closest_face.normal, false);
+        if(glm::dot(new_point.point, closest_face.normal) - closest_face.distance <= tolerance_m) {
+            break; // The face is on the surface
+        }
+
+        // Remove the faces the new point can see, the edges around them form a hole that is closed with new faces
+        int visible_count = 0;
+        int horizon_edge_count = 0;
+        for(int f = 0; f < polytope.face_count; f++) {
+            const EpaPolytope::Face& face = polytope.faces[f];
+            face_visible[f] = glm::dot(face.normal, new_point.point - polytope.vertices[face.indices[0]].point) > 0;
+            if(!face_visible[f]) {
+                continue;
+            }
+            visible_count += 1;
+            for(int e = 0; e < 3; e++) {
+                int edge_start = face.indices[e];
+                int edge_end = face.indices[(e + 1) % 3];
+                // An edge shared by two visible faces is inside the hole, it is found once in each direction
+                bool shared = false;
+                for(int h = 0; h < horizon_edge_count && !shared; h++) {
+                    if(horizon_edges[h][0] == edge_end && horizon_edges[h][1] == edge_start) {
+                        horizon_edge_count -= 1;
+                        horizon_edges[h][0] = horizon_edges[horizon_edge_count][0];
+                        horizon_edges[h][1] = horizon_edges[horizon_edge_count][1];
+                        shared = true;
+                    }
+                }
+                if(!shared) {
+                    horizon_edges[horizon_edge_count][0] = edge_start;
+                    horizon_edges[horizon_edge_count][1] = edge_end;
+                    horizon_edge_count += 1;
+                }
+            }
+        }
+        if(polytope.face_count - visible_count + horizon_edge_count > EpaPolytope::MAX_FACES) {
+            break; // Out of space, use the closest face found so far
+        }
+        int kept_face_count = 0;
+        for(int f = 0; f < polytope.face_count; f++) {
+            if(!face_visible[f]) {
+                polytope.faces[kept_face_count] = polytope.faces[f];
+                kept_face_count += 1;
+            }
+        }
+        polytope.face_count = kept_face_count;
+        int new_index = polytope.vertex_count;
+        polytope.vertices[new_index] = new_point;
+        polytope.vertex_count += 1;
+        for(int h = 0; h < horizon_edge_count; h++) {
+            polytope.add_face(horizon_edges[h][0], horizon_edges[h][1], new_index);
+        }
+        closest_face_index = polytope.get_closest_face_index();
+    }
+
+    // The deepest points are where the origin projects onto the closest face
+    const EpaPolytope::Face& face = polytope.faces[closest_face_index];
+    const SupportPoint& a = polytope.vertices[face.indices[0]];
+    const SupportPoint& b = polytope.vertices[face.indices[1]];
+    const SupportPoint& c = polytope.vertices[face.indices[2]];
+    glm::dvec3 projected_origin = face.normal * face.distance;
+    glm::dvec3 v0 = b.point - a.point;
+    glm::dvec3 v1 = c.point - a.point;
+    glm::dvec3 v2 = projected_origin - a.point;
+    double d00 = glm::dot(v0, v0);
+    double d01 = glm::dot(v0, v1);
+    double d11 = glm::dot(v1, v1);
+    double d20 = glm::dot(v2, v0);
+    double d21 = glm::dot(v2, v1);
+    double denominator = d00 * d11 - d01 * d01;
+    double weight_b = denominator != 0 ? (d11 * d20 - d01 * d21) / denominator : 0;
+    double weight_c = denominator != 0 ? (d00 * d21 - d01 * d20) / denominator : 0;
+    double weight_a = 1 - weight_b - weight_c;
+    result.normal = face.normal;
+    result.depth_m = std::max(face.distance, 0.0);
+    result.point1 = a.point1 * weight_a + b.point1 * weight_b + c.point1 * weight_c;
+    result.point2 = a.point2 * weight_a + b.point2 * weight_b + c.point2 * weight_c;
+}
+
+/**
+ * Collide any two convex bodies with GJK, and EPA if their cores intersect
+ *  Gives a single contact point, halfway between the deepest points of the two bodies
+*/
+ConvexCollision get_convex_convex_collision_gjk_epa(const ConvexBody& body1, const ConvexBody& body2) {
+    ConvexCollision collision;
+    double margin1_m = body1.shape->get_margin_m();
+    double margin2_m = body2.shape->get_margin_m();
+    GjkResult gjk = get_gjk_distance(body1, body2);
+    glm::dvec3 point1;
+    glm::dvec3 point2;
+    if(!gjk.intersecting) {
+        // Only the margins overlap, the closest points of the cores give the normal
+        if(gjk.distance_m >= margin1_m + margin2_m) {
+            return collision;
+        }
+        collision.normal = (gjk.closest_point1 - gjk.closest_point2) / gjk.distance_m;
+        collision.penetration_depth_m = margin1_m + margin2_m - gjk.distance_m;
+        point1 = gjk.closest_point1 - collision.normal * margin1_m;
+        point2 = gjk.closest_point2 + collision.normal * margin2_m;
+    }
+    else {
+        // The cores overlap, so the margins are pushed apart as well
+        collision.penetration_depth_m = margin1_m + margin2_m;
+        GjkSimplex simplex = gjk.simplex;
+        if(blow_up_simplex_to_tetrahedron(body1, body2, simplex)) {
+            EpaResult epa;
+            get_epa_penetration(body1, body2, simplex, epa);
+            collision.normal = -epa.normal;
+            collision.penetration_depth_m += epa.depth_m;
+            point1 = epa.point1 - collision.normal * margin1_m;
+            point2 = epa.point2 + collision.normal * margin2_m;
+        }
+        else {
+            // The cores only touch in a flat region, e.g. two spheres at the same point or crossing capsules
+            // Any normal of the flat region works, prefer the one closest to the line between the bodies
+            glm::dvec3 offset = body1.position - body2.position;
+            glm::dvec3 normal = offset;
+            if(simplex.point_count == 3) {
+                normal = glm::cross(simplex.points[1].point - simplex.points[0].point, simplex.points[2].point - simplex.points[0].point);
+                normal = glm::dot(normal, offset) < 0 ? -normal : normal;
+            }
+            else if(simplex.point_count == 2) {
+                glm::dvec3 line_direction = glm::normalize(simplex.points[1].point - simplex.points[0].point);
+                normal = offset - line_direction * glm::dot(offset, line_direction);
+                if(glm::length2(normal) < 1e-20) {
+                    glm::dvec3 axis = std::abs(line_direction.x) < 0.5 ? glm::dvec3(1, 0, 0) : glm::dvec3(0, 1, 0);
+                    normal = glm::cross(line_direction, axis);
+                }
+            }
+            collision.normal = glm::length2(normal) > 1e-20 ? glm::normalize(normal) : glm::dvec3(0, 1, 0);
+            point1 = body1.get_support_point(-collision.normal, true);
+            point2 = body2.get_support_point(collision.normal, true);
+        }
+    }
+    collision.is_collision = true;
+    collision.manifold.add_point((point1 + point2) * 0.5, collision.penetration_depth_m, 0);
+    return collision;
+}
+TestWrapper(TEST_get_convex_convex_collision_gjk_epa_matches_separating_axis,
+    /** For cubes, the overlap from GJK and EPA should be the same as the smallest overlap of the separating axis test
+     *  Moving the first cube along the normal by the penetration depth should separate them
+    */
+    void test() {
+        srand(8);
+        int collision_count = 0;
+        for(int i = 0; i < 300; i++) {
+            Cube cube1 = Cube();
+            Cube cube2 = Cube();
+            cube1.side_length_m = 0.5 + (rand()%100) / 100.0;
+            cube2.side_length_m = 0.5 + (rand()%100) / 100.0;
+            cube1.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            cube2.trajectory.orientation.center_of_mass = glm::dvec3(rand()%100 - 50, rand()%100 - 50, rand()%100 - 50) / 50.0;
+            cube2.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            ConvexShape shape1 = ConvexShape::from_cube(cube1);
+            ConvexShape shape2 = ConvexShape::from_cube(cube2);
+            ConvexBody body1 = ConvexBody::from_orientation(shape1, cube1.trajectory.orientation);
+            ConvexBody body2 = ConvexBody::from_orientation(shape2, cube2.trajectory.orientation);
+
+            ConvexCollision collision = get_convex_convex_collision_gjk_epa(body1, body2);
+            OrientedBox box1 = OrientedBox::from_cube(cube1);
+            OrientedBox box2 = OrientedBox::from_cube(cube2);
+            BoxBoxOverlaps overlaps = get_box_box_overlaps(box1, box2);
+            Assert(collision.is_collision == (overlaps.separating_axis_class == SEPARATING_AXIS_NONE));
+            if(!collision.is_collision) {
+                continue;
+            }
+            collision_count += 1;
+            double min_overlap = std::min(std::min(overlaps.faces1.overlap, overlaps.faces2.overlap), overlaps.edge_pairs.overlap);
+            Assert(abs(collision.penetration_depth_m - min_overlap) < 0.000001);
+            Assert(collision.manifold.point_count == 1);
+
+            OrientedBox moved_box1 = box1;
+            moved_box1.center += collision.normal * (collision.penetration_depth_m + 0.00001);
+            Assert(get_box_box_overlaps(moved_box1, box2).separating_axis_class != SEPARATING_AXIS_NONE);
+            moved_box1.center = box1.center + collision.normal * (collision.penetration_depth_m - 0.00001);
+            Assert(get_box_box_overlaps(moved_box1, box2).separating_axis_class == SEPARATING_AXIS_NONE);
+        }
+        Assert(collision_count > 50);
+    }
+);
+
+ConvexCollision get_sphere_sphere_collision(const ConvexBody& body1, const ConvexBody& body2) {
+    ConvexCollision collision;
+    glm::dvec3 offset = body1.position - body2.position;
+    double distance_m = glm::length(offset);
+    double radius_sum_m = body1.shape->radius_m + body2.shape->radius_m;
+    if(distance_m >= radius_sum_m) {
+        return collision;
+    }
+    collision.is_collision = true;
+    collision.normal = distance_m > 0 ? offset / distance_m : glm::dvec3(0, 1, 0);
+    collision.penetration_depth_m = radius_sum_m - distance_m;
+    glm::dvec3 point1 = body1.position - collision.normal * body1.shape->radius_m;
+    glm::dvec3 point2 = body2.position + collision.normal * body2.shape->radius_m;
+    collision.manifold.add_point((point1 + point2) * 0.5, collision.penetration_depth_m, 0);
+    return collision;
+}
+
+// Only the box and the corners are set, they are all that the cube collision functions read
+inline CubeBodyState get_convex_body_cube_state(const ConvexBody& body) {
+    CubeBodyState state;
+    state.rotation_matrix = body.rotation_matrix;
+    state.box.center = body.position;
+    for(int i = 0; i < 3; i++) {
+        state.box.axis[i] = body.rotation_matrix[i];
+    }
+    state.box.half_side_length_m = body.shape->half_extents_m.x;
+    state.box.get_corner_positions(state.corners);
+    return state;
+}
+
+/**
+ * Use the separating axis test and the face contact manifolds of the cubes, see get_cube_cube_intersection_resolution
+ *  Those only work for cubes, other boxes use GJK and EPA
+*/
+ConvexCollision get_box_box_collision(const ConvexBody& body1, const ConvexBody& body2) {
+    if(!body1.shape->is_cube() || !body2.shape->is_cube()) {
+        return get_convex_convex_collision_gjk_epa(body1, body2);
+    }
+    IntersectionResolution intersection = get_cube_cube_intersection_resolution(get_convex_body_cube_state(body1), get_convex_body_cube_state(body2));
+    ConvexCollision collision;
+    collision.is_collision = intersection.is_collision;
+    if(intersection.is_collision) {
+        collision.normal = intersection.collision_axis;
+        collision.penetration_depth_m = intersection.penetration_depth_m;
+        collision.manifold = intersection.manifold;
+    }
+    return collision;
+}
+
+/**
+ * Collide any convex body with a plane, the deepest point is the support point in the direction into the plane
+*/
+ConvexCollision get_convex_plane_collision_support(const ConvexBody& body, const vicmil::Plane& plane) {
+    ConvexCollision collision;
+    collision.normal = glm::normalize(plane.normal);
+    glm::dvec3 deepest_point = body.get_support_point(-collision.normal, true);
+    double depth_m = glm::dot(plane.point - deepest_point, collision.normal);
+    if(depth_m <= 0) {
+        return collision;
+    }
+    collision.is_collision = true;
+    collision.penetration_depth_m = depth_m;
+    collision.manifold.add_point(deepest_point, depth_m, 0);
+    return collision;
+}
+
+/**
+ * Collide a set of points with a plane, the up to 4 deepest points below the plane are the contact points
+ *  Used for the corners of boxes and the points of convex hulls, so they can rest flat on the plane
+*/
+ConvexCollision get_points_plane_collision(const ConvexBody& body, const glm::dvec3* local_points, int point_count, const vicmil::Plane& plane) {
+    ConvexCollision collision;
+    collision.normal = glm::normalize(plane.normal);
+    ContactManifold& manifold = collision.manifold;
+    for(int i = 0; i < point_count; i++) {
+        glm::dvec3 point = body.position + body.rotation_matrix * local_points[i];
+        double depth_m = glm::dot(plane.point - point, collision.normal);
+        if(depth_m <= 0) {
+            continue;
+        }
+        if(manifold.point_count < ContactManifold::MAX_POINTS) {
+            manifold.add_point(point, depth_m, i);
+            continue;
+        }
+        // Replace the shallowest point if this one is deeper
+        int shallowest_index = 0;
+        for(int m = 1; m < manifold.point_count; m++) {
+            if(manifold.penetration_depths_m[m] < manifold.penetration_depths_m[shallowest_index]) {
+                shallowest_index = m;
+            }
+        }
+        if(depth_m > manifold.penetration_depths_m[shallowest_index]) {
+            manifold.positions[shallowest_index] = point;
+            manifold.penetration_depths_m[shallowest_index] = depth_m;
+            manifold.feature_ids[shallowest_index] = i;
+        }
+    }
+    collision.is_collision = manifold.point_count > 0;
+    for(int m = 0; m < manifold.point_count; m++) {
+        collision.penetration_depth_m = std::max(collision.penetration_depth_m, manifold.penetration_depths_m[m]);
+    }
+    return collision;
+}
+
+// Cubes use the face of the cube closest to the plane, see get_box_plane_contact_manifold
+ConvexCollision get_box_plane_collision(const ConvexBody& body, const vicmil::Plane& plane) {
+    if(body.shape->is_cube()) {
+        CubeBodyState state = get_convex_body_cube_state(body);
+        ConvexCollision collision;
+        collision.normal = glm::normalize(plane.normal);
+        collision.manifold = get_box_plane_contact_manifold(state.box, state.corners, plane);
+        collision.is_collision = collision.manifold.point_count > 0;
+        for(int m = 0; m < collision.manifold.point_count; m++) {
+            collision.penetration_depth_m = std::max(collision.penetration_depth_m, collision.manifold.penetration_depths_m[m]);
+        }
+        return collision;
+    }
+    glm::dvec3 local_corners[8];
+    for(int i = 0; i < 8; i++) {
+        local_corners[i] = body.shape->get_local_core_support_point(glm::dvec3(i & 1 ? -1 : 1, i & 2 ? -1 : 1, i & 4 ? -1 : 1));
+    }
+    return get_points_plane_collision(body, local_corners, 8, plane);
+}
+
+ConvexCollision get_hull_plane_collision(const ConvexBody& body, const vicmil::Plane& plane) {
+    return get_points_plane_collision(body, body.shape->hull_points.data(), body.shape->hull_points.size(), plane);
+}
+
+// Both ends of the capsule can touch the plane, so a capsule lying down gets a contact at each end
+ConvexCollision get_capsule_plane_collision(const ConvexBody& body, const vicmil::Plane& plane) {
+    ConvexCollision collision;
+    collision.normal = glm::normalize(plane.normal);
+    for(int end = 0; end < 2; end++) {
+        glm::dvec3 local_end = glm::dvec3(0, end == 0 ? -body.shape->half_height_m : body.shape->half_height_m, 0);
+        glm::dvec3 deepest_point = body.position + body.rotation_matrix * local_end - collision.normal * body.shape->radius_m;
+        double depth_m = glm::dot(plane.point - deepest_point, collision.normal);
+        if(depth_m > 0) {
+            collision.manifold.add_point(deepest_point, depth_m, end);
+            collision.penetration_depth_m = std::max(collision.penetration_depth_m, depth_m);
+        }
+    }
+    collision.is_collision = collision.manifold.point_count > 0;
+    return collision;
+}
+
+typedef ConvexCollision (*ConvexCollisionFunction)(const ConvexBody& body1, const ConvexBody& body2);
+typedef ConvexCollision (*ConvexPlaneCollisionFunction)(const ConvexBody& body, const vicmil::Plane& plane);
+
+/**
+ * Picks the collision function for each pair of shape types, and for each shape type against a plane
+ *  All pairs use GJK and EPA unless a faster function has been set for them
+*/
+class ConvexCollisionDispatcher {
+    struct PairFunction {
+        ConvexCollisionFunction function;
+        bool swap_bodies; // The function was set for the types in the other order
+    };
+    PairFunction _functions[CONVEX_SHAPE_TYPE_COUNT][CONVEX_SHAPE_TYPE_COUNT];
+    ConvexPlaneCollisionFunction _plane_functions[CONVEX_SHAPE_TYPE_COUNT];
+public:
+    ConvexCollisionDispatcher() {
+        for(int type1 = 0; type1 < CONVEX_SHAPE_TYPE_COUNT; type1++) {
+            for(int type2 = 0; type2 < CONVEX_SHAPE_TYPE_COUNT; type2++) {
+                set_function((ConvexShapeType)type1, (ConvexShapeType)type2, get_convex_convex_collision_gjk_epa);
+            }
+            set_plane_function((ConvexShapeType)type1, get_convex_plane_collision_support);
+        }
+        set_function(CONVEX_SHAPE_SPHERE, CONVEX_SHAPE_SPHERE, get_sphere_sphere_collision);
+        set_function(CONVEX_SHAPE_BOX, CONVEX_SHAPE_BOX, get_box_box_collision);
+        set_plane_function(CONVEX_SHAPE_BOX, get_box_plane_collision);
+        set_plane_function(CONVEX_SHAPE_CAPSULE, get_capsule_plane_collision);
+        set_plane_function(CONVEX_SHAPE_HULL, get_hull_plane_collision);
+    }
+
+    /**
+     * @param function Called with a body of type1 as body1, it is also used for type2 against type1 with the bodies swapped
+    */
+    void set_function(ConvexShapeType type1, ConvexShapeType type2, ConvexCollisionFunction function) {
+        _functions[type2][type1].function = function;
+        _functions[type2][type1].swap_bodies = true;
+        _functions[type1][type2].function = function;
+        _functions[type1][type2].swap_bodies = false;
+    }
+    void set_plane_function(ConvexShapeType type, ConvexPlaneCollisionFunction function) {
+        _plane_functions[type] = function;
+    }
+
+    ConvexCollision get_collision(const ConvexBody& body1, const ConvexBody& body2) const {
+        const PairFunction& pair_function = _functions[body1.shape->type][body2.shape->type];
+        if(!pair_function.swap_bodies) {
+            return pair_function.function(body1, body2);
+        }
+        ConvexCollision collision = pair_function.function(body2, body1);
+        collision.normal = -collision.normal;
+        return collision;
+    }
+    ConvexCollision get_plane_collision(const ConvexBody& body, const vicmil::Plane& plane) const {
+        return _plane_functions[body.shape->type](body, plane);
+    }
+};
+TestWrapper(TEST_ConvexCollisionDispatcher,
+    void test() {
+        ConvexCollisionDispatcher dispatcher;
+        ConvexShape sphere = ConvexShape::from_sphere(Sphere());
+        ConvexShape cube = ConvexShape::from_cube(Cube());
+        ConvexShape capsule = ConvexShape::capsule(0.5, 1);
+        ConvexShape box = ConvexShape::box(glm::dvec3(0.5, 0.25, 1));
+        std::vector<glm::dvec3> hull_points;
+        for(int i = 0; i < 8; i++) {
+            hull_points.push_back(glm::dvec3(i & 1 ? -0.5 : 0.5, i & 2 ? -0.25 : 0.25, i & 4 ? -1 : 1));
+        }
+        hull_points.push_back(glm::dvec3(0.1, 0, 0)); // A point inside the hull
+        ConvexShape hull = ConvexShape::hull(hull_points);
+
+        // Sphere against sphere should give the same result as GJK and EPA
+        ConvexBody body1 = ConvexBody::from_orientation(sphere, ObjectOrientation::centered_at_0());
+        ConvexBody body2 = ConvexBody::from_orientation(sphere, ObjectOrientation::centered_at_0());
+        body2.position = glm::dvec3(1.5, 0.2, 0);
+        ConvexCollision collision = dispatcher.get_collision(body1, body2);
+        ConvexCollision generic_collision = get_convex_convex_collision_gjk_epa(body1, body2);
+        Assert(collision.is_collision && generic_collision.is_collision);
+        Assert(abs(collision.penetration_depth_m - (2 - glm::length(body2.position))) < 0.000001);
+        Assert(abs(collision.penetration_depth_m - generic_collision.penetration_depth_m) < 0.000001);
+        Assert(glm::length(collision.normal - generic_collision.normal) < 0.000001);
+        Assert(collision.normal.x < 0); // body1 is pushed away from body2
+
+        // A box and a convex hull with the same corners should collide the same way, in both orders
+        ConvexBody box_body = ConvexBody::from_orientation(box, ObjectOrientation::centered_at_0());
+        ConvexBody hull_body = ConvexBody::from_orientation(hull, ObjectOrientation::centered_at_0());
+        ConvexBody sphere_body = ConvexBody::from_orientation(sphere, ObjectOrientation::centered_at_0());
+        box_body.position = hull_body.position = glm::dvec3(0, 1.1, 0);
+        box_body.rotation_matrix = hull_body.rotation_matrix = Rotation::from_axis_rotation(0.3, glm::dvec3(0, 0, 1)).to_matrix3x3();
+        ConvexCollision box_collision = dispatcher.get_collision(sphere_body, box_body);
+        ConvexCollision hull_collision = dispatcher.get_collision(sphere_body, hull_body);
+        ConvexCollision swapped_collision = dispatcher.get_collision(box_body, sphere_body);
+        Assert(box_collision.is_collision);
+        Assert(abs(box_collision.penetration_depth_m - hull_collision.penetration_depth_m) < 0.000001);
+        Assert(abs(box_collision.penetration_depth_m - swapped_collision.penetration_depth_m) < 0.000001);
+        Assert(glm::length(box_collision.normal + swapped_collision.normal) < 0.000001);
+        Assert(box_collision.normal.y < 0);
+
+        // Cube against cube uses the separating axis test, which gives a manifold with the 4 corners of the face
+        ConvexBody cube_body1 = ConvexBody::from_orientation(cube, ObjectOrientation::centered_at_0());
+        ConvexBody cube_body2 = ConvexBody::from_orientation(cube, ObjectOrientation::centered_at_0());
+        cube_body2.position = glm::dvec3(0.1, 0.95, 0);
+        collision = dispatcher.get_collision(cube_body1, cube_body2);
+        Assert(collision.is_collision);
+        Assert(collision.manifold.point_count == 4);
+        Assert(abs(collision.penetration_depth_m - 0.05) < 0.000001);
+        Assert(glm::length(collision.normal - glm::dvec3(0, -1, 0)) < 0.000001);
+
+        // Against the ground, flat shapes and capsules lying down touch at several points
+        vicmil::Plane ground = vicmil::Plane();
+        ConvexBody capsule_body = ConvexBody::from_orientation(capsule, ObjectOrientation::centered_at_0());
+        capsule_body.rotation_matrix = Rotation::from_axis_rotation(vicmil::PI / 2, glm::dvec3(0, 0, 1)).to_matrix3x3();
+        capsule_body.position = glm::dvec3(0, 0.45, 0);
+        collision = dispatcher.get_plane_collision(capsule_body, ground);
+        Assert(collision.manifold.point_count == 2);
+        Assert(abs(collision.penetration_depth_m - 0.05) < 0.000001);
+        cube_body1.position = glm::dvec3(0, 0.45, 0);
+        Assert(dispatcher.get_plane_collision(cube_body1, ground).manifold.point_count == 4);
+        hull_body.rotation_matrix = glm::dmat3x3(1.0);
+        hull_body.position = glm::dvec3(0, 0.2, 0);
+        collision = dispatcher.get_plane_collision(hull_body, ground);
+        Assert(collision.manifold.point_count == 4);
+        Assert(abs(collision.penetration_depth_m - 0.05) < 0.000001);
+        sphere_body.position = glm::dvec3(0, 0.9, 0);
+        collision = dispatcher.get_plane_collision(sphere_body, ground);
+        Assert(collision.manifold.point_count == 1);
+        Assert(abs(collision.penetration_depth_m - 0.1) < 0.000001);
+        sphere_body.position = glm::dvec3(0, 1.1, 0);
+        Assert(!dispatcher.get_plane_collision(sphere_body, ground).is_collision);
+    }
+);
+
+BenchmarkWrapper(BENCHMARK_get_convex_convex_collision_gjk_epa,
+    // The same cubes as BENCHMARK_get_cube_cube_intersection_resolution, to compare with the separating axis test
+    std::vector<ConvexShape> shapes;
+    std::vector<ConvexBody> bodies;
+    int input_index = 0;
+    void setup() {
+        std::vector<Cube> cubes;
+        for(int i = 0; i < 1024; i++) {
+            cubes.push_back(get_benchmark_random_cube(*this, 0.7));
+            shapes.push_back(ConvexShape::from_cube(cubes.back()));
+        }
+        for(int i = 0; i < 1024; i++) {
+            bodies.push_back(ConvexBody::from_orientation(shapes[i], cubes[i].trajectory.orientation));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(get_convex_convex_collision_gjk_epa(bodies[input_index], bodies[(input_index + 1) % 1024]));
+    }
+);
+BenchmarkWrapper(BENCHMARK_ConvexCollisionDispatcher_mixed_shapes,
+    // Spheres, cubes, capsules and hulls in random order, so every kind of pair is tested
+    ConvexCollisionDispatcher dispatcher;
+    std::vector<ConvexShape> shapes;
+    std::vector<ConvexBody> bodies;
+    int input_index = 0;
+    void setup() {
+        std::vector<glm::dvec3> hull_points;
+        for(int i = 0; i < 12; i++) {
+            hull_points.push_back(get_benchmark_random_dvec3(*this, -0.5, 0.5));
+        }
+        shapes.push_back(ConvexShape::sphere(0.5));
+        shapes.push_back(ConvexShape::from_cube(Cube()));
+        shapes.push_back(ConvexShape::capsule(0.3, 0.4));
+        shapes.push_back(ConvexShape::hull(hull_points));
+        for(int i = 0; i < 1024; i++) {
+            Cube cube = get_benchmark_random_cube(*this, 0.7);
+            bodies.push_back(ConvexBody::from_orientation(shapes[get_random_int(0, 3)], cube.trajectory.orientation));
+        }
+    }
+    int get_random_int(int min, int max) {
+        return std::min((int)get_random_double(min, max + 1), max);
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(dispatcher.get_collision(bodies[input_index], bodies[(input_index + 1) % 1024]));
+    }
+);
@@ -1,5 +1,5 @@
 #pragma once
-#include "../vicmil_lib/N4_vicmil_emscripten/vicmil_emscripten.h"
+#include "../vicmil_lib/N2_vicmil_glm/vicmil_glm.h"
 
 class Rotation {
 public:
@@ -125,6 +125,43 @@ TestWrapper(TEST3_Rotation,
     }
 );
 
+// Random inputs for the benchmarks, the benchmark generator is seeded so they are the same every run
+inline glm::dvec3 get_benchmark_random_dvec3(vicmil::BenchmarkBase& benchmark, double min, double max) {
+    return glm::dvec3(benchmark.get_random_double(min, max), benchmark.get_random_double(min, max), benchmark.get_random_double(min, max));
+}
+inline Rotation get_benchmark_random_rotation(vicmil::BenchmarkBase& benchmark) {
+    return Rotation::from_scaled_axis(get_benchmark_random_dvec3(benchmark, -vicmil::PI, vicmil::PI));
+}
+BenchmarkWrapper(BENCHMARK_Rotation_rotate_and_rotate_vector,
+    std::vector<Rotation> rotations;
+    std::vector<glm::dvec3> vectors;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            rotations.push_back(get_benchmark_random_rotation(*this));
+            vectors.push_back(get_benchmark_random_dvec3(*this, -1, 1));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        Rotation rotation = rotations[input_index].rotate(rotations[(input_index + 1) % 1024]);
+        vicmil::do_not_optimize(rotation.rotate_vector(vectors[input_index]));
+    }
+);
+BenchmarkWrapper(BENCHMARK_Rotation_from_scaled_axis,
+    std::vector<glm::dvec3> scaled_axes;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            scaled_axes.push_back(get_benchmark_random_dvec3(*this, -1, 1));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(Rotation::from_scaled_axis(scaled_axes[input_index]));
+    }
+);
+
 class InertiaTensor {
     public:
     glm::dmat3x3 _matrix;
@@ -149,10 +186,19 @@ class InertiaTensor {
         new_tensor._matrix_inverse = glm::dmat3x3() * 0.0;
         return new_tensor;
     }
+    /**
+     * Get the tensor of the object after it has been rotated, e.g. to go from the object to world space
+     *  I_world = R * I * R^T, and the same for the inverse
+    */
     InertiaTensor rotate(Rotation rotation) const {
-        // TODO
-        Debug("rotated inertia tensor not implemented yet!");
-        return *this;
+        return rotate_by_matrix(rotation.to_matrix3x3());
+    }
+    InertiaTensor rotate_by_matrix(const glm::dmat3x3& rotation_matrix) const {
+        glm::dmat3x3 rotation_matrix_transpose = glm::transpose(rotation_matrix);
+        InertiaTensor new_tensor;
+        new_tensor._matrix = rotation_matrix * _matrix * rotation_matrix_transpose;
+        new_tensor._matrix_inverse = rotation_matrix * _matrix_inverse * rotation_matrix_transpose;
+        return new_tensor;
     }
     InertiaTensor move(glm::dvec3 direction) {
         Debug("not implemented yet!");
@@ -160,6 +206,24 @@ class InertiaTensor {
     }
 };
 
+TestWrapper(TEST_InertiaTensor_rotate,
+    /** Rotating 90 degrees around z should swap how hard it is to rotate around x and y
+    */
+    void test() {
+        glm::dmat3x3 matrix = glm::dmat3x3(0.0);
+        matrix[0][0] = 1;
+        matrix[1][1] = 2;
+        matrix[2][2] = 3;
+        InertiaTensor tensor = InertiaTensor::from_matrix(matrix);
+        InertiaTensor rotated_tensor = tensor.rotate(Rotation::from_axis_rotation(vicmil::PI / 2, glm::dvec3(0, 0, 1)));
+        Assert(abs(rotated_tensor._matrix[0][0] - 2) < 0.00001);
+        Assert(abs(rotated_tensor._matrix[1][1] - 1) < 0.00001);
+        Assert(abs(rotated_tensor._matrix[2][2] - 3) < 0.00001);
+        Assert(abs(rotated_tensor._matrix_inverse[0][0] - 0.5) < 0.00001);
+        Assert(abs(rotated_tensor._matrix_inverse[1][1] - 1) < 0.00001);
+    }
+);
+
 class RotationVelocity {
 public:
     glm::dvec3 rotation = glm::dvec3(0, 0, 0); // The direction is the rotation axis, the length is the rotation speed around that axis in rad/s
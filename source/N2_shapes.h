@@ -21,6 +21,17 @@ struct ObjectOrientation {
         new_obj_orientation.center_of_mass = center_of_mass + (glm::dvec3)(other.center_of_mass * glm::dmat3x3(rotational_orientation.quaternion));
         return new_obj_orientation;
     }
+    /**
+     * Get an orientation in between two orientations, used to draw objects between two simulation steps
+     * @param factor 0 gives orientation1, 1 gives orientation2
+    */
+    static ObjectOrientation interpolate(const ObjectOrientation& orientation1, const ObjectOrientation& orientation2, double factor) {
+        ObjectOrientation new_obj_orientation;
+        new_obj_orientation.center_of_mass = glm::mix(orientation1.center_of_mass, orientation2.center_of_mass, factor);
+        new_obj_orientation.rotational_orientation.quaternion = 
+            glm::slerp(orientation1.rotational_orientation.quaternion, orientation2.rotational_orientation.quaternion, factor);
+        return new_obj_orientation;
+    }
     // Suppose the object was at (0,0,0) and had no rotation, and we had a point on the object
     //  if we then we applied the orientation. Where would the new point be? (if it were in the same place relative the object)
     glm::dvec3 apply_orientation(glm::dvec3 point) {
@@ -65,13 +65,30 @@ struct ObjectTrajectory {
     }
 };
 
-vicmil::ModelOrientation get_model_orientation_from_obj_trajectory(ObjectTrajectory trajectory) {
-    vicmil::ModelOrientation orientation;
-    orientation.position = trajectory.orientation.center_of_mass;
-    orientation.rotation = trajectory.orientation.rotational_orientation.to_matrix();
-    return orientation;
+inline ObjectTrajectory get_benchmark_random_trajectory(vicmil::BenchmarkBase& benchmark) {
+    ObjectTrajectory trajectory;
+    trajectory.orientation.center_of_mass = get_benchmark_random_dvec3(benchmark, -10, 10);
+    trajectory.orientation.rotational_orientation = get_benchmark_random_rotation(benchmark);
+    trajectory.linear_velocity.speed_m_per_s = get_benchmark_random_dvec3(benchmark, -5, 5);
+    trajectory.rotational_velocity.rotation = get_benchmark_random_dvec3(benchmark, -3, 3);
+    return trajectory;
 }
-
+BenchmarkWrapper(BENCHMARK_ObjectTrajectory_move_time_step_s,
+    std::vector<ObjectTrajectory> trajectories;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            trajectories.push_back(get_benchmark_random_trajectory(*this));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        // Moving forward and back keeps the trajectories from drifting away during the benchmark
+        trajectories[input_index].move_time_step_s(1.0 / 30);
+        trajectories[input_index].move_time_step_s(-1.0 / 30);
+        vicmil::do_not_optimize(trajectories[input_index]);
+    }
+);
 
 LinearVelocity get_change_in_linear_velocity(const Impulse& impulse, ObjectOrientation& orientation, const ObjectShapeProperty& shape_property) {
     DisableLogging
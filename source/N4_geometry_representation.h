@@ -12,7 +12,7 @@ struct Cube {
     double mass_kg = 1.0; // The weight
     ObjectTrajectory trajectory;
 
-    ObjectShapeProperty get_shape_property() {
+    ObjectShapeProperty get_shape_property() const {
         return ObjectShapeProperty::from_cube(side_length_m, mass_kg);
     }
 
@@ -34,144 +34,597 @@ struct Cube {
 };
 
 
-struct Overlap {
-    glm::dvec3 axis;
-    double overlap;
+/**
+ * A cube represented by its center, its three normalized axis in world space and half its side length
+ *  Creating it once and reusing it is much cheaper than calculating the corner positions every time 
+ *  the cube is projected to an axis, and it does not allocate any memory
+*/
+struct OrientedBox {
+    glm::dvec3 center;
+    glm::dvec3 axis[3];
+    double half_side_length_m;
+
+    static OrientedBox from_cube(const Cube& cube) {
+        glm::dmat3x3 rotation_matrix = cube.trajectory.orientation.rotational_orientation.to_matrix3x3();
+        return OrientedBox::from_rotation_matrix(cube, rotation_matrix);
+    }
+    static OrientedBox from_rotation_matrix(const Cube& cube, const glm::dmat3x3& rotation_matrix) {
+        OrientedBox box;
+        box.center = cube.trajectory.orientation.center_of_mass;
+        box.axis[0] = rotation_matrix[0];
+        box.axis[1] = rotation_matrix[1];
+        box.axis[2] = rotation_matrix[2];
+        box.half_side_length_m = cube.side_length_m / 2;
+        return box;
+    }
+
+    /**
+     * Project the box to an axis, gives the same result as projecting all the corners and taking the min and max
+     *  The center is projected, and then the box reaches half_side_length_m along each of its axis in both directions
+    */
+    inline void project_to_axis(const glm::dvec3& projection_axis, double* min, double* max) const {
+        double center_projected = glm::dot(center, projection_axis);
+        double radius = half_side_length_m * (
+            std::abs(glm::dot(axis[0], projection_axis)) + 
+            std::abs(glm::dot(axis[1], projection_axis)) + 
+            std::abs(glm::dot(axis[2], projection_axis)));
+        *min = center_projected - radius;
+        *max = center_projected + radius;
+    }
+
+    /**
+     * Get a corner from its index, bit i of the index tells if the corner is on the positive(0) or negative(1) side of axis[i]
+    */
+    inline glm::dvec3 get_corner_position(int corner_index) const {
+        glm::dvec3 corner = center;
+        for(int i = 0; i < 3; i++) {
+            if(corner_index & (1 << i)) {
+                corner -= axis[i] * half_side_length_m;
+            }
+            else {
+                corner += axis[i] * half_side_length_m;
+            }
+        }
+        return corner;
+    }
+
+    /**
+     * If all the corners were projected to an axis, which corner would be the lowest?
+     * @return The index of the corner, see get_corner_position
+    */
+    inline int get_lowest_corner_index_along_axis(const glm::dvec3& projection_axis) const {
+        int corner_index = 0;
+        for(int i = 0; i < 3; i++) {
+            // Go in the direction along each box axis that goes down along the projection axis
+            if(glm::dot(axis[i], projection_axis) > 0) {
+                corner_index |= (1 << i);
+            }
+        }
+        return corner_index;
+    }
+
+    inline glm::dvec3 get_lowest_corner_along_axis(const glm::dvec3& projection_axis) const {
+        return get_corner_position(get_lowest_corner_index_along_axis(projection_axis));
+    }
+
+    // Get all 8 corners, in the order of get_corner_position
+    inline void get_corner_positions(glm::dvec3 corners[8]) const {
+        for(int i = 0; i < 8; i++) {
+            corners[i] = get_corner_position(i);
+        }
+    }
 };
 
-// This can probably be optimized. TODO
-std::vector<double> project_cube_to_line(Cube& cube, vicmil::Line& line) {
-    // Let us first calculate the cube corner positions
-    std::vector<glm::dvec3> corners = cube.get_corner_positions();
-    
-    // Let us project these corners onto line
-    std::vector<double> projected_corners = {
-        vicmil::project_point_to_line(corners[0], line),
-        vicmil::project_point_to_line(corners[1], line),
-        vicmil::project_point_to_line(corners[2], line),
-        vicmil::project_point_to_line(corners[3], line),
-        vicmil::project_point_to_line(corners[4], line),
-        vicmil::project_point_to_line(corners[5], line),
-        vicmil::project_point_to_line(corners[6], line),
-        vicmil::project_point_to_line(corners[7], line),
-    };
-    
-    Debug("projected_corner_pos: " + vicmil::vec_to_string(corners));
-    Debug("projected corners" << vicmil::vec_to_string(projected_corners));
+/**
+ * A box aligned with the x, y and z axis, represented by the minimum and maximum corner
+*/
+struct AxisAlignedBoundingBox {
+    glm::dvec3 min = glm::dvec3(0, 0, 0);
+    glm::dvec3 max = glm::dvec3(0, 0, 0);
+    inline bool overlaps(const AxisAlignedBoundingBox& other) const {
+        return min.x <= other.max.x && other.min.x <= max.x &&
+               min.y <= other.max.y && other.min.y <= max.y &&
+               min.z <= other.max.z && other.min.z <= max.z;
+    }
+    // Get the box with margin_m of extra space added on all sides
+    inline AxisAlignedBoundingBox expanded(double margin_m) const {
+        AxisAlignedBoundingBox bounding_box;
+        bounding_box.min = min - glm::dvec3(margin_m, margin_m, margin_m);
+        bounding_box.max = max + glm::dvec3(margin_m, margin_m, margin_m);
+        return bounding_box;
+    }
+};
+
+/**
+ * Get the smallest axis aligned box that contains the whole box
+ * @param margin_m Extra space added on all sides, so that pairs that are just about to touch are included
+*/
+inline AxisAlignedBoundingBox get_box_bounding_box(const OrientedBox& box, double margin_m = 0.0) {
+    // Each world axis gets a contribution from all three box axis, depending on how the box is rotated
+    glm::dvec3 half_extent = glm::dvec3(0, 0, 0);
+    for(int i = 0; i < 3; i++) {
+        half_extent += glm::abs(box.axis[i]) * box.half_side_length_m;
+    }
+    half_extent += glm::dvec3(margin_m, margin_m, margin_m);
 
-    return projected_corners;
+    AxisAlignedBoundingBox bounding_box;
+    bounding_box.min = box.center - half_extent;
+    bounding_box.max = box.center + half_extent;
+    return bounding_box;
+}
+AxisAlignedBoundingBox get_cube_bounding_box(const Cube& cube, double margin_m = 0.0) {
+    return get_box_bounding_box(OrientedBox::from_cube(cube), margin_m);
 }
+TestWrapper(TEST_get_cube_bounding_box,
+    void test() {
+        Cube cube = Cube();
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(1, 2, 3);
+        AxisAlignedBoundingBox box = get_cube_bounding_box(cube);
+        Assert(glm::length(box.min - glm::dvec3(0.5, 1.5, 2.5)) < 0.00001);
+        Assert(glm::length(box.max - glm::dvec3(1.5, 2.5, 3.5)) < 0.00001);
+
+        // Rotating 45 degrees around y should make the box wider in x and z, but not in y
+        cube.trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation(vicmil::PI / 4, glm::dvec3(0, 1, 0));
+        box = get_cube_bounding_box(cube);
+        Assert(abs((box.max.x - box.min.x) - std::sqrt(2.0)) < 0.00001);
+        Assert(abs((box.max.y - box.min.y) - 1.0) < 0.00001);
+        Assert(abs((box.max.z - box.min.z) - std::sqrt(2.0)) < 0.00001);
+    }
+);
+
+/**
+ * Everything about a cube that only depends on where it is, calculated once per step from the cube
+ *  The collision detection and the contact solver read these instead of calculating them again for 
+ *  every pair, axis and contact the cube is part of
+*/
+struct CubeBodyState {
+    glm::dmat3x3 rotation_matrix;
+    glm::dmat3x3 world_inverse_inertia; // The inverse inertia tensor rotated to world space
+    double inverse_mass_kg;
+    OrientedBox box;
+    glm::dvec3 corners[8]; // In world space, in the order of OrientedBox::get_corner_position
+    AxisAlignedBoundingBox bounding_box; // Without any margin
+
+    static CubeBodyState from_cube(const Cube& cube) {
+        CubeBodyState state;
+        state.rotation_matrix = cube.trajectory.orientation.rotational_orientation.to_matrix3x3();
+        ObjectShapeProperty shape_property = cube.get_shape_property();
+        state.world_inverse_inertia = shape_property.inertia_tensor.rotate_by_matrix(state.rotation_matrix)._matrix_inverse;
+        state.inverse_mass_kg = shape_property.inverse_mass_kg;
+        state.box = OrientedBox::from_rotation_matrix(cube, state.rotation_matrix);
+        state.box.get_corner_positions(state.corners);
+        state.bounding_box = get_box_bounding_box(state.box);
+        return state;
+    }
+};
+
+
+struct Overlap {
+    glm::dvec3 axis;
+    double overlap;
+    int axis_index = 0; // Which of the tested axis had the smallest overlap, e.g. which face or which edge pair
+};
 
 
 /** Get the overlap between plane and cube
- * TODO: Now only handles ground plane
  * @return The overlap between the cube and plane, the axis is the direction the cube should move in to resolve the overlap
 */
-Overlap get_plane_cube_overlap(Cube& cube, vicmil::Plane& plane) {
-    Overlap cube_overlap;
-    vicmil::Line collision_line;
-    collision_line.point = plane.point;
-    collision_line.vector = plane.normal;
-    
-    std::vector<double> cube_projected = project_cube_to_line(cube, collision_line);
-    double min_cube = vicmil::get_min_in_vector(cube_projected);
+Overlap get_plane_cube_overlap(const Cube& cube, const vicmil::Plane& plane) {
+    OrientedBox box = OrientedBox::from_cube(cube);
+    double min_cube;
+    double max_cube;
+    box.project_to_axis(plane.normal, &min_cube, &max_cube);
+    min_cube -= glm::dot(plane.point, plane.normal); // Measure relative to the plane
 
+    Overlap cube_overlap;
     cube_overlap.axis = plane.normal;
     cube_overlap.overlap = -min_cube; // Everything below plane is overlap
 
     return cube_overlap;
 }
 
-ContactPointInfo find_cube_plane_contact_point(Cube cube, vicmil::Plane plane) {
-    std::vector<glm::dvec3> corners = cube.get_corner_positions();
-    int lowest_corner = vicmil::get_lowest_point_along_axis(corners, plane.normal);
+ContactPointInfo find_cube_plane_contact_point(const Cube& cube, const vicmil::Plane& plane) {
+    OrientedBox box = OrientedBox::from_cube(cube);
 
     ContactPointInfo contact_point;
     contact_point.contact_normal = plane.normal; // Straigth up from the plane
-    contact_point.contact_position = corners[lowest_corner]; // The corner colliding with plane
+    contact_point.contact_position = box.get_lowest_corner_along_axis(plane.normal); // The corner colliding with plane
     return contact_point;
 }
 
-double get_cube_cube_overlap_along_axis(Cube cube1, Cube cube2, glm::dvec3 axis) {
-    vicmil::Line line;
-    line.point = glm::dvec3(0, 0, 0);
-    line.vector = axis;
-    std::vector<double> cube1_proj = project_cube_to_line(cube1, line);
-    std::vector<double> cube2_proj = project_cube_to_line(cube2, line);
-    double cube1_min = vicmil::get_min_in_vector(cube1_proj);
-    double cube1_max = vicmil::get_max_in_vector(cube1_proj);
-    double cube2_min = vicmil::get_min_in_vector(cube2_proj);
-    double cube2_max = vicmil::get_max_in_vector(cube2_proj);
-    double overlap = vicmil::get_overlap(cube1_min, cube1_max, cube2_min, cube2_max);
-    return overlap;
+/**
+ * Up to 4 points where two objects touch, e.g. the corners of a cube resting flat on the ground
+ *  Stored in fixed size arrays so that no memory has to be allocated
+*/
+struct ContactManifold {
+    static const int MAX_POINTS = 4;
+    int point_count = 0;
+    glm::dvec3 positions[MAX_POINTS];
+    double penetration_depths_m[MAX_POINTS];
+    int feature_ids[MAX_POINTS]; // Identifies each point, so it can be recognized in the next step
+
+    inline void add_point(const glm::dvec3& position, double penetration_depth_m, int feature_id) {
+        if(point_count >= MAX_POINTS) {
+            return;
+        }
+        positions[point_count] = position;
+        penetration_depths_m[point_count] = penetration_depth_m;
+        feature_ids[point_count] = feature_id;
+        point_count += 1;
+    }
+};
+
+/**
+ * Get the corners of one face of a box, in order around the face
+ * @param axis_index The box axis that the face is perpendicular to
+ * @param negative_side If the face is on the negative side of the axis
+ * @param corner_indices Filled with the 4 corner indices, see OrientedBox::get_corner_position
+*/
+inline void get_box_face_corner_indices(int axis_index, bool negative_side, int corner_indices[4]) {
+    int a = 1 << ((axis_index + 1) % 3);
+    int b = 1 << ((axis_index + 2) % 3);
+    int face = negative_side ? (1 << axis_index) : 0;
+    corner_indices[0] = face;
+    corner_indices[1] = face | a;
+    corner_indices[2] = face | a | b;
+    corner_indices[3] = face | b;
 }
 
-Overlap get_cube_cube_overlap_along_faces(Cube cube_with_faces, Cube other_cube) {
-    glm::dmat3x3 cube_rotation_matrix = cube_with_faces.trajectory.orientation.rotational_orientation.to_matrix3x3();
-    std::vector<glm::dvec3> cube_face_axis = {
-        glm::dvec3(1, 0, 0) * cube_rotation_matrix,
-        glm::dvec3(0, 1, 0) * cube_rotation_matrix,
-        glm::dvec3(0, 0, 1) * cube_rotation_matrix
-    };
-    
+/**
+ * Get the face of the box that points the most in the opposite direction of normal, that is the face that hits 
+ *  something coming from the direction of normal
+*/
+inline void get_box_incident_face(const OrientedBox& box, const glm::dvec3& normal, int* axis_index, bool* negative_side) {
+    *axis_index = 0;
+    double max_alignment = -1;
+    for(int i = 0; i < 3; i++) {
+        double alignment = std::abs(glm::dot(box.axis[i], normal));
+        if(alignment > max_alignment) {
+            max_alignment = alignment;
+            *axis_index = i;
+        }
+    }
+    *negative_side = glm::dot(box.axis[*axis_index], normal) > 0;
+}
+
+/**
+ * Get all the corners of the cube that are below the plane, at most the 4 corners of the face facing the plane
+*/
+ContactManifold get_box_plane_contact_manifold(const OrientedBox& box, const glm::dvec3 corners[8], const vicmil::Plane& plane) {
+    glm::dvec3 normal = glm::normalize(plane.normal);
+    int axis_index;
+    bool negative_side;
+    get_box_incident_face(box, normal, &axis_index, &negative_side);
+    int corner_indices[4];
+    get_box_face_corner_indices(axis_index, negative_side, corner_indices);
+
+    ContactManifold manifold;
+    double plane_height = glm::dot(plane.point, normal);
+    for(int i = 0; i < 4; i++) {
+        const glm::dvec3& corner = corners[corner_indices[i]];
+        double penetration_depth_m = plane_height - glm::dot(corner, normal);
+        if(penetration_depth_m > 0) {
+            manifold.add_point(corner, penetration_depth_m, corner_indices[i]);
+        }
+    }
+    return manifold;
+}
+inline ContactManifold get_cube_plane_contact_manifold(const CubeBodyState& body_state, const vicmil::Plane& plane) {
+    return get_box_plane_contact_manifold(body_state.box, body_state.corners, plane);
+}
+ContactManifold get_cube_plane_contact_manifold(const Cube& cube, const vicmil::Plane& plane) {
+    OrientedBox box = OrientedBox::from_cube(cube);
+    glm::dvec3 corners[8];
+    box.get_corner_positions(corners);
+    return get_box_plane_contact_manifold(box, corners, plane);
+}
+
+/**
+ * Get where a face of one box touches another box, by clipping the touching face of the other box against the sides of the face
+ *  The points are placed halfway between the two faces
+ * @param reference_box The box with the face
+ * @param reference_axis_index The axis of reference_box that the face is perpendicular to
+ * @param reference_normal The direction of the face, pointing towards incident_box
+ * @param incident_corners The corners of incident_box, see OrientedBox::get_corner_positions
+ * @return Up to 4 points, the feature id is the corner index for corners of incident_box, 
+ *  and 8 + 8 * side + line for points where a line crossed a side of the face. The line is 0-3 for the 
+ *  edges of the incident face, and 4 + side for a side that was clipped against before
+*/
+ContactManifold get_box_box_face_contact_manifold(
+    const OrientedBox& reference_box, int reference_axis_index, const glm::dvec3& reference_normal, 
+    const OrientedBox& incident_box, const glm::dvec3 incident_corners[8]) {
+    // The face of the incident box that touches the reference face
+    int incident_axis_index;
+    bool incident_negative_side;
+    get_box_incident_face(incident_box, reference_normal, &incident_axis_index, &incident_negative_side);
+    int corner_indices[4];
+    get_box_face_corner_indices(incident_axis_index, incident_negative_side, corner_indices);
+
+    // Every clip can add at most one point to the polygon, so it never has more than 8 points
+    const int MAX_POLYGON_POINTS = 8;
+    glm::dvec3 polygon[MAX_POLYGON_POINTS];
+    int polygon_ids[MAX_POLYGON_POINTS];
+    // Which line the polygon goes along from each point to the next, a line crosses each side at most once
+    // so together with the side it gives every clipped point its own id
+    int polygon_lines[MAX_POLYGON_POINTS];
+    int polygon_size = 4;
+    for(int i = 0; i < 4; i++) {
+        polygon[i] = incident_corners[corner_indices[i]];
+        polygon_ids[i] = corner_indices[i];
+        polygon_lines[i] = i;
+    }
+
+    // Clip against the 4 sides of the reference face
+    glm::dvec3 clipped_polygon[MAX_POLYGON_POINTS];
+    int clipped_polygon_ids[MAX_POLYGON_POINTS];
+    int clipped_polygon_lines[MAX_POLYGON_POINTS];
+    for(int side = 0; side < 4; side++) {
+        glm::dvec3 side_normal = reference_box.axis[(reference_axis_index + 1 + side / 2) % 3];
+        if(side % 2 == 1) {
+            side_normal = -side_normal;
+        }
+        double side_distance = glm::dot(reference_box.center, side_normal) + reference_box.half_side_length_m;
+
+        int clipped_polygon_size = 0;
+        for(int i = 0; i < polygon_size; i++) {
+            const glm::dvec3& point = polygon[i];
+            const glm::dvec3& next_point = polygon[(i + 1) % polygon_size];
+            double distance = glm::dot(point, side_normal) - side_distance; // Inside if negative
+            double next_distance = glm::dot(next_point, side_normal) - side_distance;
+            if(distance <= 0 && clipped_polygon_size < MAX_POLYGON_POINTS) {
+                clipped_polygon[clipped_polygon_size] = point;
+                clipped_polygon_ids[clipped_polygon_size] = polygon_ids[i];
+                clipped_polygon_lines[clipped_polygon_size] = polygon_lines[i];
+                clipped_polygon_size += 1;
+            }
+            if((distance <= 0) != (next_distance <= 0) && clipped_polygon_size < MAX_POLYGON_POINTS) {
+                double t = distance / (distance - next_distance);
+                clipped_polygon[clipped_polygon_size] = point + (next_point - point) * t;
+                clipped_polygon_ids[clipped_polygon_size] = 8 + side * 8 + polygon_lines[i];
+                // When leaving, the polygon continues along the side until it comes back in
+                clipped_polygon_lines[clipped_polygon_size] = (distance <= 0) ? 4 + side : polygon_lines[i];
+                clipped_polygon_size += 1;
+            }
+        }
+        polygon_size = clipped_polygon_size;
+        for(int i = 0; i < polygon_size; i++) {
+            polygon[i] = clipped_polygon[i];
+            polygon_ids[i] = clipped_polygon_ids[i];
+            polygon_lines[i] = clipped_polygon_lines[i];
+        }
+    }
+
+    // Only keep the points below the reference face
+    double face_distance = glm::dot(reference_box.center, reference_normal) + reference_box.half_side_length_m;
+    double depths[MAX_POLYGON_POINTS];
+    int below_count = 0;
+    for(int i = 0; i < polygon_size; i++) {
+        double depth = face_distance - glm::dot(polygon[i], reference_normal);
+        if(depth > 0) {
+            polygon[below_count] = polygon[i];
+            polygon_ids[below_count] = polygon_ids[i];
+            depths[below_count] = depth;
+            below_count += 1;
+        }
+    }
+
+    // If there are too many points, keep the ones furthest out along the sides of the face
+    int keep[4] = {0, 0, 0, 0};
+    int keep_count = below_count;
+    if(below_count > ContactManifold::MAX_POINTS) {
+        glm::dvec3 side_axis1 = reference_box.axis[(reference_axis_index + 1) % 3];
+        glm::dvec3 side_axis2 = reference_box.axis[(reference_axis_index + 2) % 3];
+        for(int i = 1; i < below_count; i++) {
+            if(glm::dot(polygon[i], side_axis1) < glm::dot(polygon[keep[0]], side_axis1)) keep[0] = i;
+            if(glm::dot(polygon[i], side_axis1) > glm::dot(polygon[keep[1]], side_axis1)) keep[1] = i;
+            if(glm::dot(polygon[i], side_axis2) < glm::dot(polygon[keep[2]], side_axis2)) keep[2] = i;
+            if(glm::dot(polygon[i], side_axis2) > glm::dot(polygon[keep[3]], side_axis2)) keep[3] = i;
+        }
+        keep_count = 4;
+    }
+    else {
+        for(int i = 0; i < below_count; i++) {
+            keep[i] = i;
+        }
+    }
+
+    ContactManifold manifold;
+    for(int k = 0; k < keep_count; k++) {
+        int i = keep[k];
+        bool already_added = false;
+        for(int k2 = 0; k2 < k; k2++) {
+            already_added = already_added || keep[k2] == i;
+        }
+        if(!already_added) {
+            manifold.add_point(polygon[i] + reference_normal * (depths[i] / 2), depths[i], polygon_ids[i]);
+        }
+    }
+    return manifold;
+}
+ContactManifold get_box_box_face_contact_manifold(
+    const OrientedBox& reference_box, int reference_axis_index, const glm::dvec3& reference_normal, const OrientedBox& incident_box) {
+    glm::dvec3 incident_corners[8];
+    incident_box.get_corner_positions(incident_corners);
+    return get_box_box_face_contact_manifold(reference_box, reference_axis_index, reference_normal, incident_box, incident_corners);
+}
+
+inline double get_box_box_overlap_along_axis(const OrientedBox& box1, const OrientedBox& box2, const glm::dvec3& axis) {
+    double box1_min;
+    double box1_max;
+    double box2_min;
+    double box2_max;
+    box1.project_to_axis(axis, &box1_min, &box1_max);
+    box2.project_to_axis(axis, &box2_min, &box2_max);
+    return vicmil::get_overlap(box1_min, box1_max, box2_min, box2_max);
+}
+
+Overlap get_box_box_overlap_along_faces(const OrientedBox& box_with_faces, const OrientedBox& other_box) {
     glm::dvec3 min_overlap_axis = glm::dvec3(0, 1, 0);
     double min_overlap = 1000000000; // Some large number
+    int min_overlap_axis_index = 0;
     for(int i = 0; i < 3; i++) {
-        double overlap = get_cube_cube_overlap_along_axis(cube_with_faces, other_cube, cube_face_axis[i]);
+        double overlap = get_box_box_overlap_along_axis(box_with_faces, other_box, box_with_faces.axis[i]);
         if(overlap < min_overlap) {
             min_overlap = overlap;
-            min_overlap_axis = cube_face_axis[i];
+            min_overlap_axis = box_with_faces.axis[i];
+            min_overlap_axis_index = i;
         }
     }
     Overlap overlap;
     overlap.axis = min_overlap_axis;
     overlap.overlap = min_overlap;
+    overlap.axis_index = min_overlap_axis_index;
     return overlap;
 }
 
-Overlap get_cube_cube_overlap_along_edge_pairs(Cube cube1, Cube cube2) {
-    glm::dmat3x3 cube1_rotation_matrix = cube1.trajectory.orientation.rotational_orientation.to_matrix3x3();
-    glm::dmat3x3 cube2_rotation_matrix = cube2.trajectory.orientation.rotational_orientation.to_matrix3x3();
-    std::vector<glm::dvec3> cube1_face_axis = {
-        glm::dvec3(1, 0, 0) * cube1_rotation_matrix,
-        glm::dvec3(0, 1, 0) * cube1_rotation_matrix,
-        glm::dvec3(0, 0, 1) * cube1_rotation_matrix
-    };
-    std::vector<glm::dvec3> cube2_face_axis = {
-        glm::dvec3(1, 0, 0) * cube2_rotation_matrix,
-        glm::dvec3(0, 1, 0) * cube2_rotation_matrix,
-        glm::dvec3(0, 0, 1) * cube2_rotation_matrix
-    };
-    std::vector<glm::dvec3> edge_pair_axis = {
-        glm::cross(cube1_face_axis[0], cube2_face_axis[0]),
-        glm::cross(cube1_face_axis[0], cube2_face_axis[1]),
-        glm::cross(cube1_face_axis[0], cube2_face_axis[2]),
-        glm::cross(cube1_face_axis[1], cube2_face_axis[0]),
-        glm::cross(cube1_face_axis[1], cube2_face_axis[1]),
-        glm::cross(cube1_face_axis[1], cube2_face_axis[2]),
-        glm::cross(cube1_face_axis[2], cube2_face_axis[0]),
-        glm::cross(cube1_face_axis[2], cube2_face_axis[1]),
-        glm::cross(cube1_face_axis[2], cube2_face_axis[2]),
-    };
-    
+Overlap get_box_box_overlap_along_edge_pairs(const OrientedBox& box1, const OrientedBox& box2) {
     glm::dvec3 min_overlap_axis = glm::dvec3(0, 1, 0); // Some vector
     double min_overlap = 10000000; // Large number
-    for(int i = 0; i < 9; i++) {
-        glm::dvec3 axis = edge_pair_axis[i];
-        if(glm::length2(axis) > 0.00001) { // Only pick valid axis
-            axis = glm::normalize(axis);
-            double overlap = get_cube_cube_overlap_along_axis(cube1, cube2, axis);
-            if(overlap < min_overlap) {
-                min_overlap = overlap;
-                min_overlap_axis = axis;
+    int min_overlap_axis_index = 0;
+    for(int i = 0; i < 3; i++) {
+        for(int i2 = 0; i2 < 3; i2++) {
+            glm::dvec3 axis = glm::cross(box1.axis[i], box2.axis[i2]);
+            if(glm::length2(axis) > 0.00001) { // Only pick valid axis
+                axis = glm::normalize(axis);
+                double overlap = get_box_box_overlap_along_axis(box1, box2, axis);
+                if(overlap < min_overlap) {
+                    min_overlap = overlap;
+                    min_overlap_axis = axis;
+                    min_overlap_axis_index = i * 3 + i2;
+                }
             }
         }
     }
-    //DebugExpr(glm::to_string(min_overlap_axis));
-    //DebugExpr(min_overlap);
     Overlap overlap;
     overlap.axis = min_overlap_axis;
     overlap.overlap = min_overlap;
+    overlap.axis_index = min_overlap_axis_index;
     Assert(glm::length(overlap.axis) > 0.000001);
     return overlap;
-}
\ No newline at end of file
+}
+
+double get_cube_cube_overlap_along_axis(const Cube& cube1, const Cube& cube2, glm::dvec3 axis) {
+    return get_box_box_overlap_along_axis(OrientedBox::from_cube(cube1), OrientedBox::from_cube(cube2), axis);
+}
+
+Overlap get_cube_cube_overlap_along_faces(const Cube& cube_with_faces, const Cube& other_cube) {
+    return get_box_box_overlap_along_faces(OrientedBox::from_cube(cube_with_faces), OrientedBox::from_cube(other_cube));
+}
+
+Overlap get_cube_cube_overlap_along_edge_pairs(const Cube& cube1, const Cube& cube2) {
+    return get_box_box_overlap_along_edge_pairs(OrientedBox::from_cube(cube1), OrientedBox::from_cube(cube2));
+}
+TestWrapper(TEST_OrientedBox_project_to_axis,
+    /** Projecting the box should give the same result as projecting all the corners of the cube
+    */
+    void test() {
+        srand(2);
+        for(int i = 0; i < 100; i++) {
+            Cube cube = Cube();
+            cube.side_length_m = 0.5 + (rand()%100) / 50.0;
+            cube.trajectory.orientation.center_of_mass = glm::dvec3(rand()%100, rand()%100, rand()%100) / 10.0;
+            cube.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            glm::dvec3 axis = glm::normalize(glm::dvec3(rand()%100 - 50, rand()%100 - 50, rand()%100 - 50) + glm::dvec3(0.1, 0, 0));
+
+            std::vector<glm::dvec3> corners = cube.get_corner_positions();
+            std::vector<double> projected_corners;
+            for(int c = 0; c < corners.size(); c++) {
+                projected_corners.push_back(glm::dot(corners[c], axis));
+            }
+            double min;
+            double max;
+            OrientedBox box = OrientedBox::from_cube(cube);
+            box.project_to_axis(axis, &min, &max);
+            Assert(abs(min - vicmil::get_min_in_vector(projected_corners)) < 0.00001);
+            Assert(abs(max - vicmil::get_max_in_vector(projected_corners)) < 0.00001);
+
+            int lowest_corner = vicmil::get_lowest_point_along_axis(corners, axis);
+            Assert(glm::length(box.get_lowest_corner_along_axis(axis) - corners[lowest_corner]) < 0.00001);
+        }
+    }
+);
+TestWrapper(TEST_CubeBodyState_from_cube,
+    /** The cached values should be the same as calculating them from the cube
+    */
+    void test() {
+        Cube cube = Cube();
+        cube.side_length_m = 0.7;
+        cube.mass_kg = 3;
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(1, 2, 3);
+        cube.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(0.3, 1.2, -0.4));
+        CubeBodyState state = CubeBodyState::from_cube(cube);
+        OrientedBox box = OrientedBox::from_cube(cube);
+        for(int i = 0; i < 8; i++) {
+            Assert(glm::length(state.corners[i] - box.get_corner_position(i)) < 0.00001);
+        }
+        AxisAlignedBoundingBox bounding_box = get_cube_bounding_box(cube);
+        Assert(glm::length(state.bounding_box.min - bounding_box.min) < 0.00001);
+        Assert(glm::length(state.bounding_box.max - bounding_box.max) < 0.00001);
+        Assert(state.inverse_mass_kg == 1.0 / 3);
+
+        // A cube is equally hard to rotate around all axis, so rotating it does not change the inertia tensor
+        glm::dmat3x3 inverse_inertia = cube.get_shape_property().inertia_tensor._matrix_inverse;
+        for(int i = 0; i < 3; i++) {
+            Assert(glm::length(state.world_inverse_inertia[i] - inverse_inertia[i]) < 0.00001);
+        }
+    }
+);
+TestWrapper(TEST_get_cube_plane_contact_manifold,
+    /** A cube lying flat on the plane should touch it in all 4 bottom corners, and a tilted cube only in one
+    */
+    void test() {
+        Cube cube = Cube();
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(0, 0.49, 0);
+        ContactManifold manifold = get_cube_plane_contact_manifold(cube, vicmil::Plane());
+        Assert(manifold.point_count == 4);
+        for(int i = 0; i < manifold.point_count; i++) {
+            Assert(abs(manifold.positions[i].y + 0.01) < 0.00001);
+            Assert(abs(manifold.penetration_depths_m[i] - 0.01) < 0.00001);
+        }
+
+        cube.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(0.2, 0, 0.1));
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(0, 0, 0);
+        double min;
+        double max;
+        OrientedBox::from_cube(cube).project_to_axis(glm::dvec3(0, 1, 0), &min, &max);
+        cube.trajectory.orientation.center_of_mass = glm::dvec3(0, -min - 0.01, 0);
+        manifold = get_cube_plane_contact_manifold(cube, vicmil::Plane());
+        Assert(manifold.point_count == 1);
+    }
+);
+TestWrapper(TEST_get_box_box_face_contact_manifold,
+    /** A cube resting on top of another cube, moved a bit to the side, should touch it in the 4 corners of the overlapping square
+    */
+    void test() {
+        Cube bottom_cube = Cube();
+        Cube top_cube = Cube();
+        top_cube.trajectory.orientation.center_of_mass = glm::dvec3(0.5, 0.99, 0.25);
+        ContactManifold manifold = get_box_box_face_contact_manifold(
+            OrientedBox::from_cube(bottom_cube), 1, glm::dvec3(0, 1, 0), OrientedBox::from_cube(top_cube));
+        Assert(manifold.point_count == 4);
+        for(int i = 0; i < manifold.point_count; i++) {
+            Assert(abs(manifold.positions[i].y - 0.495) < 0.00001);
+            Assert(abs(manifold.penetration_depths_m[i] - 0.01) < 0.00001);
+            Assert(manifold.positions[i].x > -0.00001 && manifold.positions[i].x < 0.50001);
+            Assert(manifold.positions[i].z > -0.25001 && manifold.positions[i].z < 0.50001);
+            for(int i2 = 0; i2 < i; i2++) {
+                Assert(manifold.feature_ids[i] != manifold.feature_ids[i2]);
+            }
+        }
+
+        // Points in the same manifold should never share a feature id, whatever way the faces overlap
+        srand(5);
+        for(int test = 0; test < 20000; test++) {
+            top_cube.trajectory.orientation.center_of_mass = glm::dvec3(rand()%1800 - 900, 990, rand()%1800 - 900) / 1000.0;
+            top_cube.trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation((rand()%6284) / 1000.0, glm::dvec3(0, 1, 0));
+            manifold = get_box_box_face_contact_manifold(
+                OrientedBox::from_cube(bottom_cube), 1, glm::dvec3(0, 1, 0), OrientedBox::from_cube(top_cube));
+            for(int i = 0; i < manifold.point_count; i++) {
+                Assert(manifold.feature_ids[i] < 64);
+                for(int i2 = 0; i2 < i; i2++) {
+                    Assert(manifold.feature_ids[i] != manifold.feature_ids[i2]);
+                }
+            }
+        }
+    }
+);
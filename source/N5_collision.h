@@ -103,22 +103,517 @@ ContactImpulse handle_cube_plane_collision(Cube& cube, vicmil::Plane& plane, dou
 
 /**
  * Get the two lowest points if all points was projected to axis
+ *  Found in a single pass over the points, without copying them
+ * @param index1 Set to the lowest point, index2 to the second lowest
 */
-void get_two_lowest_points_along_axis(std::vector<glm::dvec3> points, glm::dvec3 axis, int* index1, int* index2) {
-    *index1 = vicmil::get_lowest_point_along_axis(points, axis);
-    vicmil::vec_remove(points, *index1);
-    *index2 = vicmil::get_lowest_point_along_axis(points, axis);
-    if(*index1 <= *index2) {
-        *index2 += 1;
+void get_two_lowest_points_along_axis(const glm::dvec3* points, int point_count, const glm::dvec3& axis, int* index1, int* index2) {
+    double lowest_value1 = std::numeric_limits<double>::infinity();
+    double lowest_value2 = std::numeric_limits<double>::infinity();
+    *index1 = 0;
+    *index2 = 1;
+    for(int i = 0; i < point_count; i++) {
+        double value = glm::dot(points[i], axis);
+        if(value < lowest_value1) {
+            lowest_value2 = lowest_value1;
+            *index2 = *index1;
+            lowest_value1 = value;
+            *index1 = i;
+        }
+        else if(value < lowest_value2) {
+            lowest_value2 = value;
+            *index2 = i;
+        }
     }
 }
 
+enum SeparatingAxisClass {
+    SEPARATING_AXIS_NONE = 0,
+    SEPARATING_AXIS_FACES1, // A face normal of the first cube
+    SEPARATING_AXIS_FACES2,
+    SEPARATING_AXIS_EDGE_PAIRS, // The cross product of an edge of each cube
+};
+
+// Four doubles that are operated on together, compiles to AVX if it is available, otherwise to SSE(or scalar code)
+// The values are copied with memcpy, since the arrays are not aligned to the vector size
+typedef double simd_double4 __attribute__((vector_size(4 * sizeof(double))));
+typedef int64_t simd_int64x4 __attribute__((vector_size(4 * sizeof(int64_t))));
+
+// The vectors are only passed to functions by reference, without AVX gcc warns about passing them by value
+// The lanes are set all at once with {...}, writing one lane at a time and then reading the whole vector is slow
+inline void simd_abs(simd_double4& values) {
+    values = (simd_double4)((simd_int64x4)values & (int64_t)0x7fffffffffffffff); // Clear the sign bit
+}
+// The same as std::min in each lane, values1 is kept if they are equal
+inline void simd_min(simd_double4& values1, const simd_double4& values2) {
+    simd_int64x4 smaller = (simd_int64x4)(values2 < values1); // All bits are set in the lanes where values2 is smaller
+    values1 = (simd_double4)(((simd_int64x4)values1 & ~smaller) | ((simd_int64x4)values2 & smaller));
+}
+
+/**
+ * Four 3d vectors, one in each lane
+*/
+struct simd_dvec3x4 {
+    simd_double4 x;
+    simd_double4 y;
+    simd_double4 z;
+
+    inline void set_lanes(const glm::dvec3& vec0, const glm::dvec3& vec1, const glm::dvec3& vec2, const glm::dvec3& vec3) {
+        x = simd_double4{vec0.x, vec1.x, vec2.x, vec3.x};
+        y = simd_double4{vec0.y, vec1.y, vec2.y, vec3.y};
+        z = simd_double4{vec0.z, vec1.z, vec2.z, vec3.z};
+    }
+    inline void set_all_lanes(const glm::dvec3& vec) {
+        set_lanes(vec, vec, vec, vec);
+    }
+    inline glm::dvec3 get_lane(int lane) const {
+        return glm::dvec3(x[lane], y[lane], z[lane]);
+    }
+    // The same as glm::dot, for the vectors in each lane
+    inline void dot(const simd_dvec3x4& other, simd_double4& result) const {
+        result = x * other.x + y * other.y + z * other.z;
+    }
+    // The same as glm::cross, for the vectors in each lane
+    inline void cross(const simd_dvec3x4& other, simd_dvec3x4& result) const {
+        result.x = y * other.z - other.y * z;
+        result.y = z * other.x - other.z * x;
+        result.z = x * other.y - other.x * y;
+    }
+};
+
+/**
+ * Four oriented boxes, one in each lane, or the same box in all lanes
+*/
+struct OrientedBoxX4 {
+    simd_dvec3x4 center;
+    simd_dvec3x4 axis[3];
+    simd_double4 half_side_length_m;
+
+    inline void set_lanes(const OrientedBox& box0, const OrientedBox& box1, const OrientedBox& box2, const OrientedBox& box3) {
+        center.set_lanes(box0.center, box1.center, box2.center, box3.center);
+        for(int i = 0; i < 3; i++) {
+            axis[i].set_lanes(box0.axis[i], box1.axis[i], box2.axis[i], box3.axis[i]);
+        }
+        half_side_length_m = simd_double4{box0.half_side_length_m, box1.half_side_length_m, box2.half_side_length_m, box3.half_side_length_m};
+    }
+    inline void set_all_lanes(const OrientedBox& box) {
+        set_lanes(box, box, box, box);
+    }
+    // See OrientedBox::project_to_axis, each box is projected to the axis in its own lane
+    inline void project_to_axis(const simd_dvec3x4& projection_axis, simd_double4& min, simd_double4& max) const {
+        simd_double4 center_projected;
+        center.dot(projection_axis, center_projected);
+        simd_double4 alignments[3];
+        for(int i = 0; i < 3; i++) {
+            axis[i].dot(projection_axis, alignments[i]);
+            simd_abs(alignments[i]);
+        }
+        simd_double4 radius = half_side_length_m * (alignments[0] + alignments[1] + alignments[2]);
+        min = center_projected - radius;
+        max = center_projected + radius;
+    }
+};
+
+// See get_box_box_overlap_along_axis and vicmil::get_overlap
+inline void get_box_box_overlap_along_axis_x4(const OrientedBoxX4& boxes1, const OrientedBoxX4& boxes2, const simd_dvec3x4& axis, simd_double4& overlap) {
+    simd_double4 boxes1_min;
+    simd_double4 boxes1_max;
+    simd_double4 boxes2_min;
+    simd_double4 boxes2_max;
+    boxes1.project_to_axis(axis, boxes1_min, boxes1_max);
+    boxes2.project_to_axis(axis, boxes2_min, boxes2_max);
+    overlap = boxes1_max - boxes2_min;
+    simd_min(overlap, boxes2_max - boxes1_min);
+}
+
+/**
+ * Normalize the edge pair axis in each lane, the same way as get_box_box_overlap_along_edge_pairs
+ * @param valid All bits are cleared in the lanes where the edges are parallel, those axis can not separate the boxes
+*/
+inline void normalize_edge_pair_axis_x4(simd_dvec3x4& axis, simd_int64x4& valid) {
+    simd_double4 length2;
+    axis.dot(axis, length2);
+    valid = (simd_int64x4)(length2 > 0.00001);
+    auto get_inverse_length = [&](int lane) {
+        return valid[lane] ? 1.0 / std::sqrt(length2[lane]) : 0.0;
+    };
+    simd_double4 inverse_length = simd_double4{get_inverse_length(0), get_inverse_length(1), get_inverse_length(2), get_inverse_length(3)};
+    axis.x = axis.x * inverse_length;
+    axis.y = axis.y * inverse_length;
+    axis.z = axis.z * inverse_length;
+}
+
+/**
+ * The overlaps along all 15 separating axis of two boxes
+*/
+struct BoxBoxOverlaps {
+    Overlap faces1; // The same as get_box_box_overlap_along_faces(box1, box2)
+    Overlap faces2; // The same as get_box_box_overlap_along_faces(box2, box1)
+    Overlap edge_pairs; // The same as get_box_box_overlap_along_edge_pairs(box1, box2)
+    // The first kind of axis that separates the boxes, the axis after it are not tested so their overlaps are not set
+    SeparatingAxisClass separating_axis_class = SEPARATING_AXIS_NONE;
+
+    BoxBoxOverlaps() {
+        // The same start values as the scalar loops, they are kept if no axis is valid
+        faces1.axis = glm::dvec3(0, 1, 0);
+        faces1.overlap = 1000000000;
+        faces2 = faces1;
+        edge_pairs.axis = glm::dvec3(0, 1, 0);
+        edge_pairs.overlap = 10000000;
+    }
+};
+
+// Keep the smallest overlap, the earlier axis wins if they are equal, like in the scalar loops
+inline void update_min_overlap(Overlap& min_overlap, double overlap, const glm::dvec3& axis, int axis_index) {
+    if(overlap < min_overlap.overlap) {
+        min_overlap.overlap = overlap;
+        min_overlap.axis = axis;
+        min_overlap.axis_index = axis_index;
+    }
+}
+
+/**
+ * Test all 15 separating axis of two boxes, four axis at a time
+ *  The 3 face axis of box1 are tested together, then the 3 of box2, then the 9 edge pairs as 3 groups of 3
+ *  It stops as soon as a group has an axis that separates the boxes
+ * @return The same axis and overlaps as the scalar functions, 
+ *  see get_box_box_overlap_along_faces and get_box_box_overlap_along_edge_pairs
+*/
+BoxBoxOverlaps get_box_box_overlaps(const OrientedBox& box1, const OrientedBox& box2) {
+    OrientedBoxX4 boxes1;
+    boxes1.set_all_lanes(box1);
+    OrientedBoxX4 boxes2;
+    boxes2.set_all_lanes(box2);
+    // Lane 3 repeats the last axis, so it never gives a new smallest overlap
+    simd_dvec3x4 box1_axis;
+    box1_axis.set_lanes(box1.axis[0], box1.axis[1], box1.axis[2], box1.axis[2]);
+    simd_dvec3x4 box2_axis;
+    box2_axis.set_lanes(box2.axis[0], box2.axis[1], box2.axis[2], box2.axis[2]);
+    BoxBoxOverlaps overlaps;
+
+    simd_double4 faces1_overlaps;
+    get_box_box_overlap_along_axis_x4(boxes1, boxes2, box1_axis, faces1_overlaps);
+    for(int lane = 0; lane < 3; lane++) {
+        update_min_overlap(overlaps.faces1, faces1_overlaps[lane], box1.axis[lane], lane);
+    }
+    if(overlaps.faces1.overlap <= 0) {
+        overlaps.separating_axis_class = SEPARATING_AXIS_FACES1;
+        return overlaps;
+    }
+
+    simd_double4 faces2_overlaps;
+    get_box_box_overlap_along_axis_x4(boxes2, boxes1, box2_axis, faces2_overlaps);
+    for(int lane = 0; lane < 3; lane++) {
+        update_min_overlap(overlaps.faces2, faces2_overlaps[lane], box2.axis[lane], lane);
+    }
+    if(overlaps.faces2.overlap <= 0) {
+        overlaps.separating_axis_class = SEPARATING_AXIS_FACES2;
+        return overlaps;
+    }
+
+    for(int i = 0; i < 3; i++) {
+        simd_dvec3x4 axis;
+        boxes1.axis[i].cross(box2_axis, axis);
+        simd_int64x4 valid;
+        normalize_edge_pair_axis_x4(axis, valid);
+        simd_double4 edge_pair_overlaps;
+        get_box_box_overlap_along_axis_x4(boxes1, boxes2, axis, edge_pair_overlaps);
+        for(int lane = 0; lane < 3; lane++) {
+            if(valid[lane]) {
+                update_min_overlap(overlaps.edge_pairs, edge_pair_overlaps[lane], axis.get_lane(lane), i * 3 + lane);
+            }
+        }
+        if(overlaps.edge_pairs.overlap <= 0) {
+            overlaps.separating_axis_class = SEPARATING_AXIS_EDGE_PAIRS;
+            return overlaps;
+        }
+    }
+    return overlaps;
+}
+
+/**
+ * The smallest overlap so far in each lane, see Overlap
+*/
+struct OverlapX4 {
+    simd_dvec3x4 axis;
+    simd_double4 overlap;
+    simd_double4 axis_index;
+
+    inline void set_all_lanes(const Overlap& start_overlap) {
+        axis.set_all_lanes(start_overlap.axis);
+        overlap = simd_double4{start_overlap.overlap, start_overlap.overlap, start_overlap.overlap, start_overlap.overlap};
+        axis_index = simd_double4{0, 0, 0, 0} + start_overlap.axis_index;
+    }
+    // Keep the smallest overlap in the valid lanes, the earlier axis wins if they are equal, like in the scalar loops
+    inline void update(const simd_double4& new_overlap, const simd_dvec3x4& new_axis, int new_axis_index, const simd_int64x4& valid) {
+        simd_int64x4 smaller = (simd_int64x4)(new_overlap < overlap) & valid;
+        auto select = [&](simd_double4& values, const simd_double4& new_values) {
+            values = (simd_double4)(((simd_int64x4)values & ~smaller) | ((simd_int64x4)new_values & smaller));
+        };
+        select(overlap, new_overlap);
+        select(axis.x, new_axis.x);
+        select(axis.y, new_axis.y);
+        select(axis.z, new_axis.z);
+        select(axis_index, simd_double4{0, 0, 0, 0} + new_axis_index);
+    }
+    inline Overlap get_lane(int lane) const {
+        Overlap lane_overlap;
+        lane_overlap.axis = axis.get_lane(lane);
+        lane_overlap.overlap = overlap[lane];
+        lane_overlap.axis_index = axis_index[lane];
+        return lane_overlap;
+    }
+};
+
+/**
+ * Test one box against a packet of other boxes, with one of the other boxes in each lane
+ *  The smallest overlaps are kept in the lanes as well, so each axis is only a few vector instructions
+ *  It stops once all boxes in the group of four are separated
+ * @param boxes2 The other boxes, any number of them
+ * @param overlaps Filled with the result for each of boxes2, the same as get_box_box_overlaps(box1, *boxes2[i]),
+ *  except that the axis after the separating one may also be set
+*/
+void get_box_box_overlaps_packet(const OrientedBox& box1, const OrientedBox* const* boxes2, int box_count, BoxBoxOverlaps* overlaps) {
+    OrientedBoxX4 boxes1;
+    boxes1.set_all_lanes(box1);
+    const simd_int64x4 all_lanes = simd_int64x4{-1, -1, -1, -1};
+    BoxBoxOverlaps start_overlaps;
+    for(int first = 0; first < box_count; first += 4) {
+        int lane_count = std::min(box_count - first, 4);
+        // Unused lanes repeat the last box, their results are thrown away
+        auto get_lane_box = [&](int lane) -> const OrientedBox& {
+            return *boxes2[first + std::min(lane, lane_count - 1)];
+        };
+        OrientedBoxX4 boxes2_x4;
+        boxes2_x4.set_lanes(get_lane_box(0), get_lane_box(1), get_lane_box(2), get_lane_box(3));
+
+        OverlapX4 faces1;
+        faces1.set_all_lanes(start_overlaps.faces1);
+        OverlapX4 faces2;
+        faces2.set_all_lanes(start_overlaps.faces2);
+        OverlapX4 edge_pairs;
+        edge_pairs.set_all_lanes(start_overlaps.edge_pairs);
+        SeparatingAxisClass separating_axis_classes[4] = {SEPARATING_AXIS_NONE, SEPARATING_AXIS_NONE, SEPARATING_AXIS_NONE, SEPARATING_AXIS_NONE};
+        // Set the class of the lanes that were separated by this kind of axis, and check if all lanes are separated
+        auto set_separated = [&](const OverlapX4& overlap, SeparatingAxisClass separating_axis_class) {
+            bool all_separated = true;
+            for(int lane = 0; lane < lane_count; lane++) {
+                if(separating_axis_classes[lane] == SEPARATING_AXIS_NONE && overlap.overlap[lane] <= 0) {
+                    separating_axis_classes[lane] = separating_axis_class;
+                }
+                all_separated = all_separated && separating_axis_classes[lane] != SEPARATING_AXIS_NONE;
+            }
+            return all_separated;
+        };
+
+        for(int i = 0; i < 3; i++) {
+            simd_double4 faces1_overlaps;
+            get_box_box_overlap_along_axis_x4(boxes1, boxes2_x4, boxes1.axis[i], faces1_overlaps);
+            faces1.update(faces1_overlaps, boxes1.axis[i], i, all_lanes);
+        }
+        bool all_separated = set_separated(faces1, SEPARATING_AXIS_FACES1);
+
+        for(int i = 0; i < 3 && !all_separated; i++) {
+            simd_double4 faces2_overlaps;
+            get_box_box_overlap_along_axis_x4(boxes2_x4, boxes1, boxes2_x4.axis[i], faces2_overlaps);
+            faces2.update(faces2_overlaps, boxes2_x4.axis[i], i, all_lanes);
+        }
+        all_separated = all_separated || set_separated(faces2, SEPARATING_AXIS_FACES2);
+
+        for(int i = 0; i < 3 && !all_separated; i++) {
+            for(int i2 = 0; i2 < 3; i2++) {
+                simd_dvec3x4 axis;
+                boxes1.axis[i].cross(boxes2_x4.axis[i2], axis);
+                simd_int64x4 valid;
+                normalize_edge_pair_axis_x4(axis, valid);
+                simd_double4 edge_pair_overlaps;
+                get_box_box_overlap_along_axis_x4(boxes1, boxes2_x4, axis, edge_pair_overlaps);
+                edge_pairs.update(edge_pair_overlaps, axis, i * 3 + i2, valid);
+            }
+        }
+        if(!all_separated) {
+            set_separated(edge_pairs, SEPARATING_AXIS_EDGE_PAIRS);
+        }
+
+        for(int lane = 0; lane < lane_count; lane++) {
+            BoxBoxOverlaps& lane_overlaps = overlaps[first + lane];
+            lane_overlaps.faces1 = faces1.get_lane(lane);
+            lane_overlaps.faces2 = faces2.get_lane(lane);
+            lane_overlaps.edge_pairs = edge_pairs.get_lane(lane);
+            lane_overlaps.separating_axis_class = separating_axis_classes[lane];
+        }
+    }
+}
+TestWrapper(TEST_get_box_box_overlaps,
+    /** The batched tests should give the same axis and overlaps as testing one axis at a time
+    */
+    void test() {
+        srand(3);
+        auto get_random_box = []() {
+            Cube cube = Cube();
+            cube.side_length_m = 0.5 + (rand()%100) / 100.0;
+            cube.trajectory.orientation.center_of_mass = glm::dvec3(rand()%100, rand()%100, rand()%100) / 50.0;
+            cube.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            if(rand()%4 == 0) {
+                cube.trajectory.orientation.rotational_orientation = Rotation(); // Parallel edges
+            }
+            return OrientedBox::from_cube(cube);
+        };
+        auto assert_same_overlap = [](const Overlap& overlap, const Overlap& expected_overlap) {
+            Assert(overlap.axis_index == expected_overlap.axis_index);
+            Assert(abs(overlap.overlap - expected_overlap.overlap) < 0.0000001);
+            Assert(glm::length(overlap.axis - expected_overlap.axis) < 0.0000001);
+        };
+        std::vector<int> separated_counts = std::vector<int>(4, 0);
+        for(int i = 0; i < 200; i++) {
+            OrientedBox box1 = get_random_box();
+            OrientedBox boxes2[7];
+            const OrientedBox* box_pointers2[7];
+            for(int i2 = 0; i2 < 7; i2++) {
+                boxes2[i2] = get_random_box();
+                box_pointers2[i2] = &boxes2[i2];
+            }
+            BoxBoxOverlaps packet_overlaps[7];
+            get_box_box_overlaps_packet(box1, box_pointers2, 7, packet_overlaps);
+
+            for(int i2 = 0; i2 < 7; i2++) {
+                Overlap expected_faces1 = get_box_box_overlap_along_faces(box1, boxes2[i2]);
+                Overlap expected_faces2 = get_box_box_overlap_along_faces(boxes2[i2], box1);
+                Overlap expected_edge_pairs = get_box_box_overlap_along_edge_pairs(box1, boxes2[i2]);
+                SeparatingAxisClass expected_class = SEPARATING_AXIS_NONE;
+                if(expected_faces1.overlap <= 0) expected_class = SEPARATING_AXIS_FACES1;
+                else if(expected_faces2.overlap <= 0) expected_class = SEPARATING_AXIS_FACES2;
+                else if(expected_edge_pairs.overlap <= 0) expected_class = SEPARATING_AXIS_EDGE_PAIRS;
+                separated_counts[expected_class] += 1;
+
+                BoxBoxOverlaps results[2];
+                results[0] = get_box_box_overlaps(box1, boxes2[i2]);
+                results[1] = packet_overlaps[i2];
+                for(const BoxBoxOverlaps& result : results) {
+                    Assert(result.separating_axis_class == expected_class);
+                    assert_same_overlap(result.faces1, expected_faces1);
+                    if(expected_class == SEPARATING_AXIS_NONE || expected_class == SEPARATING_AXIS_EDGE_PAIRS) {
+                        assert_same_overlap(result.faces2, expected_faces2);
+                    }
+                    if(expected_class == SEPARATING_AXIS_NONE) {
+                        assert_same_overlap(result.edge_pairs, expected_edge_pairs);
+                    }
+                }
+            }
+        }
+        // Make sure all the cases were tested
+        for(int i = 0; i < 4; i++) {
+            Assert(separated_counts[i] > 0);
+        }
+    }
+);
+
+/**
+ * One of the 15 separating axis of a box pair, kept between steps so it can be tested first next time
+ *  Boxes that were separated along an axis are usually still separated along it in the next step
+ *  The axis is stored as a face or edge pair instead of a direction, so it follows the boxes when they rotate
+*/
+struct CachedSeparatingAxis {
+    SeparatingAxisClass axis_class = SEPARATING_AXIS_NONE; // NONE if there is no axis yet
+    int axis_index = 0; // The axis_index of the Overlap, see BoxBoxOverlaps
+
+    /**
+     * Get the axis that separated the boxes, or the axis with the smallest overlap if they overlap
+    */
+    static CachedSeparatingAxis from_overlaps(const BoxBoxOverlaps& overlaps) {
+        CachedSeparatingAxis cached_axis;
+        if(overlaps.separating_axis_class != SEPARATING_AXIS_NONE) {
+            cached_axis.axis_class = overlaps.separating_axis_class;
+        }
+        else if(overlaps.faces1.overlap <= overlaps.faces2.overlap && overlaps.faces1.overlap <= overlaps.edge_pairs.overlap) {
+            cached_axis.axis_class = SEPARATING_AXIS_FACES1;
+        }
+        else if(overlaps.faces2.overlap <= overlaps.edge_pairs.overlap) {
+            cached_axis.axis_class = SEPARATING_AXIS_FACES2;
+        }
+        else {
+            cached_axis.axis_class = SEPARATING_AXIS_EDGE_PAIRS;
+        }
+        if(cached_axis.axis_class == SEPARATING_AXIS_FACES1) {
+            cached_axis.axis_index = overlaps.faces1.axis_index;
+        }
+        else if(cached_axis.axis_class == SEPARATING_AXIS_FACES2) {
+            cached_axis.axis_index = overlaps.faces2.axis_index;
+        }
+        else {
+            cached_axis.axis_index = overlaps.edge_pairs.axis_index;
+        }
+        return cached_axis;
+    }
+};
+
+/**
+ * Test only the cached axis, which is a single projection of each box
+ *  The boxes have to be separated by a small margin, so that rounding never makes it disagree with testing all axis
+ * @return true if the boxes are separated along the axis, false if they might overlap and all axis have to be tested
+*/
+inline bool is_box_box_separated_along_cached_axis(const OrientedBox& box1, const OrientedBox& box2, const CachedSeparatingAxis& cached_axis) {
+    const double separation_margin_m = 0.000000001;
+    if(cached_axis.axis_class == SEPARATING_AXIS_FACES1) {
+        return get_box_box_overlap_along_axis(box1, box2, box1.axis[cached_axis.axis_index]) < -separation_margin_m;
+    }
+    if(cached_axis.axis_class == SEPARATING_AXIS_FACES2) {
+        return get_box_box_overlap_along_axis(box2, box1, box2.axis[cached_axis.axis_index]) < -separation_margin_m;
+    }
+    if(cached_axis.axis_class == SEPARATING_AXIS_EDGE_PAIRS) {
+        glm::dvec3 axis = glm::cross(box1.axis[cached_axis.axis_index / 3], box2.axis[cached_axis.axis_index % 3]);
+        if(glm::length2(axis) <= 0.00001) {
+            return false; // The edges have become parallel, so the axis is not valid any more
+        }
+        return get_box_box_overlap_along_axis(box1, box2, glm::normalize(axis)) < -separation_margin_m;
+    }
+    return false;
+}
+TestWrapper(TEST_is_box_box_separated_along_cached_axis,
+    /** The cached axis should separate the boxes it was taken from, and never boxes that overlap
+    */
+    void test() {
+        srand(4);
+        int separated_count = 0;
+        for(int i = 0; i < 500; i++) {
+            Cube cube1 = Cube();
+            Cube cube2 = Cube();
+            cube2.trajectory.orientation.center_of_mass = glm::dvec3(rand()%100, rand()%100, rand()%100) / 60.0;
+            cube2.trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            OrientedBox box1 = OrientedBox::from_cube(cube1);
+            OrientedBox box2 = OrientedBox::from_cube(cube2);
+            BoxBoxOverlaps overlaps = get_box_box_overlaps(box1, box2);
+            CachedSeparatingAxis cached_axis = CachedSeparatingAxis::from_overlaps(overlaps);
+            Assert(cached_axis.axis_class != SEPARATING_AXIS_NONE);
+            bool separated = is_box_box_separated_along_cached_axis(box1, box2, cached_axis);
+            if(overlaps.separating_axis_class == SEPARATING_AXIS_NONE) {
+                Assert(!separated);
+            }
+            separated_count += separated;
+        }
+        Assert(separated_count > 0);
+        OrientedBox far_box = OrientedBox::from_cube(Cube());
+        far_box.center.x = 10;
+        Assert(!is_box_box_separated_along_cached_axis(OrientedBox::from_cube(Cube()), far_box, CachedSeparatingAxis())); // Nothing cached yet
+    }
+);
+
 struct IntersectionResolution {
     glm::dvec3 new_obj1_pos;
     glm::dvec3 new_obj2_pos;
     glm::dvec3 collision_position;
     glm::dvec3 collision_axis; // The collision axis will signal the direction to apply force to obj1
     bool is_collision = true;
+    double penetration_depth_m = 0; // How far the cubes overlapped along the collision axis
+    // Tells which features of the cubes are touching(e.g. which face and corner), it stays the same 
+    // between steps as long as the cubes touch in the same way
+    // 0-23: a face of obj1 and a corner of obj2, 24-47: a face of obj2 and a corner of obj1, 48-56: an edge pair
+    int feature_id = 0;
+    // All the points where the cubes touch, measured before the cubes are separated
+    // The feature ids are 64 * (face or edge pair) + the feature id of the point in the face
+    ContactManifold manifold;
+    // If there is no collision, the first kind of axis that separates the cubes
+    SeparatingAxisClass separating_axis_class = SEPARATING_AXIS_NONE;
+    bool separated_by_cached_axis = false; // Only the cached axis was tested, see is_box_box_separated_along_cached_axis
 };
 
 // If the axis is not aligned along vector, flip it
@@ -134,129 +629,198 @@ glm::dvec3 align_axis_along_vector(glm::dvec3 axis, glm::dvec3 vec) {
     return axis;
 }
 void handle_cube_separation_along_axis(
-    const Cube& cube1, 
-    const Cube& cube2, 
+    const CubeBodyState& body1, 
+    const CubeBodyState& body2, 
     double overlap, 
     glm::dvec3 move_cube1_axis, 
     glm::dvec3* new_cube1_pos, 
     glm::dvec3* new_cube2_pos) {
     glm::dvec3 axis = glm::normalize(move_cube1_axis);
-    double tot_inv_mass = 1.0/cube1.mass_kg + 1.0/cube2.mass_kg;
-    *new_cube1_pos = cube1.trajectory.orientation.center_of_mass + (overlap+0.01) * axis * (1.0/cube1.mass_kg) / tot_inv_mass;
-    *new_cube2_pos = cube2.trajectory.orientation.center_of_mass - (overlap+0.01) * axis * (1.0/cube2.mass_kg) / tot_inv_mass;
+    double tot_inv_mass = body1.inverse_mass_kg + body2.inverse_mass_kg;
+    *new_cube1_pos = body1.box.center + (overlap+0.01) * axis * body1.inverse_mass_kg / tot_inv_mass;
+    *new_cube2_pos = body2.box.center - (overlap+0.01) * axis * body2.inverse_mass_kg / tot_inv_mass;
     return;
 }
-IntersectionResolution handle_face1_collision(const Cube& cube1, const Cube& cube2, const Overlap& overlap_) {
+/**
+ * Add the base to all feature ids in the manifold, so that points from different faces get different ids
+ *  If the manifold is empty, the single collision position is used instead
+*/
+void set_manifold_feature_base(IntersectionResolution& intersection_resolution, int feature_base) {
+    ContactManifold& manifold = intersection_resolution.manifold;
+    if(manifold.point_count == 0) {
+        manifold.add_point(intersection_resolution.collision_position, intersection_resolution.penetration_depth_m, 0);
+    }
+    for(int i = 0; i < manifold.point_count; i++) {
+        manifold.feature_ids[i] += feature_base;
+    }
+}
+IntersectionResolution handle_face1_collision(const CubeBodyState& body1, const CubeBodyState& body2, const Overlap& overlap_) {
     START_TRACE_FUNCTION();
     IntersectionResolution intersection_resolution;
 
     // Align axis in direction that cube1 should move
-    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, cube1.trajectory.orientation.center_of_mass - cube2.trajectory.orientation.center_of_mass);
+    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, body1.box.center - body2.box.center);
     intersection_resolution.collision_axis = axis;
 
     // Determine new cube positions to separate cubes
-    handle_cube_separation_along_axis(cube1, cube2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    handle_cube_separation_along_axis(body1, body2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    intersection_resolution.penetration_depth_m = overlap_.overlap;
 
     // Determine where the objects are colliding
-    Cube cube_copy = cube2;
-    cube_copy.trajectory.orientation.center_of_mass = intersection_resolution.new_obj2_pos;
-    std::vector<glm::dvec3> corners = cube_copy.get_corner_positions();
-    int lowest_point = vicmil::get_lowest_point_along_axis(corners, -axis);
-    intersection_resolution.collision_position = corners[lowest_point];
+    OrientedBox box = body2.box;
+    box.center = intersection_resolution.new_obj2_pos;
+    int corner_index = box.get_lowest_corner_index_along_axis(-axis);
+    intersection_resolution.collision_position = box.get_corner_position(corner_index);
+    intersection_resolution.feature_id = overlap_.axis_index * 8 + corner_index;
+
+    // The face of cube1 is pushed into cube2, against the direction cube1 should move
+    intersection_resolution.manifold = get_box_box_face_contact_manifold(
+        body1.box, overlap_.axis_index, -axis, body2.box, body2.corners);
+    set_manifold_feature_base(intersection_resolution, overlap_.axis_index * 64);
 
     return intersection_resolution;
 }
-IntersectionResolution handle_face2_collision(const Cube& cube1, const Cube& cube2, const Overlap& overlap_) {
+IntersectionResolution handle_face2_collision(const CubeBodyState& body1, const CubeBodyState& body2, const Overlap& overlap_) {
     START_TRACE_FUNCTION();
     IntersectionResolution intersection_resolution;
 
     // Align axis in direction that cube1 should move
-    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, cube1.trajectory.orientation.center_of_mass - cube2.trajectory.orientation.center_of_mass);
+    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, body1.box.center - body2.box.center);
     intersection_resolution.collision_axis = axis;
 
     // Determine new cube positions to separate cubes
-    handle_cube_separation_along_axis(cube1, cube2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    handle_cube_separation_along_axis(body1, body2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    intersection_resolution.penetration_depth_m = overlap_.overlap;
 
     // Determine where the objects are colliding
-    Cube cube_copy = cube1;
-    cube_copy.trajectory.orientation.center_of_mass = intersection_resolution.new_obj1_pos;
-    std::vector<glm::dvec3> corners = cube_copy.get_corner_positions();
-    int lowest_point = vicmil::get_lowest_point_along_axis(corners, axis);
-    intersection_resolution.collision_position = corners[lowest_point];
+    OrientedBox box = body1.box;
+    box.center = intersection_resolution.new_obj1_pos;
+    int corner_index = box.get_lowest_corner_index_along_axis(axis);
+    intersection_resolution.collision_position = box.get_corner_position(corner_index);
+    intersection_resolution.feature_id = 24 + overlap_.axis_index * 8 + corner_index;
+
+    intersection_resolution.manifold = get_box_box_face_contact_manifold(
+        body2.box, overlap_.axis_index, axis, body1.box, body1.corners);
+    set_manifold_feature_base(intersection_resolution, (3 + overlap_.axis_index) * 64);
 
     return intersection_resolution;
 }   
-IntersectionResolution handle_edge_collision(const Cube& cube1, const Cube& cube2, const Overlap& overlap_) {
+IntersectionResolution handle_edge_collision(const CubeBodyState& body1, const CubeBodyState& body2, const Overlap& overlap_) {
     START_TRACE_FUNCTION();
     IntersectionResolution intersection_resolution;
 
     // Align axis in direction that cube1 should move
-    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, cube1.trajectory.orientation.center_of_mass - cube2.trajectory.orientation.center_of_mass);
+    glm::dvec3 axis = align_axis_along_vector(overlap_.axis, body1.box.center - body2.box.center);
     intersection_resolution.collision_axis = axis;
 
     // Determine new cube positions to separate cubes
-    handle_cube_separation_along_axis(cube1, cube2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    handle_cube_separation_along_axis(body1, body2, overlap_.overlap, axis, &intersection_resolution.new_obj1_pos, &intersection_resolution.new_obj2_pos);
+    intersection_resolution.penetration_depth_m = overlap_.overlap;
+    intersection_resolution.feature_id = 48 + overlap_.axis_index;
 
     // Determine where the objects are colliding
-    // In the edge case, pick the points closest and then calculate where they intersect
-    Cube cube1_copy = cube1;
-    cube1_copy.trajectory.orientation.center_of_mass = intersection_resolution.new_obj1_pos;
-    std::vector<glm::dvec3> cube1_corners = cube1_copy.get_corner_positions();
+    // In the edge case, pick the edge of each cube that is furthest into the other cube, they touch where the edges
+    // are closest. Measured where the cubes are now, like the face manifolds, since that is where the contact is solved
+    const glm::dvec3* cube1_corners = body1.corners;
+    const glm::dvec3* cube2_corners = body2.corners;
     int cube1_corner1;
     int cube1_corner2;
-    get_two_lowest_points_along_axis(cube1_corners, axis, &cube1_corner1, &cube1_corner2);
+    get_two_lowest_points_along_axis(cube1_corners, 8, axis, &cube1_corner1, &cube1_corner2);
 
-    Cube cube2_copy = cube2;
-    cube2_copy.trajectory.orientation.center_of_mass = intersection_resolution.new_obj2_pos;
-    std::vector<glm::dvec3> cube2_corners = cube2_copy.get_corner_positions();
     int cube2_corner1;
     int cube2_corner2;
-    get_two_lowest_points_along_axis(cube2_corners, -axis, &cube2_corner1, &cube2_corner2);
-
-    // Get where on the edge they are colliding
-    vicmil::Line line;
-    line.point = cube2_corners[cube2_corner1];
-    line.vector = cube2_corners[cube2_corner1] - cube2_corners[cube2_corner2];
-    vicmil::get_closest_point_on_line_segment_to_line(cube1_corners[cube1_corner1], cube1_corners[cube1_corner2], line);
+    get_two_lowest_points_along_axis(cube2_corners, 8, -axis, &cube2_corner1, &cube2_corner2);
+
+    // Get where on the edges they are colliding, halfway between the closest points of the edges
+    vicmil::Line line1;
+    line1.point = cube1_corners[cube1_corner1];
+    line1.vector = cube1_corners[cube1_corner1] - cube1_corners[cube1_corner2];
+    vicmil::Line line2;
+    line2.point = cube2_corners[cube2_corner1];
+    line2.vector = cube2_corners[cube2_corner1] - cube2_corners[cube2_corner2];
+    glm::dvec3 closest_point1 = vicmil::get_closest_point_on_line_segment_to_line(cube1_corners[cube1_corner1], cube1_corners[cube1_corner2], line2);
+    glm::dvec3 closest_point2 = vicmil::get_closest_point_on_line_segment_to_line(cube2_corners[cube2_corner1], cube2_corners[cube2_corner2], line1);
+    intersection_resolution.collision_position = (closest_point1 + closest_point2) * 0.5;
+
+    // Two edges only touch in one point
+    set_manifold_feature_base(intersection_resolution, (6 + overlap_.axis_index) * 64);
 
     return intersection_resolution;
 }
-IntersectionResolution get_cube_cube_intersection_resolution(const Cube& cube1, const Cube& cube2) {
-    //1: determine if the cube1 is colliding with cube2
-    Overlap overlap_faces1 = get_cube_cube_overlap_along_faces(cube1, cube2);
-    Overlap overlap_faces2 = get_cube_cube_overlap_along_faces(cube2, cube1);
-    Overlap overlap_edge_pairs = get_cube_cube_overlap_along_edge_pairs(cube1, cube2);
-
-    DebugExpr(overlap_faces1.overlap);
-    DebugExpr(overlap_faces2.overlap);
-    DebugExpr(overlap_edge_pairs.overlap);
-
+/**
+ * Find if two cubes intersect, and if so how to separate them and where they touch
+ *  Only reads the body states, see CubeBodyState
+ * @param overlaps The overlaps of the boxes of the body states, see get_box_box_overlaps
+*/
+IntersectionResolution get_cube_cube_intersection_resolution(const CubeBodyState& body1, const CubeBodyState& body2, const BoxBoxOverlaps& overlaps) {
     // The there is no overlap along one of the axis, then there is no collision!
-    if(overlap_faces1.overlap <= 0 || overlap_faces2.overlap <= 0 || overlap_edge_pairs.overlap <= 0) {
+    if(overlaps.separating_axis_class != SEPARATING_AXIS_NONE) {
         IntersectionResolution intersection_resolution;
         intersection_resolution.is_collision = false;
+        intersection_resolution.separating_axis_class = overlaps.separating_axis_class;
         return intersection_resolution;
     }
+    const Overlap& overlap_faces1 = overlaps.faces1;
+    const Overlap& overlap_faces2 = overlaps.faces2;
+    const Overlap& overlap_edge_pairs = overlaps.edge_pairs;
+
+    DebugExpr(overlap_faces1.overlap);
+    DebugExpr(overlap_faces2.overlap);
+    DebugExpr(overlap_edge_pairs.overlap);
+
     if(overlap_faces1.overlap <= overlap_faces2.overlap && overlap_faces1.overlap <= overlap_edge_pairs.overlap) {
-        return handle_face1_collision(cube1, cube2, overlap_faces1);
+        return handle_face1_collision(body1, body2, overlap_faces1);
     }
     if(overlap_faces2.overlap <= overlap_faces1.overlap && overlap_faces2.overlap <= overlap_edge_pairs.overlap) {
-        return handle_face2_collision(cube1, cube2, overlap_faces2);
+        return handle_face2_collision(body1, body2, overlap_faces2);
     }
     if(overlap_edge_pairs.overlap <= overlap_faces1.overlap && overlap_edge_pairs.overlap <= overlap_faces2.overlap) {
-        return handle_edge_collision(cube1, cube2, overlap_edge_pairs);
+        return handle_edge_collision(body1, body2, overlap_edge_pairs);
     }
 
     ThrowError("Should be unreachable!");
 }
+IntersectionResolution get_cube_cube_intersection_resolution(const CubeBodyState& body1, const CubeBodyState& body2) {
+    return get_cube_cube_intersection_resolution(body1, body2, get_box_box_overlaps(body1.box, body2.box));
+}
+IntersectionResolution get_cube_cube_intersection_resolution(const Cube& cube1, const Cube& cube2) {
+    return get_cube_cube_intersection_resolution(CubeBodyState::from_cube(cube1), CubeBodyState::from_cube(cube2));
+}
+TestWrapper(TEST_get_cube_cube_intersection_resolution_edges,
+    /** Two cubes whose edges cross should touch halfway between the edges, where the cubes are now
+    */
+    void test() {
+        Cube cube1 = Cube();
+        cube1.trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation(vicmil::PI / 4, glm::dvec3(0, 0, 1));
+        Cube cube2 = Cube();
+        cube2.trajectory.orientation.rotational_orientation = Rotation::from_axis_rotation(vicmil::PI / 4, glm::dvec3(1, 0, 0));
+        // The lowest edge of cube1 goes along z, the highest edge of cube2 along x, they overlap by 0.1m
+        cube2.trajectory.orientation.center_of_mass = glm::dvec3(0, -std::sqrt(2.0) + 0.1, 0);
+        IntersectionResolution resolution = get_cube_cube_intersection_resolution(cube1, cube2);
+        Assert(resolution.is_collision);
+        Assert(resolution.feature_id >= 48);
+        Assert(std::abs(resolution.penetration_depth_m - 0.1) < 1e-9);
+        Assert(glm::length(resolution.collision_axis - glm::dvec3(0, 1, 0)) < 1e-9);
+        Assert(glm::length(resolution.collision_position - glm::dvec3(0, -std::sqrt(0.5) + 0.05, 0)) < 1e-9);
+
+        int index1;
+        int index2;
+        glm::dvec3 points[4];
+        points[0] = glm::dvec3(0, 3, 0);
+        points[1] = glm::dvec3(0, 1, 0);
+        points[2] = glm::dvec3(0, 2, 0);
+        points[3] = glm::dvec3(0, 1, 0);
+        get_two_lowest_points_along_axis(points, 4, glm::dvec3(0, 1, 0), &index1, &index2);
+        Assert(index1 == 1 && index2 == 3);
+    }
+);
 
 /**
- * Fully resolve cube-cube collision
- * The collision is resolved by finding the contact point, contact normal, and then applying the correct impulse there
+ * Separate the cubes and apply the impulse for an intersection that has already been found
+ *  Finding the intersection only reads the cubes, so that part can be done separately(e.g. on another thread)
  * @return the impulse magnitude, it will be 0 if there was no collision
 */
-ContactImpulse handle_cube_cube_collision(Cube& cube1, Cube& cube2, double restitution_constant = 0.8) {
-    IntersectionResolution intersection_resolution = get_cube_cube_intersection_resolution(cube1, cube2);
+ContactImpulse apply_cube_cube_intersection_resolution(Cube& cube1, Cube& cube2, const IntersectionResolution& intersection_resolution, double restitution_constant = 0.8) {
     if(!intersection_resolution.is_collision) {
         return ContactImpulse::zero(); // No intersection
     }
@@ -292,4 +856,109 @@ ContactImpulse handle_cube_cube_collision(Cube& cube1, Cube& cube2, double resti
     
 
     return impulse;
-}
\ No newline at end of file
+}
+
+/**
+ * Fully resolve cube-cube collision
+ * The collision is resolved by finding the contact point, contact normal, and then applying the correct impulse there
+ * @return the impulse magnitude, it will be 0 if there was no collision
+*/
+ContactImpulse handle_cube_cube_collision(Cube& cube1, Cube& cube2, double restitution_constant = 0.8) {
+    IntersectionResolution intersection_resolution = get_cube_cube_intersection_resolution(cube1, cube2);
+    return apply_cube_cube_intersection_resolution(cube1, cube2, intersection_resolution, restitution_constant);
+}
+
+inline Cube get_benchmark_random_cube(vicmil::BenchmarkBase& benchmark, double max_position_m) {
+    Cube cube;
+    cube.trajectory = get_benchmark_random_trajectory(benchmark);
+    cube.trajectory.orientation.center_of_mass = get_benchmark_random_dvec3(benchmark, -max_position_m, max_position_m);
+    cube.side_length_m = benchmark.get_random_double(0.5, 1.5);
+    cube.mass_kg = benchmark.get_random_double(1, 10);
+    return cube;
+}
+BenchmarkWrapper(BENCHMARK_get_cube_cube_intersection_resolution,
+    // The cubes are placed close enough that roughly half of the pairs overlap
+    // The body states are made in the setup, the same way the world makes them once per step
+    std::vector<CubeBodyState> body_states;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            body_states.push_back(CubeBodyState::from_cube(get_benchmark_random_cube(*this, 0.7)));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(get_cube_cube_intersection_resolution(body_states[input_index], body_states[(input_index + 1) % 1024]));
+    }
+);
+BenchmarkWrapper(BENCHMARK_get_box_box_overlaps,
+    std::vector<OrientedBox> boxes;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            boxes.push_back(OrientedBox::from_cube(get_benchmark_random_cube(*this, 0.7)));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(get_box_box_overlaps(boxes[input_index], boxes[(input_index + 1) % 1024]));
+    }
+);
+BenchmarkWrapper(BENCHMARK_get_box_box_overlaps_packet,
+    // One box against the 8 boxes after it, compare with 8 times BENCHMARK_get_box_box_overlaps
+    std::vector<OrientedBox> boxes;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            boxes.push_back(OrientedBox::from_cube(get_benchmark_random_cube(*this, 0.7)));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        const OrientedBox* boxes2[8];
+        for(int i = 0; i < 8; i++) {
+            boxes2[i] = &boxes[(input_index + 1 + i) % 1024];
+        }
+        BoxBoxOverlaps overlaps[8];
+        get_box_box_overlaps_packet(boxes[input_index], boxes2, 8, overlaps);
+        vicmil::do_not_optimize(overlaps);
+    }
+);
+BenchmarkWrapper(BENCHMARK_handle_cube_plane_collision,
+    // Every cube goes into the ground, the cube is copied since the collision changes it
+    std::vector<Cube> cubes;
+    vicmil::Plane plane;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            cubes.push_back(get_benchmark_random_cube(*this, 0.3));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        Cube cube = cubes[input_index];
+        vicmil::do_not_optimize(handle_cube_plane_collision(cube, plane));
+    }
+);
+BenchmarkWrapper(BENCHMARK_CollisionImpulseResolver_get_impulse_magnitude,
+    std::vector<CollisionImpulseResolver> impulse_resolvers;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            Cube cube1 = get_benchmark_random_cube(*this, 1);
+            Cube cube2 = get_benchmark_random_cube(*this, 1);
+            CollisionImpulseResolver impulse_resolver;
+            impulse_resolver.obj1_trajectory = cube1.trajectory;
+            impulse_resolver.obj1_shape_property = cube1.get_shape_property();
+            impulse_resolver.obj2_trajectory = cube2.trajectory;
+            impulse_resolver.obj2_shape_property = cube2.get_shape_property();
+            impulse_resolver.contact_point.contact_position = get_benchmark_random_dvec3(*this, -1, 1);
+            impulse_resolver.contact_point.contact_normal = glm::normalize(get_benchmark_random_dvec3(*this, -1, 1));
+            impulse_resolvers.push_back(impulse_resolver);
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(impulse_resolvers[input_index].get_impulse_magnitude());
+    }
+);
@@ -54,4 +54,19 @@ ObjectEnergyInfo get_cube_energy_information(Cube& cube, double gravitation_cons
     energy_info.rotational_kin_energy = get_rotational_kinetic_energy_of_object(cube_shape_property, cube.trajectory.rotational_velocity);
     energy_info.linear_kin_energy = get_linear_kinetic_energy_of_object(cube.mass_kg, cube.trajectory.linear_velocity);
     return energy_info;
-}
\ No newline at end of file
+}
+BenchmarkWrapper(BENCHMARK_get_kinetic_energy_of_object,
+    std::vector<ObjectShapeProperty> shape_properties;
+    std::vector<ObjectTrajectory> trajectories;
+    int input_index = 0;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            shape_properties.push_back(ObjectShapeProperty::from_cube(get_random_double(0.5, 1.5), get_random_double(1, 10)));
+            trajectories.push_back(get_benchmark_random_trajectory(*this));
+        }
+    }
+    void run() {
+        input_index = (input_index + 1) % 1024;
+        vicmil::do_not_optimize(get_kinetic_energy_of_object(shape_properties[input_index], trajectories[input_index]));
+    }
+);
@@ -0,0 +1,388 @@
+/* Broad phase collision detection
+ * Quickly find which cubes might be colliding, so that the expensive narrow phase(SAT) only runs on those pairs
+*/
+#include "N6_energy.h"
+#include <algorithm>
+
+/**
+ * Two cubes that might be colliding, referred to by their index
+ * index1 is always larger than index2
+*/
+struct CollisionPair {
+    int index1;
+    int index2;
+    bool operator<(const CollisionPair& other) const {
+        if(index1 != other.index1) {
+            return index1 < other.index1;
+        }
+        return index2 < other.index2;
+    }
+    bool operator==(const CollisionPair& other) const {
+        return index1 == other.index1 && index2 == other.index2;
+    }
+};
+
+/**
+ * Find all pairs of cubes with overlapping bounding boxes, using sweep and prune
+ *  The boxes are sorted along one axis, and only boxes that overlap along that axis are compared
+ *  The sorted order is kept between updates, since the cubes only move a little each step the sorting is almost free
+ *  The axis is picked again every update, since e.g. falling cubes are spread out along y but a settled pile is flat
+*/
+class SweepAndPrune {
+    std::vector<AxisAlignedBoundingBox> _bounding_boxes;
+    std::vector<int> _sorted_indices;
+    int _sweep_axis = 0;
+    double _max_box_size_m = 0; // The largest box size along the sweep axis, from the last update
+
+    // Pick the axis where the cubes are most spread out, this axis separates the most cubes
+    //  The current axis is kept unless another axis is clearly better, so it does not switch back and forth
+    int _get_axis_with_largest_spread() {
+        glm::dvec3 sum = glm::dvec3(0, 0, 0);
+        glm::dvec3 sum2 = glm::dvec3(0, 0, 0);
+        for(int i = 0; i < _bounding_boxes.size(); i++) {
+            glm::dvec3 center = (_bounding_boxes[i].min + _bounding_boxes[i].max) * 0.5;
+            sum += center;
+            sum2 += center * center;
+        }
+        glm::dvec3 variance = sum2 - sum * sum / (double)_bounding_boxes.size();
+        int best_axis = 0;
+        if(variance.y > variance.x && variance.y >= variance.z) {
+            best_axis = 1;
+        }
+        if(variance.z > variance.x && variance.z > variance.y) {
+            best_axis = 2;
+        }
+        const double switch_factor = 1.2;
+        if(variance[best_axis] <= variance[_sweep_axis] * switch_factor) {
+            return _sweep_axis;
+        }
+        return best_axis;
+    }
+    void _insertion_sort_along_sweep_axis() {
+        for(int i = 1; i < _sorted_indices.size(); i++) {
+            int index = _sorted_indices[i];
+            double value = _bounding_boxes[index].min[_sweep_axis];
+            int j = i - 1;
+            while(j >= 0 && _bounding_boxes[_sorted_indices[j]].min[_sweep_axis] > value) {
+                _sorted_indices[j + 1] = _sorted_indices[j];
+                j--;
+            }
+            _sorted_indices[j + 1] = index;
+        }
+    }
+    void _find_pairs() {
+        // If the cubes or the sweep axis have changed, start over with a new sorting
+        int sweep_axis = _bounding_boxes.size() > 0 ? _get_axis_with_largest_spread() : _sweep_axis;
+        if(_sorted_indices.size() != _bounding_boxes.size() || sweep_axis != _sweep_axis) {
+            _sorted_indices.resize(_bounding_boxes.size());
+            for(int i = 0; i < _sorted_indices.size(); i++) {
+                _sorted_indices[i] = i;
+            }
+            _sweep_axis = sweep_axis;
+            std::sort(_sorted_indices.begin(), _sorted_indices.end(), [this](int a, int b) {
+                return _bounding_boxes[a].min[_sweep_axis] < _bounding_boxes[b].min[_sweep_axis];
+            });
+        }
+        _insertion_sort_along_sweep_axis();
+
+        // Sweep along the axis, and only compare boxes that overlap along it
+        pairs.clear();
+        _max_box_size_m = 0;
+        for(int i = 0; i < _sorted_indices.size(); i++) {
+            int index = _sorted_indices[i];
+            const AxisAlignedBoundingBox& box = _bounding_boxes[index];
+            _max_box_size_m = std::max(_max_box_size_m, box.max[_sweep_axis] - box.min[_sweep_axis]);
+            for(int j = i + 1; j < _sorted_indices.size(); j++) {
+                int other_index = _sorted_indices[j];
+                const AxisAlignedBoundingBox& other_box = _bounding_boxes[other_index];
+                if(other_box.min[_sweep_axis] > box.max[_sweep_axis]) {
+                    break; // All remaining boxes start after this box ends
+                }
+                if(box.overlaps(other_box)) {
+                    CollisionPair pair;
+                    pair.index1 = std::max(index, other_index);
+                    pair.index2 = std::min(index, other_index);
+                    pairs.push_back(pair);
+                }
+            }
+        }
+
+        // Sort the pairs, so that the collisions are always resolved in the same order
+        std::sort(pairs.begin(), pairs.end());
+    }
+public:
+    // The boxes are grown by this much, so cubes that are just about to touch are already paired
+    //  e.g. resting cubes that the solver pushes a little apart, this keeps their pair and its cached data
+    double margin_m = 0.01;
+    std::vector<CollisionPair> pairs; // The result of the last update, sorted by index1 and then index2
+
+    int get_sweep_axis() const {
+        return _sweep_axis;
+    }
+
+    /**
+     * Call function(index) for each cube whose bounding box from the last update overlaps the box
+     *  The boxes are sorted along the sweep axis, so only the ones that start close to the box are compared
+    */
+    template<class Function>
+    void for_each_overlapping_box(const AxisAlignedBoundingBox& box, Function function) const {
+        // No box is larger than _max_box_size_m, so the ones that start before this can not reach the box
+        double first_start = box.min[_sweep_axis] - _max_box_size_m;
+        auto first = std::lower_bound(_sorted_indices.begin(), _sorted_indices.end(), first_start, [this](int index, double start) {
+            return _bounding_boxes[index].min[_sweep_axis] < start;
+        });
+        for(auto it = first; it != _sorted_indices.end(); it++) {
+            const AxisAlignedBoundingBox& other_box = _bounding_boxes[*it];
+            if(other_box.min[_sweep_axis] > box.max[_sweep_axis]) {
+                break;
+            }
+            if(box.overlaps(other_box)) {
+                function(*it);
+            }
+        }
+    }
+
+    void update(const std::vector<Cube>& cubes) {
+        START_TRACE_FUNCTION();
+        _bounding_boxes.resize(cubes.size());
+        for(int i = 0; i < cubes.size(); i++) {
+            _bounding_boxes[i] = get_cube_bounding_box(cubes[i], margin_m);
+        }
+        _find_pairs();
+    }
+    // The same as update with the cubes, but the bounding boxes are taken from the body states
+    void update(const std::vector<CubeBodyState>& body_states) {
+        START_TRACE_FUNCTION();
+        _bounding_boxes.resize(body_states.size());
+        for(int i = 0; i < body_states.size(); i++) {
+            _bounding_boxes[i] = body_states[i].bounding_box.expanded(margin_m);
+        }
+        _find_pairs();
+    }
+};
+TestWrapper(TEST_SweepAndPrune_matches_all_pairs,
+    /** Sweep and prune should find exactly the same pairs as comparing all bounding boxes with each other
+    */
+    void test() {
+        srand(1);
+        std::vector<Cube> cubes;
+        cubes.resize(200);
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(rand()%1000, rand()%1000, rand()%1000) / 100.0;
+            cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+        }
+        SweepAndPrune sweep_and_prune;
+        for(int update = 0; update < 2; update++) {
+            std::vector<CollisionPair> expected_pairs;
+            for(int i = 0; i < cubes.size(); i++) {
+                for(int i2 = 0; i2 < i; i2++) {
+                    if(get_cube_bounding_box(cubes[i], sweep_and_prune.margin_m).overlaps(get_cube_bounding_box(cubes[i2], sweep_and_prune.margin_m))) {
+                        CollisionPair pair;
+                        pair.index1 = i;
+                        pair.index2 = i2;
+                        expected_pairs.push_back(pair);
+                    }
+                }
+            }
+            sweep_and_prune.update(cubes);
+            Assert(expected_pairs.size() > 0);
+            Assert(sweep_and_prune.pairs == expected_pairs);
+
+            // Move the cubes a bit and make sure it still works when the old sorting is reused
+            for(int i = 0; i < cubes.size(); i++) {
+                cubes[i].trajectory.orientation.center_of_mass.x += (rand()%100) / 100.0;
+            }
+        }
+
+        // A tall column of cubes is swept along y, once they have settled into a flat layer another axis is used
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i].trajectory.orientation.center_of_mass = glm::dvec3((rand()%100) / 100.0, i * 2.0, (rand()%100) / 100.0);
+        }
+        sweep_and_prune.update(cubes);
+        Assert(sweep_and_prune.get_sweep_axis() == 1);
+        Assert(sweep_and_prune.pairs.size() == 0);
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i].trajectory.orientation.center_of_mass = glm::dvec3((i % 20) * 1.0, 0.5, (i / 20) * 1.0);
+        }
+        sweep_and_prune.update(cubes);
+        Assert(sweep_and_prune.get_sweep_axis() != 1);
+        int expected_pair_count = 0;
+        for(int i = 0; i < cubes.size(); i++) {
+            for(int i2 = 0; i2 < i; i2++) {
+                expected_pair_count += get_cube_bounding_box(cubes[i], sweep_and_prune.margin_m).overlaps(get_cube_bounding_box(cubes[i2], sweep_and_prune.margin_m));
+            }
+        }
+        Assert(expected_pair_count > 0);
+        Assert(sweep_and_prune.pairs.size() == expected_pair_count);
+
+        // Looking up the boxes around a point should find the same boxes as comparing with all of them
+        AxisAlignedBoundingBox query_box;
+        query_box.min = glm::dvec3(4.2, 0, 2.3);
+        query_box.max = glm::dvec3(7.9, 1, 3.1);
+        std::vector<int> found_indices;
+        sweep_and_prune.for_each_overlapping_box(query_box, [&](int index) {
+            found_indices.push_back(index);
+        });
+        std::sort(found_indices.begin(), found_indices.end());
+        std::vector<int> expected_indices;
+        for(int i = 0; i < cubes.size(); i++) {
+            if(get_cube_bounding_box(cubes[i], sweep_and_prune.margin_m).overlaps(query_box)) {
+                expected_indices.push_back(i);
+            }
+        }
+        Assert(expected_indices.size() > 0);
+        Assert(found_indices == expected_indices);
+    }
+);
+
+/**
+ * Keeps the pairs from the broad phase between updates, together with some data for each pair
+ *  The data lives as long as the broad phase keeps finding the pair, e.g. a contact cache or material info
+ *  Each update reports which pairs were added and removed since the last update
+ *
+ * The broad phase finds all its pairs again every update, sorted. The old and the new pairs are then matched
+ * in one pass like a merge, the same way as the separating axis cache did before, so there is no hashing and no
+ * search for removed pairs. Events from the sweep and prune sorting were not used, since it only sorts along one
+ * axis and boxes can stop overlapping along the other axes without any swap, see BENCHMARK_PairManager_update
+*/
+template<class PairData>
+class PairManager {
+    std::vector<PairData> _data; // One for each of pairs
+    std::vector<PairData> _new_data; // Reused between updates, so no memory is allocated once it is large enough
+    void _add_removed_pair(int old_index) {
+        RemovedPair removed_pair;
+        removed_pair.pair = pairs[old_index];
+        removed_pair.data = _data[old_index];
+        removed_pairs.push_back(removed_pair);
+    }
+public:
+    struct RemovedPair {
+        CollisionPair pair;
+        PairData data; // The data as it was when the pair was removed
+    };
+    std::vector<CollisionPair> pairs; // The pairs from the last update, in the same order
+    std::vector<CollisionPair> added_pairs; // The pairs that were not in the update before, in the same order as pairs
+    std::vector<RemovedPair> removed_pairs; // The pairs that were in the update before but not in the last one, sorted
+
+    /**
+     * @param new_pairs All the pairs that are overlapping now, each pair only once and sorted, e.g. SweepAndPrune::pairs
+    */
+    void update(const std::vector<CollisionPair>& new_pairs) {
+        START_TRACE_FUNCTION();
+        added_pairs.clear();
+        removed_pairs.clear();
+        _new_data.resize(new_pairs.size());
+        int old_index = 0;
+        for(int i = 0; i < new_pairs.size(); i++) {
+            while(old_index < pairs.size() && pairs[old_index] < new_pairs[i]) {
+                _add_removed_pair(old_index); // The broad phase dropped this pair
+                old_index++;
+            }
+            if(old_index < pairs.size() && pairs[old_index] == new_pairs[i]) {
+                _new_data[i] = _data[old_index];
+                old_index++;
+            }
+            else {
+                _new_data[i] = PairData();
+                added_pairs.push_back(new_pairs[i]);
+            }
+        }
+        for(; old_index < pairs.size(); old_index++) {
+            _add_removed_pair(old_index);
+        }
+        _data.swap(_new_data);
+        pairs = new_pairs;
+    }
+
+    // Get the data of pairs[pair_index], different pairs can be used from different threads at the same time
+    inline PairData& get_pair_data(int pair_index) {
+        return _data[pair_index];
+    }
+    // @return nullptr if the pair was not in the last update
+    PairData* find_pair_data(const CollisionPair& pair) {
+        auto found = std::lower_bound(pairs.begin(), pairs.end(), pair);
+        if(found == pairs.end() || !(*found == pair)) {
+            return nullptr;
+        }
+        return &_data[found - pairs.begin()];
+    }
+    // Forget all pairs, the next update reports all its pairs as added
+    void clear() {
+        _data.clear();
+        pairs.clear();
+        added_pairs.clear();
+        removed_pairs.clear();
+    }
+};
+TestWrapper(TEST_PairManager_update,
+    void test() {
+        auto make_pair = [](int index1, int index2) {
+            CollisionPair pair;
+            pair.index1 = index1;
+            pair.index2 = index2;
+            return pair;
+        };
+        PairManager<int> pair_manager;
+        std::vector<CollisionPair> pairs = std::vector<CollisionPair>({make_pair(1, 0), make_pair(2, 0), make_pair(3, 1)});
+        pair_manager.update(pairs);
+        Assert(pair_manager.added_pairs == pairs);
+        Assert(pair_manager.removed_pairs.size() == 0);
+        for(int i = 0; i < pairs.size(); i++) {
+            Assert(pair_manager.get_pair_data(i) == 0);
+            pair_manager.get_pair_data(i) = 10 + i;
+        }
+
+        // (2, 0) is removed and (2, 1) is added, the other pairs keep their data
+        pairs = std::vector<CollisionPair>({make_pair(1, 0), make_pair(2, 1), make_pair(3, 1)});
+        pair_manager.update(pairs);
+        Assert(pair_manager.added_pairs.size() == 1 && pair_manager.added_pairs[0] == make_pair(2, 1));
+        Assert(pair_manager.removed_pairs.size() == 1 && pair_manager.removed_pairs[0].pair == make_pair(2, 0));
+        Assert(pair_manager.removed_pairs[0].data == 11);
+        Assert(pair_manager.get_pair_data(0) == 10);
+        Assert(pair_manager.get_pair_data(1) == 0);
+        Assert(pair_manager.get_pair_data(2) == 12);
+        Assert(*pair_manager.find_pair_data(make_pair(3, 1)) == 12);
+        Assert(pair_manager.find_pair_data(make_pair(2, 0)) == nullptr);
+
+        // Nothing changed
+        pair_manager.update(pairs);
+        Assert(pair_manager.added_pairs.size() == 0 && pair_manager.removed_pairs.size() == 0);
+
+        // A removed pair comes back without its old data
+        pairs = std::vector<CollisionPair>({make_pair(2, 0)});
+        pair_manager.update(pairs);
+        Assert(pair_manager.get_pair_data(0) == 0);
+        Assert(pair_manager.removed_pairs.size() == 3);
+        Assert(pair_manager.removed_pairs[0].pair == make_pair(1, 0) && pair_manager.removed_pairs[2].pair == make_pair(3, 1));
+    }
+);
+BenchmarkWrapper(BENCHMARK_PairManager_update,
+    // 6000 pairs between 2000 cubes, about 2% of the pairs are swapped for other pairs every update
+    std::vector<CollisionPair> pairs1;
+    std::vector<CollisionPair> pairs2;
+    PairManager<CachedSeparatingAxis> pair_manager;
+    bool use_pairs1 = true;
+    void setup() {
+        for(int index1 = 1; index1 < 2000; index1++) {
+            for(int k = 0; k < 3; k++) {
+                CollisionPair pair;
+                pair.index1 = index1;
+                pair.index2 = std::max(index1 - 1 - k * 7, 0);
+                pairs1.push_back(pair);
+                if(get_random_double(0, 1) < 0.02) {
+                    pair.index2 = std::max(index1 - 2 - k * 7, 0);
+                }
+                pairs2.push_back(pair);
+            }
+        }
+        std::sort(pairs1.begin(), pairs1.end());
+        pairs1.erase(std::unique(pairs1.begin(), pairs1.end()), pairs1.end());
+        std::sort(pairs2.begin(), pairs2.end());
+        pairs2.erase(std::unique(pairs2.begin(), pairs2.end()), pairs2.end());
+    }
+    void run() {
+        use_pairs1 = !use_pairs1;
+        pair_manager.update(use_pairs1 ? pairs1 : pairs2);
+        vicmil::do_not_optimize(pair_manager.get_pair_data(0));
+    }
+);
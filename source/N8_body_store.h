@@ -0,0 +1,448 @@
+/* Structure of arrays storage of rigid bodies
+ * Each property of the bodies is stored in its own contiguous array. Integrating many bodies then
+ * just streams through memory, and the compiler is able to vectorize the loops
+ * The World fills a store from its cubes at the start of each step, and applies gravity and moves the cubes in it
+*/
+#include "N7_broad_phase.h"
+#include <cstring>
+
+class RigidBodyStore {
+public:
+    std::vector<double> position_x;
+    std::vector<double> position_y;
+    std::vector<double> position_z;
+
+    // The rotational orientation as a quaternion
+    std::vector<double> orientation_w;
+    std::vector<double> orientation_x;
+    std::vector<double> orientation_y;
+    std::vector<double> orientation_z;
+
+    std::vector<double> linear_velocity_x;
+    std::vector<double> linear_velocity_y;
+    std::vector<double> linear_velocity_z;
+
+    // The direction is the rotation axis, the length is the rotation speed in rad/s
+    std::vector<double> angular_velocity_x;
+    std::vector<double> angular_velocity_y;
+    std::vector<double> angular_velocity_z;
+
+    std::vector<double> inverse_mass_kg;
+    std::vector<double> side_length_m;
+
+    inline int size() const {
+        return inverse_mass_kg.size();
+    }
+    void resize(int body_count) {
+        position_x.resize(body_count);
+        position_y.resize(body_count);
+        position_z.resize(body_count);
+        orientation_w.resize(body_count);
+        orientation_x.resize(body_count);
+        orientation_y.resize(body_count);
+        orientation_z.resize(body_count);
+        linear_velocity_x.resize(body_count);
+        linear_velocity_y.resize(body_count);
+        linear_velocity_z.resize(body_count);
+        angular_velocity_x.resize(body_count);
+        angular_velocity_y.resize(body_count);
+        angular_velocity_z.resize(body_count);
+        inverse_mass_kg.resize(body_count);
+        side_length_m.resize(body_count);
+    }
+    void set_cube(int index, const Cube& cube) {
+        set_trajectory(index, cube.trajectory);
+        inverse_mass_kg[index] = 1.0 / cube.mass_kg;
+        side_length_m[index] = cube.side_length_m;
+    }
+    void set_trajectory(int index, const ObjectTrajectory& trajectory) {
+        position_x[index] = trajectory.orientation.center_of_mass.x;
+        position_y[index] = trajectory.orientation.center_of_mass.y;
+        position_z[index] = trajectory.orientation.center_of_mass.z;
+        orientation_w[index] = trajectory.orientation.rotational_orientation.quaternion.w;
+        orientation_x[index] = trajectory.orientation.rotational_orientation.quaternion.x;
+        orientation_y[index] = trajectory.orientation.rotational_orientation.quaternion.y;
+        orientation_z[index] = trajectory.orientation.rotational_orientation.quaternion.z;
+        set_velocities(index, trajectory);
+    }
+    void set_velocities(int index, const ObjectTrajectory& trajectory) {
+        linear_velocity_x[index] = trajectory.linear_velocity.speed_m_per_s.x;
+        linear_velocity_y[index] = trajectory.linear_velocity.speed_m_per_s.y;
+        linear_velocity_z[index] = trajectory.linear_velocity.speed_m_per_s.z;
+        angular_velocity_x[index] = trajectory.rotational_velocity.rotation.x;
+        angular_velocity_y[index] = trajectory.rotational_velocity.rotation.y;
+        angular_velocity_z[index] = trajectory.rotational_velocity.rotation.z;
+    }
+    // Only the linear velocity, which is all that apply_acceleration_batch changes
+    void get_linear_velocity(int index, LinearVelocity& linear_velocity) const {
+        linear_velocity.speed_m_per_s = glm::dvec3(linear_velocity_x[index], linear_velocity_y[index], linear_velocity_z[index]);
+    }
+    // Only the position and rotation, which is all that move_time_step_s_batch changes
+    void get_orientation(int index, ObjectOrientation& orientation) const {
+        orientation.center_of_mass = glm::dvec3(position_x[index], position_y[index], position_z[index]);
+        orientation.rotational_orientation.quaternion =
+            glm::dquat(orientation_w[index], orientation_x[index], orientation_y[index], orientation_z[index]);
+    }
+    Cube get_cube(int index) const {
+        Cube cube = Cube();
+        ObjectTrajectory& trajectory = cube.trajectory;
+        trajectory.orientation.center_of_mass = glm::dvec3(position_x[index], position_y[index], position_z[index]);
+        trajectory.orientation.rotational_orientation.quaternion =
+            glm::dquat(orientation_w[index], orientation_x[index], orientation_y[index], orientation_z[index]);
+        trajectory.linear_velocity.speed_m_per_s = glm::dvec3(linear_velocity_x[index], linear_velocity_y[index], linear_velocity_z[index]);
+        trajectory.rotational_velocity.rotation = glm::dvec3(angular_velocity_x[index], angular_velocity_y[index], angular_velocity_z[index]);
+        cube.mass_kg = 1.0 / inverse_mass_kg[index];
+        cube.side_length_m = side_length_m[index];
+        return cube;
+    }
+    static RigidBodyStore from_cubes(const std::vector<Cube>& cubes) {
+        RigidBodyStore store;
+        store.resize(cubes.size());
+        for(int i = 0; i < cubes.size(); i++) {
+            store.set_cube(i, cubes[i]);
+        }
+        return store;
+    }
+    std::vector<Cube> to_cubes() const {
+        std::vector<Cube> cubes;
+        cubes.resize(size());
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i] = get_cube(i);
+        }
+        return cubes;
+    }
+};
+
+/**
+ * Rotate one body in the store according to its angular velocity
+ *  The same as Rotation::from_scaled_axis followed by Rotation::rotate and normalization
+*/
+inline void integrate_orientation(int i, double time_step_s, RigidBodyStore& store) {
+    double w_x = store.angular_velocity_x[i];
+    double w_y = store.angular_velocity_y[i];
+    double w_z = store.angular_velocity_z[i];
+    double w_length = std::sqrt(w_x * w_x + w_y * w_y + w_z * w_z);
+    if(w_length == 0) {
+        return; // No rotation
+    }
+    double half_radians = w_length * time_step_s / 2;
+    double d_w = std::cos(half_radians);
+    double sin_scale = std::sin(half_radians) / w_length;
+    double d_x = w_x * sin_scale;
+    double d_y = w_y * sin_scale;
+    double d_z = w_z * sin_scale;
+
+    // new orientation = d_rotation * orientation
+    double q_w = store.orientation_w[i];
+    double q_x = store.orientation_x[i];
+    double q_y = store.orientation_y[i];
+    double q_z = store.orientation_z[i];
+    double n_w = d_w * q_w - d_x * q_x - d_y * q_y - d_z * q_z;
+    double n_x = d_w * q_x + d_x * q_w + d_y * q_z - d_z * q_y;
+    double n_y = d_w * q_y - d_x * q_z + d_y * q_w + d_z * q_x;
+    double n_z = d_w * q_z + d_x * q_y - d_y * q_x + d_z * q_w;
+
+    double inv_length = 1.0 / std::sqrt(n_w * n_w + n_x * n_x + n_y * n_y + n_z * n_z);
+    store.orientation_w[i] = n_w * inv_length;
+    store.orientation_x[i] = n_x * inv_length;
+    store.orientation_y[i] = n_y * inv_length;
+    store.orientation_z[i] = n_z * inv_length;
+}
+
+// Below this rotation per step, cos and sin are approximated by polynomials
+// The error of the approximation is then less than 1e-16
+const double SMALL_ANGLE_MAX_HALF_RADIANS = 0.1;
+
+// The quaternions are normalized with 1/sqrt(x) ~ (3 - x)/2, which is exact to rounding when x is this close to 1
+const double NORMALIZE_MAX_LENGTH2_ERROR = 1e-8;
+
+/**
+ * Rotate all bodies in the store according to their angular velocity, four bodies at a time
+ *  For small rotations cos and sin are replaced by their taylor polynomials, which can be calculated 
+ *  for all four bodies at once. Only the bodies that rotate too fast calculate cos and sin one at a time
+ * @param time_steps_s How long to rotate each body, one value for each body in the store
+*/
+void integrate_orientations_batch(const double* time_steps_s, RigidBodyStore& store) {
+    const int body_count = store.size();
+    const double max_half_radians2 = SMALL_ANGLE_MAX_HALF_RADIANS * SMALL_ANGLE_MAX_HALF_RADIANS;
+    int i = 0;
+    for(; i + 4 <= body_count; i += 4) {
+        simd_double4 time_step_s;
+        std::memcpy(&time_step_s, &time_steps_s[i], sizeof(time_step_s));
+        simd_double4 half_time_step = time_step_s * 0.5;
+        simd_double4 w_x;
+        std::memcpy(&w_x, &store.angular_velocity_x[i], sizeof(w_x));
+        simd_double4 w_y;
+        std::memcpy(&w_y, &store.angular_velocity_y[i], sizeof(w_y));
+        simd_double4 w_z;
+        std::memcpy(&w_z, &store.angular_velocity_z[i], sizeof(w_z));
+        simd_double4 w_length2 = w_x * w_x + w_y * w_y + w_z * w_z;
+        simd_double4 h2 = w_length2 * half_time_step * half_time_step; // The half angle squared
+
+        // cos(h) = 1 - h^2/2! + h^4/4! - h^6/6! + h^8/8!
+        simd_double4 d_w = 1.0 + h2 * (-1.0/2 + h2 * (1.0/24 + h2 * (-1.0/720 + h2 * (1.0/40320))));
+        // sin(h)/|w| = t/2 * sin(h)/h = t/2 * (1 - h^2/3! + h^4/5! - h^6/7! + h^8/9!)
+        simd_double4 sin_scale = half_time_step * (1.0 + h2 * (-1.0/6 + h2 * (1.0/120 + h2 * (-1.0/5040 + h2 * (1.0/362880)))));
+        simd_int64x4 large_angles = (simd_int64x4)(h2 >= max_half_radians2);
+        if(large_angles[0] | large_angles[1] | large_angles[2] | large_angles[3]) {
+            for(int lane = 0; lane < 4; lane++) {
+                if(large_angles[lane]) { // Too large for the polynomials, w_length is never 0 here
+                    double w_length = std::sqrt(w_length2[lane]);
+                    double half_radians = w_length * half_time_step[lane];
+                    d_w[lane] = std::cos(half_radians);
+                    sin_scale[lane] = std::sin(half_radians) / w_length;
+                }
+            }
+        }
+        simd_double4 d_x = w_x * sin_scale;
+        simd_double4 d_y = w_y * sin_scale;
+        simd_double4 d_z = w_z * sin_scale;
+
+        // new orientation = d_rotation * orientation
+        simd_double4 q_w;
+        std::memcpy(&q_w, &store.orientation_w[i], sizeof(q_w));
+        simd_double4 q_x;
+        std::memcpy(&q_x, &store.orientation_x[i], sizeof(q_x));
+        simd_double4 q_y;
+        std::memcpy(&q_y, &store.orientation_y[i], sizeof(q_y));
+        simd_double4 q_z;
+        std::memcpy(&q_z, &store.orientation_z[i], sizeof(q_z));
+        simd_double4 n_w = d_w * q_w - d_x * q_x - d_y * q_y - d_z * q_z;
+        simd_double4 n_x = d_w * q_x + d_x * q_w + d_y * q_z - d_z * q_y;
+        simd_double4 n_y = d_w * q_y - d_x * q_z + d_y * q_w + d_z * q_x;
+        simd_double4 n_z = d_w * q_z + d_x * q_y - d_y * q_x + d_z * q_w;
+
+        // Both quaternions have length 1, so only rounding errors have to be removed
+        simd_double4 length2 = n_w * n_w + n_x * n_x + n_y * n_y + n_z * n_z;
+        simd_double4 inv_length = (3.0 - length2) * 0.5;
+        simd_double4 length2_error = length2 - 1.0;
+        simd_abs(length2_error);
+        simd_int64x4 far_from_1 = (simd_int64x4)(length2_error > NORMALIZE_MAX_LENGTH2_ERROR);
+        if(far_from_1[0] | far_from_1[1] | far_from_1[2] | far_from_1[3]) {
+            for(int lane = 0; lane < 4; lane++) {
+                if(far_from_1[lane]) { // e.g. an orientation that was set from outside without normalizing it
+                    inv_length[lane] = 1.0 / std::sqrt(length2[lane]);
+                }
+            }
+        }
+        n_w = n_w * inv_length;
+        n_x = n_x * inv_length;
+        n_y = n_y * inv_length;
+        n_z = n_z * inv_length;
+        std::memcpy(&store.orientation_w[i], &n_w, sizeof(n_w));
+        std::memcpy(&store.orientation_x[i], &n_x, sizeof(n_x));
+        std::memcpy(&store.orientation_y[i], &n_y, sizeof(n_y));
+        std::memcpy(&store.orientation_z[i], &n_z, sizeof(n_z));
+    }
+
+    // The remaining bodies that do not fill a group of four
+    for(; i < body_count; i++) {
+        integrate_orientation(i, time_steps_s[i], store);
+    }
+}
+
+/**
+ * Batched version of apply_acceleration, applies the same acceleration to all bodies in the store
+*/
+void apply_acceleration_batch(glm::dvec3 acceleration_m_per_s2, double time_s, RigidBodyStore& store) {
+    const int body_count = store.size();
+    const glm::dvec3 d_velocity = acceleration_m_per_s2 * time_s;
+    double* __restrict velocity_x = store.linear_velocity_x.data();
+    double* __restrict velocity_y = store.linear_velocity_y.data();
+    double* __restrict velocity_z = store.linear_velocity_z.data();
+    for(int i = 0; i < body_count; i++) {
+        velocity_x[i] += d_velocity.x;
+        velocity_y[i] += d_velocity.y;
+        velocity_z[i] += d_velocity.z;
+    }
+}
+
+/**
+ * Batched version of ObjectTrajectory::move_time_step_s, moves all bodies in the store according to their velocities
+ * @param time_steps_s How long to move each body, one value for each body in the store
+*/
+void move_time_step_s_batch(const double* time_steps_s, RigidBodyStore& store) {
+    const int body_count = store.size();
+
+    // Update position
+    {
+        double* __restrict position_x = store.position_x.data();
+        double* __restrict position_y = store.position_y.data();
+        double* __restrict position_z = store.position_z.data();
+        const double* __restrict velocity_x = store.linear_velocity_x.data();
+        const double* __restrict velocity_y = store.linear_velocity_y.data();
+        const double* __restrict velocity_z = store.linear_velocity_z.data();
+        for(int i = 0; i < body_count; i++) {
+            position_x[i] += velocity_x[i] * time_steps_s[i];
+            position_y[i] += velocity_y[i] * time_steps_s[i];
+            position_z[i] += velocity_z[i] * time_steps_s[i];
+        }
+    }
+
+    // Update rotation
+    integrate_orientations_batch(time_steps_s, store);
+}
+
+/**
+ * Batched version of get_kinetic_energy_of_object for all cubes in the store
+ *  The inertia of a cube is m*s^2/6 around every axis, so the rotational energy does not depend on its orientation
+*/
+void get_kinetic_energies_batch(const RigidBodyStore& store, double* kinetic_energies_j) {
+    const int body_count = store.size();
+    for(int i = 0; i < body_count; i++) {
+        double mass_kg = 1.0 / store.inverse_mass_kg[i];
+        double inertia = mass_kg * store.side_length_m[i] * store.side_length_m[i] / 6;
+        double v_x = store.linear_velocity_x[i];
+        double v_y = store.linear_velocity_y[i];
+        double v_z = store.linear_velocity_z[i];
+        double w_x = store.angular_velocity_x[i];
+        double w_y = store.angular_velocity_y[i];
+        double w_z = store.angular_velocity_z[i];
+        kinetic_energies_j[i] = (mass_kg * (v_x * v_x + v_y * v_y + v_z * v_z) + inertia * (w_x * w_x + w_y * w_y + w_z * w_z)) / 2;
+    }
+}
+TestWrapper(TEST_RigidBodyStore_batch_integration,
+    /** The batched integration should give the same result as integrating each cube by itself
+     *  Every cube gets its own time step, some are not moved at all like sleeping cubes in the World
+    */
+    void test() {
+        srand(3);
+        std::vector<Cube> cubes;
+        cubes.resize(50);
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i].mass_kg = 1 + rand()%10;
+            cubes[i].trajectory.orientation.center_of_mass = glm::dvec3(rand()%100, rand()%100, rand()%100) / 10.0;
+            cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            cubes[i].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(rand()%100 - 50, rand()%100 - 50, rand()%100 - 50) / 10.0;
+            if(i % 5 != 0) { // Leave some cubes without rotation
+                cubes[i].trajectory.rotational_velocity.rotation = glm::dvec3(rand()%100 - 50, rand()%100 - 50, rand()%100 - 50) / 10.0;
+            }
+        }
+        std::vector<double> time_steps_s;
+        for(int i = 0; i < cubes.size(); i++) {
+            time_steps_s.push_back(0.005 * (i % 3));
+        }
+        RigidBodyStore store = RigidBodyStore::from_cubes(cubes);
+        glm::dvec3 gravity = glm::dvec3(0, -9.8, 0);
+        for(int step = 0; step < 10; step++) {
+            apply_acceleration_batch(gravity, 0.01, store);
+            move_time_step_s_batch(time_steps_s.data(), store);
+            for(int i = 0; i < cubes.size(); i++) {
+                apply_acceleration(gravity, 0.01, cubes[i].trajectory);
+                cubes[i].trajectory.move_time_step_s(time_steps_s[i]);
+            }
+        }
+        std::vector<Cube> store_cubes = store.to_cubes();
+        for(int i = 0; i < cubes.size(); i++) {
+            const ObjectTrajectory& expected = cubes[i].trajectory;
+            const ObjectTrajectory& result = store_cubes[i].trajectory;
+            Assert(glm::length(expected.orientation.center_of_mass - result.orientation.center_of_mass) < 0.000001);
+            Assert(glm::length(expected.linear_velocity.speed_m_per_s - result.linear_velocity.speed_m_per_s) < 0.000001);
+            Assert(glm::length(expected.orientation.rotational_orientation.quaternion - result.orientation.rotational_orientation.quaternion) < 0.000001);
+            Assert(abs(store_cubes[i].mass_kg - cubes[i].mass_kg) < 0.000001);
+        }
+
+        std::vector<double> kinetic_energies_j = std::vector<double>(cubes.size());
+        get_kinetic_energies_batch(store, kinetic_energies_j.data());
+        for(int i = 0; i < cubes.size(); i++) {
+            double expected_j = get_kinetic_energy_of_object(cubes[i].get_shape_property(), cubes[i].trajectory);
+            Assert(abs(kinetic_energies_j[i] - expected_j) < 0.000001 * (1 + expected_j));
+        }
+    }
+);
+TestWrapper(TEST_integrate_orientations_batch,
+    /** The polynomial approximation used for small rotations should stay close to the Rotation class
+    */
+    void test() {
+        srand(4);
+        std::vector<Cube> cubes;
+        cubes.resize(103);
+        for(int i = 0; i < cubes.size(); i++) {
+            cubes[i].trajectory.orientation.rotational_orientation = Rotation::from_scaled_axis(glm::dvec3(rand()%100, rand()%100, rand()%100) / 30.0);
+            // Mix slow and fast rotation, so that both the polynomial and the sin/cos path are used
+            double max_speed = (i < 60) ? 10.0 : 100.0;
+            cubes[i].trajectory.rotational_velocity.rotation = glm::dvec3(rand()%200 - 100, rand()%200 - 100, rand()%200 - 100) / 100.0 * max_speed;
+        }
+        std::vector<double> time_steps_s = std::vector<double>(cubes.size(), 0.01);
+        RigidBodyStore store = RigidBodyStore::from_cubes(cubes);
+        for(int step = 0; step < 100; step++) {
+            integrate_orientations_batch(time_steps_s.data(), store);
+            for(int i = 0; i < cubes.size(); i++) {
+                cubes[i].trajectory.move_time_step_s(0.01);
+            }
+        }
+        for(int i = 0; i < cubes.size(); i++) {
+            glm::dquat expected = cubes[i].trajectory.orientation.rotational_orientation.quaternion;
+            glm::dquat result = glm::dquat(store.orientation_w[i], store.orientation_x[i], store.orientation_y[i], store.orientation_z[i]);
+            Assert(glm::length(expected - result) < 1e-10);
+            Assert(abs(glm::length(result) - 1) < 1e-12);
+        }
+    }
+);
+BenchmarkWrapper(BENCHMARK_move_time_step_s_batch,
+    // All 1024 cubes each run, including copying them into the store
+    // Compare with 1024 times BENCHMARK_ObjectTrajectory_move_time_step_s
+    std::vector<Cube> cubes;
+    std::vector<double> forward_time_steps_s;
+    std::vector<double> backward_time_steps_s;
+    RigidBodyStore store;
+    void setup() {
+        for(int i = 0; i < 1024; i++) {
+            Cube cube = Cube();
+            cube.trajectory = get_benchmark_random_trajectory(*this);
+            cubes.push_back(cube);
+        }
+        forward_time_steps_s = std::vector<double>(1024, 1.0 / 30);
+        backward_time_steps_s = std::vector<double>(1024, -1.0 / 30);
+        store.resize(1024);
+    }
+    void run() {
+        for(int i = 0; i < 1024; i++) {
+            store.set_cube(i, cubes[i]);
+        }
+        // Moving forward and back keeps the cubes from drifting away during the benchmark
+        move_time_step_s_batch(forward_time_steps_s.data(), store);
+        move_time_step_s_batch(backward_time_steps_s.data(), store);
+        for(int i = 0; i < 1024; i++) {
+            store.get_orientation(i, cubes[i].trajectory.orientation);
+        }
+        vicmil::do_not_optimize(cubes[0]);
+    }
+);
+BenchmarkWrapper(BENCHMARK_integrate_orientations_batch,
+    // Only the orientation kernel, all 1024 cubes each run, compare with BENCHMARK_integrate_orientation
+    RigidBodyStore store;
+    std::vector<double> forward_time_steps_s;
+    std::vector<double> backward_time_steps_s;
+    void setup() {
+        store.resize(1024);
+        for(int i = 0; i < 1024; i++) {
+            store.set_trajectory(i, get_benchmark_random_trajectory(*this));
+        }
+        forward_time_steps_s = std::vector<double>(1024, 1.0 / 30);
+        backward_time_steps_s = std::vector<double>(1024, -1.0 / 30);
+    }
+    void run() {
+        // Rotating forward and back keeps the orientations from drifting away during the benchmark
+        integrate_orientations_batch(forward_time_steps_s.data(), store);
+        integrate_orientations_batch(backward_time_steps_s.data(), store);
+        vicmil::do_not_optimize(store.orientation_w[0]);
+    }
+);
+BenchmarkWrapper(BENCHMARK_integrate_orientation,
+    // The same as BENCHMARK_integrate_orientations_batch, but one cube at a time with sin and cos
+    RigidBodyStore store;
+    void setup() {
+        store.resize(1024);
+        for(int i = 0; i < 1024; i++) {
+            store.set_trajectory(i, get_benchmark_random_trajectory(*this));
+        }
+    }
+    void run() {
+        for(int i = 0; i < 1024; i++) {
+            integrate_orientation(i, 1.0 / 30, store);
+            integrate_orientation(i, -1.0 / 30, store);
+        }
+        vicmil::do_not_optimize(store.orientation_w[0]);
+    }
+);
\ No newline at end of file
@@ -0,0 +1,340 @@
+/* Sequential impulse contact solver
+ * All contacts of a step are gathered first, then the solver goes through them several times and adjusts
+ * the impulse at each contact a little at a time. The total impulse at each contact is remembered to
+ * the next step, so a resting contact starts out with the impulse it needed last time(warm starting)
+ * Overlapping objects are pushed apart with split impulses: the push is solved the same way, but on separate
+ * push velocities that only move the objects this step, so removing an overlap never adds kinetic energy
+*/
+#include "N8_body_store.h"
+#include <unordered_map>
+
+/**
+ * A contact point between two objects that the solver should resolve
+*/
+struct SolverContact {
+    int body1 = 0;
+    int body2 = -1; // Negative for objects that cannot move, e.g. -1 - plane_index for planes
+    int feature_id = 0; // Which features of the bodies are touching, see IntersectionResolution::feature_id
+    glm::dvec3 position = glm::dvec3(0, 0, 0);
+    glm::dvec3 normal = glm::dvec3(0, 1, 0); // The direction to push body1, body2 is pushed in the opposite direction
+    double penetration_depth_m = 0;
+    double restitution_constant = 0.8;
+
+    // The total impulse applied along the normal this step, it can never be negative(the objects can only be pushed apart)
+    double accumulated_impulse_newton_s = 0;
+    double accumulated_push_impulse_newton_s = 0; // The same for the push velocities
+
+    // Calculated by the solver before the iterations start
+    glm::dvec3 _r1; // Contact position relative to the center of body1
+    glm::dvec3 _r2;
+    glm::dvec3 _angular_change1; // Change in rotational velocity of body1 per unit of impulse
+    glm::dvec3 _angular_change2;
+    double _inverse_mass1;
+    double _inverse_mass2;
+    double _effective_mass; // How much impulse it takes to change the closing velocity by 1 m/s
+    double _target_velocity_m_s; // How fast the bodies should separate at the contact point
+    double _push_target_velocity_m_s; // How fast the push velocities should separate them, to remove the overlap
+};
+
+/**
+ * Identifies the same contact between two steps
+*/
+struct ContactKey {
+    int body1;
+    int body2;
+    int feature_id;
+    bool operator==(const ContactKey& other) const {
+        return body1 == other.body1 && body2 == other.body2 && feature_id == other.feature_id;
+    }
+    static ContactKey from_contact(const SolverContact& contact) {
+        ContactKey key;
+        key.body1 = contact.body1;
+        key.body2 = contact.body2;
+        key.feature_id = contact.feature_id;
+        return key;
+    }
+};
+struct ContactKeyHash {
+    size_t operator()(const ContactKey& key) const {
+        size_t hash = std::hash<int>()(key.body1);
+        hash = hash * 31 + std::hash<int>()(key.body2);
+        hash = hash * 31 + std::hash<int>()(key.feature_id);
+        return hash;
+    }
+};
+
+class ContactSolver {
+    std::unordered_map<ContactKey, double, ContactKeyHash> _impulse_cache; // The accumulated impulses from the last step
+    std::vector<CubeBodyState> _body_states; // Only used when solve is called without body states
+    glm::dvec3 _static_velocity = glm::dvec3(0, 0, 0); // Used as the velocity of objects that cannot move
+    // The velocities from the push impulses of the last solve, for each cube, see move_push_apart
+    std::vector<glm::dvec3> _push_linear_velocities;
+    std::vector<glm::dvec3> _push_rotational_velocities;
+
+    glm::dvec3& _get_linear_velocity(std::vector<Cube>& cubes, int body) {
+        if(body < 0) {
+            _static_velocity = glm::dvec3(0, 0, 0);
+            return _static_velocity;
+        }
+        return cubes[body].trajectory.linear_velocity.speed_m_per_s;
+    }
+    glm::dvec3& _get_rotational_velocity(std::vector<Cube>& cubes, int body) {
+        if(body < 0) {
+            _static_velocity = glm::dvec3(0, 0, 0);
+            return _static_velocity;
+        }
+        return cubes[body].trajectory.rotational_velocity.rotation;
+    }
+    // How fast the bodies are moving towards each other at the contact point, negative if they are closing in
+    double _get_normal_velocity(std::vector<Cube>& cubes, const SolverContact& contact) {
+        glm::dvec3 velocity1 = glm::dvec3(0, 0, 0);
+        glm::dvec3 velocity2 = glm::dvec3(0, 0, 0);
+        if(contact.body1 >= 0) {
+            const ObjectTrajectory& trajectory = cubes[contact.body1].trajectory;
+            velocity1 = trajectory.linear_velocity.speed_m_per_s + glm::cross(trajectory.rotational_velocity.rotation, contact._r1);
+        }
+        if(contact.body2 >= 0) {
+            const ObjectTrajectory& trajectory = cubes[contact.body2].trajectory;
+            velocity2 = trajectory.linear_velocity.speed_m_per_s + glm::cross(trajectory.rotational_velocity.rotation, contact._r2);
+        }
+        return glm::dot(velocity1 - velocity2, contact.normal);
+    }
+    // The same as _get_normal_velocity, but for the push velocities
+    double _get_push_normal_velocity(const SolverContact& contact) const {
+        glm::dvec3 velocity1 = glm::dvec3(0, 0, 0);
+        glm::dvec3 velocity2 = glm::dvec3(0, 0, 0);
+        if(contact.body1 >= 0) {
+            velocity1 = _push_linear_velocities[contact.body1] + glm::cross(_push_rotational_velocities[contact.body1], contact._r1);
+        }
+        if(contact.body2 >= 0) {
+            velocity2 = _push_linear_velocities[contact.body2] + glm::cross(_push_rotational_velocities[contact.body2], contact._r2);
+        }
+        return glm::dot(velocity1 - velocity2, contact.normal);
+    }
+    void _apply_push_impulse(const SolverContact& contact, double impulse_newton_s) {
+        if(contact.body1 >= 0) {
+            _push_linear_velocities[contact.body1] += contact.normal * (impulse_newton_s * contact._inverse_mass1);
+            _push_rotational_velocities[contact.body1] += contact._angular_change1 * impulse_newton_s;
+        }
+        if(contact.body2 >= 0) {
+            _push_linear_velocities[contact.body2] -= contact.normal * (impulse_newton_s * contact._inverse_mass2);
+            _push_rotational_velocities[contact.body2] -= contact._angular_change2 * impulse_newton_s;
+        }
+    }
+    void _apply_impulse(std::vector<Cube>& cubes, const SolverContact& contact, double impulse_newton_s) {
+        applied_impulse_count += (impulse_newton_s != 0);
+        _get_linear_velocity(cubes, contact.body1) += contact.normal * (impulse_newton_s * contact._inverse_mass1);
+        _get_rotational_velocity(cubes, contact.body1) += contact._angular_change1 * impulse_newton_s;
+        _get_linear_velocity(cubes, contact.body2) -= contact.normal * (impulse_newton_s * contact._inverse_mass2);
+        _get_rotational_velocity(cubes, contact.body2) -= contact._angular_change2 * impulse_newton_s;
+    }
+    void _prepare_contact(std::vector<Cube>& cubes, const std::vector<CubeBodyState>& body_states, SolverContact& contact, double time_step_s) {
+        const glm::dvec3& n = contact.normal;
+        contact._r1 = glm::dvec3(0, 0, 0);
+        contact._r2 = glm::dvec3(0, 0, 0);
+        contact._angular_change1 = glm::dvec3(0, 0, 0);
+        contact._angular_change2 = glm::dvec3(0, 0, 0);
+        contact._inverse_mass1 = 0;
+        contact._inverse_mass2 = 0;
+        if(contact.body1 >= 0) {
+            const CubeBodyState& body_state = body_states[contact.body1];
+            contact._r1 = contact.position - cubes[contact.body1].trajectory.orientation.center_of_mass;
+            contact._angular_change1 = body_state.world_inverse_inertia * glm::cross(contact._r1, n);
+            contact._inverse_mass1 = body_state.inverse_mass_kg;
+        }
+        if(contact.body2 >= 0) {
+            const CubeBodyState& body_state = body_states[contact.body2];
+            contact._r2 = contact.position - cubes[contact.body2].trajectory.orientation.center_of_mass;
+            contact._angular_change2 = body_state.world_inverse_inertia * glm::cross(contact._r2, n);
+            contact._inverse_mass2 = body_state.inverse_mass_kg;
+        }
+
+        // See https://en.wikipedia.org/wiki/Collision_response
+        double divider = contact._inverse_mass1 + contact._inverse_mass2;
+        divider += glm::dot(glm::cross(contact._angular_change1, contact._r1) + glm::cross(contact._angular_change2, contact._r2), n);
+        contact._effective_mass = divider > 0 ? 1.0 / divider : 0;
+
+        // Bounce back if the objects hit each other hard enough
+        double closing_velocity_m_s = _get_normal_velocity(cubes, contact);
+        contact._target_velocity_m_s = 0;
+        if(closing_velocity_m_s < -restitution_velocity_threshold_m_s) {
+            contact._target_velocity_m_s = -contact.restitution_constant * closing_velocity_m_s;
+        }
+        // Push them apart if they overlap too much, this only moves them and does not change their velocity
+        contact._push_target_velocity_m_s = baumgarte_factor * std::max(contact.penetration_depth_m - penetration_slop_m, 0.0) / time_step_s;
+        contact.accumulated_push_impulse_newton_s = 0;
+    }
+public:
+    int velocity_iterations = 8;
+    int push_iterations = 4; // How many times the push impulses are adjusted, see move_push_apart
+    bool warm_starting = true;
+    double baumgarte_factor = 0.2; // How much of the overlap to remove each step
+    double penetration_slop_m = 0.005; // Allow the objects to overlap this much, so resting contacts are not lost every other step
+    double restitution_velocity_threshold_m_s = 0.2; // Slower collisions than this do not bounce
+
+    std::vector<SolverContact> contacts; // Fill these before calling solve
+    int applied_impulse_count = 0; // How many non zero impulses the last solve applied, including the warm starting impulses
+
+    /**
+     * Change the velocities of the cubes so that no contact is closing in
+     *  Afterwards accumulated_impulse_newton_s is set for all contacts, and is remembered to the next call
+     *  The overlaps are removed with push velocities instead, call move_push_apart when the cubes are moved
+     * @param body_states The body state of each cube, the masses and inertia are read from them
+    */
+    void solve(std::vector<Cube>& cubes, const std::vector<CubeBodyState>& body_states, double time_step_s) {
+        START_TRACE_FUNCTION();
+        applied_impulse_count = 0;
+        _push_linear_velocities.assign(cubes.size(), glm::dvec3(0, 0, 0));
+        _push_rotational_velocities.assign(cubes.size(), glm::dvec3(0, 0, 0));
+        for(int i = 0; i < contacts.size(); i++) {
+            _prepare_contact(cubes, body_states, contacts[i], time_step_s);
+        }
+
+        // Start with the impulses from the last step, then a resting contact is almost solved already
+        for(int i = 0; i < contacts.size(); i++) {
+            SolverContact& contact = contacts[i];
+            contact.accumulated_impulse_newton_s = 0;
+            if(!warm_starting) {
+                continue;
+            }
+            auto cached_impulse = _impulse_cache.find(ContactKey::from_contact(contact));
+            if(cached_impulse != _impulse_cache.end()) {
+                contact.accumulated_impulse_newton_s = cached_impulse->second;
+                _apply_impulse(cubes, contact, contact.accumulated_impulse_newton_s);
+            }
+        }
+
+        for(int iteration = 0; iteration < velocity_iterations; iteration++) {
+            for(int i = 0; i < contacts.size(); i++) {
+                SolverContact& contact = contacts[i];
+                double normal_velocity_m_s = _get_normal_velocity(cubes, contact);
+                double impulse_newton_s = (contact._target_velocity_m_s - normal_velocity_m_s) * contact._effective_mass;
+
+                // Clamp the total impulse instead of each change, so an earlier push can be partly undone
+                double new_accumulated_impulse = std::max(contact.accumulated_impulse_newton_s + impulse_newton_s, 0.0);
+                impulse_newton_s = new_accumulated_impulse - contact.accumulated_impulse_newton_s;
+                contact.accumulated_impulse_newton_s = new_accumulated_impulse;
+                _apply_impulse(cubes, contact, impulse_newton_s);
+            }
+        }
+
+        // The push velocities start from zero every step, since they are not kept as real velocity
+        for(int iteration = 0; iteration < push_iterations; iteration++) {
+            for(int i = 0; i < contacts.size(); i++) {
+                SolverContact& contact = contacts[i];
+                if(contact._push_target_velocity_m_s <= 0 && contact.accumulated_push_impulse_newton_s == 0) {
+                    continue; // Not overlapping too much, and nothing to undo
+                }
+                double impulse_newton_s = (contact._push_target_velocity_m_s - _get_push_normal_velocity(contact)) * contact._effective_mass;
+                double new_accumulated_impulse = std::max(contact.accumulated_push_impulse_newton_s + impulse_newton_s, 0.0);
+                impulse_newton_s = new_accumulated_impulse - contact.accumulated_push_impulse_newton_s;
+                contact.accumulated_push_impulse_newton_s = new_accumulated_impulse;
+                _apply_push_impulse(contact, impulse_newton_s);
+            }
+        }
+
+        _impulse_cache.clear();
+        for(int i = 0; i < contacts.size(); i++) {
+            _impulse_cache[ContactKey::from_contact(contacts[i])] = contacts[i].accumulated_impulse_newton_s;
+        }
+    }
+
+    void solve(std::vector<Cube>& cubes, double time_step_s) {
+        _body_states.resize(cubes.size());
+        for(int i = 0; i < cubes.size(); i++) {
+            _body_states[i] = CubeBodyState::from_cube(cubes[i]);
+        }
+        solve(cubes, _body_states, time_step_s);
+    }
+
+    /**
+     * Move a cube by its push velocity from the last solve, call it after moving the cube with its real velocity
+     *  Only the position and rotation changes, so the energy of the cube is the same as before
+    */
+    void move_push_apart(ObjectTrajectory& trajectory, int cube_index, double time_step_s) const {
+        if(cube_index >= _push_linear_velocities.size()) {
+            return;
+        }
+        const glm::dvec3& push_linear_velocity = _push_linear_velocities[cube_index];
+        const glm::dvec3& push_rotational_velocity = _push_rotational_velocities[cube_index];
+        if(push_linear_velocity == glm::dvec3(0, 0, 0) && push_rotational_velocity == glm::dvec3(0, 0, 0)) {
+            return;
+        }
+        ObjectTrajectory push = ObjectTrajectory::zero();
+        push.orientation = trajectory.orientation;
+        push.linear_velocity.speed_m_per_s = push_linear_velocity;
+        push.rotational_velocity.rotation = push_rotational_velocity;
+        push.move_time_step_s(time_step_s);
+        trajectory.orientation = push.orientation;
+    }
+
+    // The impulses remembered from the last step, e.g. to save them in a snapshot
+    const std::unordered_map<ContactKey, double, ContactKeyHash>& get_impulse_cache() const {
+        return _impulse_cache;
+    }
+    void set_cached_impulse(const ContactKey& key, double impulse_newton_s) {
+        _impulse_cache[key] = impulse_newton_s;
+    }
+    void clear_impulse_cache() {
+        _impulse_cache.clear();
+    }
+};
+TestWrapper(TEST_ContactSolver_stops_closing_velocity,
+    /** After solving, a cube falling onto the ground should not move into it at the contact point
+    */
+    void test() {
+        std::vector<Cube> cubes = std::vector<Cube>(1);
+        cubes[0].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, -0.1, 0);
+        cubes[0].trajectory.rotational_velocity.rotation = glm::dvec3(0.1, 0, 0.2);
+
+        ContactSolver solver;
+        SolverContact contact;
+        contact.body1 = 0;
+        contact.body2 = -1;
+        contact.position = glm::dvec3(0.5, -0.5, 0.5);
+        contact.normal = glm::dvec3(0, 1, 0);
+        solver.contacts.push_back(contact);
+        solver.solve(cubes, 1.0 / 30);
+
+        glm::dvec3 velocity = cubes[0].trajectory.get_point_velocity_m_per_s(contact.position);
+        Assert(abs(velocity.y) < 0.000001);
+        Assert(solver.contacts[0].accumulated_impulse_newton_s > 0);
+
+        // The next step the same contact should start out with the impulse from this step
+        cubes[0].trajectory.linear_velocity.speed_m_per_s = glm::dvec3(0, -0.1, 0);
+        cubes[0].trajectory.rotational_velocity.rotation = glm::dvec3(0.1, 0, 0.2);
+        double first_impulse = solver.contacts[0].accumulated_impulse_newton_s;
+        solver.velocity_iterations = 0;
+        solver.solve(cubes, 1.0 / 30);
+        Assert(abs(solver.contacts[0].accumulated_impulse_newton_s - first_impulse) < 0.000001);
+        velocity = cubes[0].trajectory.get_point_velocity_m_per_s(contact.position);
+        Assert(abs(velocity.y) < 0.000001);
+    }
+);
+TestWrapper(TEST_ContactSolver_push_apart_keeps_velocity,
+    /** A cube resting 5cm into the ground should be moved up, without getting any upwards velocity
+    */
+    void test() {
+        std::vector<Cube> cubes = std::vector<Cube>(1);
+        cubes[0].trajectory.orientation.center_of_mass = glm::dvec3(0, 0.45, 0);
+        ContactSolver solver;
+        for(int i = 0; i < 4; i++) {
+            SolverContact contact;
+            contact.body1 = 0;
+            contact.body2 = -1;
+            contact.feature_id = i;
+            contact.position = glm::dvec3(i % 2 - 0.5, -0.05, i / 2 - 0.5);
+            contact.normal = glm::dvec3(0, 1, 0);
+            contact.penetration_depth_m = 0.05;
+            solver.contacts.push_back(contact);
+        }
+        solver.solve(cubes, 1.0 / 30);
+        Assert(cubes[0].trajectory.linear_velocity.speed_m_per_s == glm::dvec3(0, 0, 0));
+        Assert(cubes[0].trajectory.rotational_velocity.rotation == glm::dvec3(0, 0, 0));
+
+        solver.move_push_apart(cubes[0].trajectory, 0, 1.0 / 30);
+        double expected_y_m = 0.45 + solver.baumgarte_factor * (0.05 - solver.penetration_slop_m);
+        Assert(abs(cubes[0].trajectory.orientation.center_of_mass.y - expected_y_m) < 0.0001);
+        Assert(glm::length(cubes[0].trajectory.orientation.rotational_orientation.quaternion - glm::dquat(1, 0, 0, 0)) < 0.0001);
+    }
+);
@@ -1,2 +1,13 @@
 #pragma once
-#include "N6_energy.h"
\ No newline at end of file
+#include "../vicmil_lib/N4_vicmil_emscripten/vicmil_emscripten.h"
+#include "N15_convex_collision.h"
+
+vicmil::ModelOrientation get_model_orientation_from_obj_orientation(ObjectOrientation obj_orientation) {
+    vicmil::ModelOrientation orientation;
+    orientation.position = obj_orientation.center_of_mass;
+    orientation.rotation = obj_orientation.rotational_orientation.to_matrix();
+    return orientation;
+}
+vicmil::ModelOrientation get_model_orientation_from_obj_trajectory(ObjectTrajectory trajectory) {
+    return get_model_orientation_from_obj_orientation(trajectory.orientation);
+}
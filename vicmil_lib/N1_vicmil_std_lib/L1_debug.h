@@ -7,6 +7,12 @@
 #include <cassert>
 #include <fstream>
 #include <filesystem>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <memory>
+#include <cstdint>
 
 namespace vicmil {
 
@@ -123,8 +129,211 @@ namespace vicmil {
 #define ThrowError(x) std::cout << GetFileName << ": ln" << __LINE__ << ": " << x << std::endl; throw
 #define ThrowNotImplemented() std::cout << GetFileName << ": ln" << __LINE__ << ": " << "Not implemented yet!" << std::endl; throw
 
-#define START_TRACE_FUNCTION() Debug(std::string("start ") + __func__)
-#define END_TRACE_FUNCTION() Debug(std::string("exit ") + __func__)
+/* Tracing
+ * A trace zone records when it starts and how long it lasts, e.g. one zone for each phase of a physics step
+ * Each thread writes its zones to its own ring buffer without any locks, the oldest zones are overwritten when it is full
+ * The zones can be exported as a chrome trace, open it in chrome://tracing or https://ui.perfetto.dev
+ * Zones are only recorded if USE_TRACING is defined, otherwise the macros compile to nothing
+*/
+struct TraceEvent {
+    const char* name; // Must live until the trace is exported, e.g. a string literal or __func__
+    int64_t start_ns;
+    int64_t duration_ns;
+};
+
+inline int64_t get_trace_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * The events of one thread, only that thread writes to it
+ *  Other threads can read and clear it while the thread is writing, a slot that is overwritten while it is read
+ *  is noticed from the write count afterwards and left out. The slots are relaxed atomics, which compile to plain
+ *  loads and stores, so reading a slot while it is written is not a data race
+*/
+class TraceBuffer {
+    struct Slot {
+        std::atomic<const char*> name;
+        std::atomic<int64_t> start_ns;
+        std::atomic<int64_t> duration_ns;
+    };
+    std::unique_ptr<Slot[]> _slots;
+    uint64_t _capacity; // A power of 2
+    std::atomic<uint64_t> _write_count; // The total number of events written, the index wraps around the buffer
+    std::atomic<uint64_t> _cleared_count; // The write count when the buffer was last cleared, only written by clear
+public:
+    int thread_index;
+    TraceBuffer(size_t capacity, int thread_index_) {
+        _capacity = 1;
+        while(_capacity < capacity) {
+            _capacity *= 2;
+        }
+        _slots = std::make_unique<Slot[]>(_capacity);
+        _write_count = 0;
+        _cleared_count = 0;
+        thread_index = thread_index_;
+    }
+    inline void add(const TraceEvent& event) {
+        uint64_t write_count = _write_count.load(std::memory_order_relaxed);
+        // The count from the last add has to be visible before the slot is overwritten, see get_events
+        std::atomic_thread_fence(std::memory_order_release);
+        Slot& slot = _slots[write_count & (_capacity - 1)];
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.start_ns.store(event.start_ns, std::memory_order_relaxed);
+        slot.duration_ns.store(event.duration_ns, std::memory_order_relaxed);
+        _write_count.store(write_count + 1, std::memory_order_release);
+    }
+    // Get the events that are still in the buffer, oldest first
+    std::vector<TraceEvent> get_events() const {
+        uint64_t write_count = _write_count.load(std::memory_order_acquire);
+        uint64_t first_count = std::max(_cleared_count.load(std::memory_order_acquire), write_count - std::min(write_count, _capacity));
+        std::vector<TraceEvent> events;
+        events.reserve(write_count - first_count);
+        for(uint64_t i = first_count; i < write_count; i++) {
+            const Slot& slot = _slots[i & (_capacity - 1)];
+            TraceEvent event;
+            event.name = slot.name.load(std::memory_order_relaxed);
+            event.start_ns = slot.start_ns.load(std::memory_order_relaxed);
+            event.duration_ns = slot.duration_ns.load(std::memory_order_relaxed);
+            events.push_back(event);
+        }
+
+        // Writing event number n overwrites the slot of event n - capacity, and the thread may be writing 
+        // event number write_count_after right now. Leave out the events whose slots may have been overwritten
+        std::atomic_thread_fence(std::memory_order_acquire);
+        uint64_t write_count_after = _write_count.load(std::memory_order_relaxed);
+        if(write_count_after + 1 > _capacity) {
+            uint64_t first_valid_count = write_count_after + 1 - _capacity;
+            size_t overwritten_count = std::min<uint64_t>(events.size(), first_valid_count > first_count ? first_valid_count - first_count : 0);
+            events.erase(events.begin(), events.begin() + overwritten_count);
+        }
+        return events;
+    }
+    // Forget the events written so far, the thread can keep writing while it is cleared
+    void clear() {
+        _cleared_count.store(_write_count.load(std::memory_order_acquire), std::memory_order_release);
+    }
+};
+
+/**
+ * Keeps the buffers of all threads, the buffers are kept after their threads have exited so they can still be exported
+*/
+class Tracer {
+    std::mutex _mutex; // Only used when a thread records its first event, and when exporting
+    std::vector<std::unique_ptr<TraceBuffer>> _buffers;
+
+    // Chrome trace times are in microseconds, write them with all three decimals
+    static void _write_microseconds(std::ostream& output, int64_t time_ns) {
+        char decimals[4] = {
+            (char)('0' + time_ns % 1000 / 100),
+            (char)('0' + time_ns % 100 / 10),
+            (char)('0' + time_ns % 10), 
+            '\0'
+        };
+        output << time_ns / 1000 << "." << decimals;
+    }
+public:
+    std::atomic<bool> enabled;
+    size_t events_per_thread = 1 << 16;
+
+    Tracer() {
+        enabled = true;
+    }
+    static Tracer& get() {
+        static Tracer tracer;
+        return tracer;
+    }
+    TraceBuffer& get_thread_buffer() {
+        thread_local TraceBuffer* buffer = nullptr;
+        if(!buffer) {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _buffers.push_back(std::make_unique<TraceBuffer>(events_per_thread, (int)_buffers.size()));
+            buffer = _buffers.back().get();
+        }
+        return *buffer;
+    }
+    // Forget all recorded events, other threads can keep recording zones at the same time
+    void clear() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for(int i = 0; i < _buffers.size(); i++) {
+            _buffers[i]->clear();
+        }
+    }
+    /**
+     * Write all recorded events in the chrome trace_event json format
+     *  Other threads can keep recording zones, but a zone that ends during the export may be left out, and so
+     *  may zones that are overwritten because a thread records more than events_per_thread zones during the export
+    */
+    void write_chrome_trace(std::ostream& output) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        output << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first_event = true;
+        for(int b = 0; b < _buffers.size(); b++) {
+            std::vector<TraceEvent> events = _buffers[b]->get_events();
+            for(int i = 0; i < events.size(); i++) {
+                output << (first_event ? "\n" : ",\n");
+                first_event = false;
+                output << "{\"name\":\"";
+                for(const char* c = events[i].name; *c != '\0'; c++) {
+                    if(*c == '"' || *c == '\\') {
+                        output << '\\';
+                    }
+                    output << *c;
+                }
+                output << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << _buffers[b]->thread_index << ",\"ts\":";
+                _write_microseconds(output, events[i].start_ns);
+                output << ",\"dur\":";
+                _write_microseconds(output, events[i].duration_ns);
+                output << "}";
+            }
+        }
+        output << "\n]}\n";
+    }
+    bool write_chrome_trace_file(const std::string& filename) {
+        std::ofstream file = std::ofstream(filename, std::ios::out | std::ios::trunc);
+        if(!file.is_open()) {
+            return false;
+        }
+        write_chrome_trace(file);
+        return (bool)file;
+    }
+};
+
+/**
+ * Records a zone from when it is created until it goes out of scope
+*/
+class TraceZone {
+    const char* _name;
+    int64_t _start_ns;
+public:
+    inline TraceZone(const char* name) {
+        _name = name;
+        _start_ns = Tracer::get().enabled.load(std::memory_order_relaxed) ? get_trace_time_ns() : -1;
+    }
+    inline ~TraceZone() {
+        if(_start_ns != -1) {
+            TraceEvent event;
+            event.name = _name;
+            event.start_ns = _start_ns;
+            event.duration_ns = get_trace_time_ns() - _start_ns;
+            Tracer::get().get_thread_buffer().add(event);
+        }
+    }
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator=(const TraceZone&) = delete;
+};
+
+#define _VICMIL_CONCAT_INNER(a, b) a##b
+#define _VICMIL_CONCAT(a, b) _VICMIL_CONCAT_INNER(a, b)
+#ifdef USE_TRACING
+#define TRACE_ZONE(name) vicmil::TraceZone _VICMIL_CONCAT(__trace_zone_, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
+
+// Trace the rest of the function, the zone ends when the function returns
+#define START_TRACE_FUNCTION() TRACE_ZONE(__func__)
+#define END_TRACE_FUNCTION()
 
 #define DebugExpr(x) Debug(#x << ": '" << x << "'")
 
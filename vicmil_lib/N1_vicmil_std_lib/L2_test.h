@@ -3,6 +3,10 @@
 #include "L1_debug.h"
 #include <string>
 #include <map>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <ostream>
 
 namespace vicmil {
 #ifdef TEST_KEYWORDS
@@ -70,4 +74,158 @@ namespace test_factory { \
 #define TestWrapper(test_name, func)
 #endif
 
+/**
+ * Make sure the compiler does not remove a calculation because the result is never used
+*/
+template<class T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct BenchmarkSettings {
+    double warmup_s = 0.1; // Run this long before measuring, also used to find how many iterations fit in a sample
+    double min_sample_time_s = 0.002; // Each sample runs enough iterations to take at least this long
+    int sample_count = 100;
+};
+
+/**
+ * The time of one iteration of a benchmark, the median and p99 are taken over the samples
+*/
+struct BenchmarkResult {
+    std::string name;
+    long long iterations_per_sample = 0;
+    int sample_count = 0;
+    double median_ns = 0;
+    double p99_ns = 0;
+    double min_ns = 0;
+    double mean_ns = 0;
+};
+
+struct BenchmarkBase {
+    std::string _id_long;
+    std::mt19937 _random_generator = std::mt19937(1); // Seeded, so the inputs are the same every run
+    virtual ~BenchmarkBase() {}
+    virtual void setup() {} // Called once before the benchmark is run, e.g. to create the inputs
+    virtual void run() {} // One iteration of what is measured
+
+    // Get a random number between min and max, the same on every platform
+    double get_random_double(double min, double max) {
+        return min + (max - min) * (_random_generator() / 4294967296.0);
+    }
+};
+
+typedef std::map<std::string, BenchmarkBase*> BenchmarkMap;
+static BenchmarkMap* benchmark_map = nullptr;
+
+struct BenchmarkClass : public BenchmarkBase {
+    BenchmarkClass(std::string id, std::string id_long) {
+        if ( !benchmark_map ) {
+            benchmark_map = new BenchmarkMap();
+        }
+        (*benchmark_map)[id] = this;
+        _id_long = id_long;
+    }
+    static double _get_time_s() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+    static double _run_iterations_s(BenchmarkBase& benchmark, long long iteration_count) {
+        double start_time_s = _get_time_s();
+        for(long long i = 0; i < iteration_count; i++) {
+            benchmark.run();
+        }
+        return _get_time_s() - start_time_s;
+    }
+    static BenchmarkResult measure(BenchmarkBase& benchmark, std::string name, BenchmarkSettings settings = BenchmarkSettings()) {
+        BenchmarkResult result;
+        result.name = name;
+        benchmark.setup();
+
+        // Warm up, and double the iterations until they take long enough to measure
+        long long iteration_count = 1;
+        double warmup_start_s = _get_time_s();
+        while(true) {
+            double elapsed_s = _run_iterations_s(benchmark, iteration_count);
+            if(elapsed_s >= settings.min_sample_time_s && _get_time_s() - warmup_start_s >= settings.warmup_s) {
+                break;
+            }
+            if(elapsed_s < settings.min_sample_time_s) {
+                iteration_count *= 2;
+            }
+        }
+
+        std::vector<double> samples_ns = std::vector<double>(settings.sample_count);
+        for(int i = 0; i < settings.sample_count; i++) {
+            samples_ns[i] = _run_iterations_s(benchmark, iteration_count) * 1e9 / iteration_count;
+        }
+        std::sort(samples_ns.begin(), samples_ns.end());
+        result.iterations_per_sample = iteration_count;
+        result.sample_count = settings.sample_count;
+        result.median_ns = samples_ns[samples_ns.size() / 2];
+        result.p99_ns = samples_ns[std::min(samples_ns.size() - 1, (size_t)(samples_ns.size() * 0.99))];
+        result.min_ns = samples_ns[0];
+        for(int i = 0; i < samples_ns.size(); i++) {
+            result.mean_ns += samples_ns[i] / samples_ns.size();
+        }
+        return result;
+    }
+    static std::vector<BenchmarkResult> run_all_benchmarks(std::vector<std::string> benchmark_keywords = {"."}, BenchmarkSettings settings = BenchmarkSettings()) {
+        std::vector<BenchmarkResult> results;
+        if(!benchmark_map) {
+            std::cout << "No benchmarks detected!" << std::endl;
+            return results;
+        }
+        for(auto it = benchmark_map->begin(); it != benchmark_map->end(); it++) {
+            if(!match_keywords(it->second->_id_long, benchmark_keywords)) {
+                continue;
+            }
+            BenchmarkResult result = measure(*it->second, it->first, settings);
+            std::cout << "benchmark: " << result.name << " median: " << result.median_ns << "ns  p99: " 
+                << result.p99_ns << "ns  (" << result.iterations_per_sample << " iterations x " << result.sample_count << ")" << std::endl;
+            results.push_back(result);
+        }
+        return results;
+    }
+    /**
+     * Write the results as csv with a header line, one line per benchmark, the times are in nanoseconds per iteration
+    */
+    static void write_results_csv(const std::vector<BenchmarkResult>& results, std::ostream& output) {
+        output << "name,iterations_per_sample,sample_count,median_ns,p99_ns,min_ns,mean_ns\n";
+        for(int i = 0; i < results.size(); i++) {
+            const BenchmarkResult& result = results[i];
+            output << "\"" << result.name << "\"," << result.iterations_per_sample << "," << result.sample_count << "," 
+                << result.median_ns << "," << result.p99_ns << "," << result.min_ns << "," << result.mean_ns << "\n";
+        }
+    }
+};
+
+/**
+ * Register a benchmark, they are only compiled if USE_BENCHMARKS is defined
+ *  The name does not include the line number, so results can be compared after the code has changed
+ *  func should define run(), and can define setup() and member variables for the inputs, e.g.
+ *  BenchmarkWrapper(BENCHMARK_name,
+ *      std::vector<double> inputs;
+ *      void setup() { inputs = ...; }
+ *      void run() { vicmil::do_not_optimize(...); }
+ *  );
+*/
+#ifdef USE_BENCHMARKS
+#define BenchmarkWrapper(benchmark_name, func) \
+namespace benchmark_class { \
+    struct benchmark_name : vicmil::BenchmarkClass { \
+        benchmark_name() : vicmil::BenchmarkClass(GetFileName + " " + #benchmark_name, GetLineIdentifierLong) {} \
+        func \
+    }; \
+} \
+namespace benchmark_factory { \
+    benchmark_class::benchmark_name benchmark_name = benchmark_class::benchmark_name(); \
+}
+#else
+#define BenchmarkWrapper(benchmark_name, func)
+#endif
+
 }
\ No newline at end of file
@@ -1,6 +1,19 @@
 #include "L3_string.h"
 #include <fstream>
 #include <sstream>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
 
 namespace vicmil {
 
@@ -164,91 +177,800 @@ public:
     }
 };
 
+/**
+ * A whole file mapped into memory, read only
+ *  Nothing is read when the file is opened, the pages are read from disk the first time they are used
+ *  If memory mapping is not available, the whole file is read into memory instead
+*/
+class MappedFile {
+    const char* _data = nullptr;
+    size_t _size = 0;
+    bool _is_open = false;
+    bool _is_mapped = false;
+    std::vector<char> _buffer; // Only used if the file could not be memory mapped
+
+    void _close() {
+#if defined(__unix__) || defined(__APPLE__)
+        if(_is_mapped && _size > 0) {
+            munmap((void*)_data, _size);
+        }
+#endif
+        _data = nullptr;
+        _size = 0;
+        _is_open = false;
+        _is_mapped = false;
+        _buffer.clear();
+    }
+    void _move_from(MappedFile& other) {
+        _data = other._data;
+        _size = other._size;
+        _is_open = other._is_open;
+        _is_mapped = other._is_mapped;
+        _buffer = std::move(other._buffer);
+        if(!_is_mapped) {
+            _data = _buffer.data();
+        }
+        other._data = nullptr;
+        other._size = 0;
+        other._is_open = false;
+        other._is_mapped = false;
+    }
+public:
+    MappedFile() {}
+    MappedFile(const std::string& filename) {
+#if defined(__unix__) || defined(__APPLE__)
+        int file_descriptor = ::open(filename.c_str(), O_RDONLY);
+        if(file_descriptor != -1) {
+            struct stat file_info;
+            if(fstat(file_descriptor, &file_info) == 0) {
+                _size = file_info.st_size;
+                _is_open = true;
+                if(_size > 0) {
+                    void* data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+                    if(data != MAP_FAILED) {
+                        _data = (const char*)data;
+                        _is_mapped = true;
+                    }
+                }
+            }
+            ::close(file_descriptor);
+            if(_is_mapped || (_is_open && _size == 0)) {
+                return;
+            }
+            _is_open = false;
+            _size = 0;
+        }
+#endif
+        std::ifstream file = std::ifstream(filename, std::ios::in | std::ios::binary);
+        if(!file.is_open()) {
+            return;
+        }
+        file.seekg(0, std::ios::end);
+        _buffer.resize(file.tellg());
+        file.seekg(0, std::ios::beg);
+        file.read(_buffer.data(), _buffer.size());
+        _data = _buffer.data();
+        _size = _buffer.size();
+        _is_open = true;
+    }
+    ~MappedFile() {
+        _close();
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) {
+        _move_from(other);
+    }
+    MappedFile& operator=(MappedFile&& other) {
+        if(this != &other) {
+            _close();
+            _move_from(other);
+        }
+        return *this;
+    }
+
+    bool is_open() const {
+        return _is_open;
+    }
+    const char* data() const {
+        return _data;
+    }
+    size_t size() const {
+        return _size;
+    }
+};
+
 namespace json {
     enum json_type_index {
         DICT = 0,
         STR,
         DOUBLE_VEC,
         DOUBLE,
+        ARRAY,
     };
 
-    std::string get_indent_spaces(int indent) {
-        std::string return_str;
-        for(int i = 0; i < indent; i++) {
-            return_str += "    ";
+    /**
+     * Writes json directly to a stream, without building the whole string in memory first
+     *  Values inside objects must be preceded by a key
+     *  Doubles are written with as many digits as needed to read back exactly the same value
+    */
+    class JsonWriter {
+        std::ostream* _output;
+        bool _indented;
+        std::vector<bool> _scope_has_values; // One for each object or array that has been started but not ended
+        bool _after_key = false;
+
+        inline void _write(const char* str, size_t size) {
+            _output->write(str, size);
         }
-        return return_str;
-    }
+        void _write_newline_and_indent() {
+            static const char spaces[] = "\n                                ";
+            _write(spaces, 1);
+            size_t indent = _scope_has_values.size() * 4;
+            while(indent > 0) {
+                size_t size = std::min(indent, sizeof(spaces) - 2);
+                _write(spaces + 1, size);
+                indent -= size;
+            }
+        }
+        // Separate the value from the previous one in the same object or array
+        void _before_value() {
+            if(_after_key) {
+                _after_key = false;
+                return;
+            }
+            if(_scope_has_values.size() == 0) {
+                return;
+            }
+            if(_scope_has_values.back()) {
+                _write(",", 1);
+            }
+            _scope_has_values.back() = true;
+            if(_indented) {
+                _write_newline_and_indent();
+            }
+        }
+        void _begin_scope(char bracket) {
+            _before_value();
+            _write(&bracket, 1);
+            _scope_has_values.push_back(false);
+        }
+        void _end_scope(char bracket) {
+            bool has_values = _scope_has_values.back();
+            _scope_has_values.pop_back();
+            if(_indented && has_values) {
+                _write_newline_and_indent();
+            }
+            _write(&bracket, 1);
+        }
+        void _write_string(const std::string& str) {
+            _write("\"", 1);
+            size_t unwritten_start = 0;
+            for(size_t i = 0; i < str.size(); i++) {
+                unsigned char c = str[i];
+                if(c != '"' && c != '\\' && c >= 0x20) {
+                    continue;
+                }
+                _write(str.data() + unwritten_start, i - unwritten_start);
+                unwritten_start = i + 1;
+                char escaped[8];
+                int escaped_size = 2;
+                escaped[0] = '\\';
+                escaped[1] = (char)c;
+                if(c == '\n') escaped[1] = 'n';
+                else if(c == '\t') escaped[1] = 't';
+                else if(c == '\r') escaped[1] = 'r';
+                else if(c < 0x20) {
+                    escaped_size = std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                }
+                _write(escaped, escaped_size);
+            }
+            _write(str.data() + unwritten_start, str.size() - unwritten_start);
+            _write("\"", 1);
+        }
+    public:
+        /**
+         * @param indented Put every value on its own line, otherwise everything is written without any whitespace
+        */
+        JsonWriter(std::ostream& output, bool indented = false) {
+            _output = &output;
+            _indented = indented;
+        }
+        void begin_object() {
+            _begin_scope('{');
+        }
+        void end_object() {
+            _end_scope('}');
+        }
+        void begin_array() {
+            _begin_scope('[');
+        }
+        void end_array() {
+            _end_scope(']');
+        }
+        void key(const std::string& name) {
+            _before_value();
+            _write_string(name);
+            _write(":", 1);
+            _after_key = true;
+        }
+        void value(double number) {
+            _before_value();
+            if(!std::isfinite(number)) {
+                _write("null", 4); // Json has no inf or nan
+                return;
+            }
+            char buffer[32];
+            std::to_chars_result result = std::to_chars(buffer, buffer + sizeof(buffer), number);
+            _write(buffer, result.ptr - buffer);
+        }
+        void value(const std::string& str) {
+            _before_value();
+            _write_string(str);
+        }
+        void value(const std::vector<double>& numbers) {
+            begin_array();
+            for(size_t i = 0; i < numbers.size(); i++) {
+                value(numbers[i]);
+            }
+            end_array();
+        }
+    };
 
     class Json {
         std::map<std::string, class Json> _dict = std::map<std::string, Json>();
         std::string _str;
         std::vector<double> _double_vec;
+        std::vector<Json> _array;
         double _double;
 
         json_type_index _type = json_type_index::DICT;
 
-        std::string _to_string(int indent_) {
-            if(_type == json_type_index::DICT) {
-                std::string return_str = "{\n";
-                for (auto i = _dict.begin(); i != _dict.end(); ++i) {
-                    if(i != _dict.begin()) {
-                        return_str += ",\n";
-                    }
-                    return_str += get_indent_spaces(indent_ + 1);
-                    return_str += "\"" + i->first + "\":";
-                    return_str += i->second._to_string(indent_+1);
-                }
-                return_str += "\n" + get_indent_spaces(indent_) + "}";
-                return return_str;
-            }
-            if(_type == json_type_index::STR) {
-                return "\"" +  _str + "\"";
-            }
-            if(_type == json_type_index::DOUBLE_VEC) {
-                if(_double_vec.size() == 0) {
-                    return "[]";
-                }
-                std::string return_str = "[\n";
-                for(int i = 0; i < _double_vec.size(); i++) {
-                    if(i != 0) {
-                        return_str += ",\n";
-                    }
-                    return_str += get_indent_spaces(indent_+1);
-                    return_str += std::to_string(_double_vec[i]);
-                }
-                return_str += "\n";
-                return_str += get_indent_spaces(indent_) + "]";
-                return return_str;
-            }
-            ThrowNotImplemented();
-        }
-
+        friend class JsonParser;
     public:
         Json& operator=(std::string other) {
-            _str = other;
+            _str = std::move(other);
             _type = json_type_index::STR;
             return *this;
         }
         Json& operator=(std::vector<double> other) {
-            _double_vec = other;
+            _double_vec = std::move(other);
             _type = json_type_index::DOUBLE_VEC;
             return *this;
         }
-        std::string to_string() {
-            return _to_string(0);
+        Json& operator=(std::vector<Json> other) {
+            _array = std::move(other);
+            _type = json_type_index::ARRAY;
+            return *this;
+        }
+        Json& operator=(double other) {
+            _double = other;
+            _type = json_type_index::DOUBLE;
+            return *this;
+        }
+
+        /**
+         * Write the json to the writer, without making any copies of the content
+        */
+        void write(JsonWriter& writer) const {
+            if(_type == json_type_index::DICT) {
+                writer.begin_object();
+                for(auto i = _dict.begin(); i != _dict.end(); ++i) {
+                    writer.key(i->first);
+                    i->second.write(writer);
+                }
+                writer.end_object();
+            }
+            else if(_type == json_type_index::STR) {
+                writer.value(_str);
+            }
+            else if(_type == json_type_index::DOUBLE_VEC) {
+                writer.value(_double_vec);
+            }
+            else if(_type == json_type_index::DOUBLE) {
+                writer.value(_double);
+            }
+            else if(_type == json_type_index::ARRAY) {
+                writer.begin_array();
+                for(size_t i = 0; i < _array.size(); i++) {
+                    _array[i].write(writer);
+                }
+                writer.end_array();
+            }
+        }
+        void write(std::ostream& output, bool indented = true) const {
+            JsonWriter writer = JsonWriter(output, indented);
+            write(writer);
+        }
+        std::string to_string(bool indented = true) const {
+            std::ostringstream output;
+            write(output, indented);
+            return output.str();
         }
 
         Json& operator[](std::string key) {
             if(_type != json_type_index::DICT) {
                 ThrowError("Cannot index wrong json type!");
             }
-            if (_dict.find(key) == _dict.end()) {
-                _dict[key] = Json();
-            }
             return _dict[key];
-            ThrowNotImplemented();
         }
+
+        json_type_index get_type() const {
+            return _type;
+        }
+        bool contains(const std::string& key) const {
+            return _type == json_type_index::DICT && _dict.find(key) != _dict.end();
+        }
+        const Json& at(const std::string& key) const {
+            if(_type != json_type_index::DICT) {
+                ThrowError("Cannot index wrong json type!");
+            }
+            auto found = _dict.find(key);
+            if(found == _dict.end()) {
+                ThrowError("Json has no key " << key);
+            }
+            return found->second;
+        }
+        const std::map<std::string, Json>& get_dict() const {
+            if(_type != json_type_index::DICT) {
+                ThrowError("Json is not a dict!");
+            }
+            return _dict;
+        }
+        const std::string& get_string() const {
+            if(_type != json_type_index::STR) {
+                ThrowError("Json is not a string!");
+            }
+            return _str;
+        }
+        double get_double() const {
+            if(_type != json_type_index::DOUBLE) {
+                ThrowError("Json is not a number!");
+            }
+            return _double;
+        }
+        const std::vector<double>& get_double_vec() const {
+            if(_type != json_type_index::DOUBLE_VEC) {
+                ThrowError("Json is not a number array!");
+            }
+            return _double_vec;
+        }
+        // Arrays that only contain numbers are stored as a double vec instead, see get_double_vec
+        const std::vector<Json>& get_array() const {
+            if(_type != json_type_index::ARRAY) {
+                ThrowError("Json is not an array!");
+            }
+            return _array;
+        }
+
+        static Json parse(const char* begin, const char* end);
+        static Json parse(const std::string& str) {
+            return parse(str.data(), str.data() + str.size());
+        }
+    };
+
+    /**
+     * Find where the json number at begin ends, following the json number grammar:
+     *  an optional '-', then 0 or digits not starting with 0, then an optional fraction and exponent
+     * @return begin if it is not a json number, e.g. "nan", "inf", ".5" or "1."
+    */
+    inline const char* get_number_end(const char* begin, const char* end) {
+        auto is_digit = [&](const char* pos) {
+            return pos != end && *pos >= '0' && *pos <= '9';
+        };
+        const char* pos = begin;
+        if(pos != end && *pos == '-') {
+            pos++;
+        }
+        if(!is_digit(pos)) {
+            return begin;
+        }
+        if(*pos == '0') {
+            pos++;
+        }
+        else {
+            while(is_digit(pos)) {
+                pos++;
+            }
+        }
+        if(pos != end && *pos == '.') {
+            pos++;
+            if(!is_digit(pos)) {
+                return begin;
+            }
+            while(is_digit(pos)) {
+                pos++;
+            }
+        }
+        if(pos != end && (*pos == 'e' || *pos == 'E')) {
+            pos++;
+            if(pos != end && (*pos == '+' || *pos == '-')) {
+                pos++;
+            }
+            if(!is_digit(pos)) {
+                return begin;
+            }
+            while(is_digit(pos)) {
+                pos++;
+            }
+        }
+        return pos;
+    }
+
+    /**
+     * Get what a json number that does not fit in a double is rounded to, +-inf if it is too large and +-0 if it is too small
+     *  The number has to follow the json grammar, see get_number_end
+    */
+    inline double get_out_of_range_number(const char* begin, const char* end) {
+        const char* pos = begin;
+        bool negative = *pos == '-';
+        if(negative) {
+            pos++;
+        }
+        // The number is at least 10^(power - 1) and less than 10^power, before the exponent is added
+        long long power = 0;
+        bool found_non_zero = false;
+        bool in_fraction = false;
+        for(; pos != end && *pos != 'e' && *pos != 'E'; pos++) {
+            if(*pos == '.') {
+                in_fraction = true;
+            }
+            else if(!in_fraction && (found_non_zero || *pos != '0')) {
+                found_non_zero = true;
+                power += 1;
+            }
+            else if(in_fraction && !found_non_zero) {
+                if(*pos == '0') {
+                    power -= 1;
+                }
+                else {
+                    found_non_zero = true;
+                }
+            }
+        }
+        long long exponent = 0;
+        if(pos != end) {
+            pos++; // Skip the e
+            bool negative_exponent = *pos == '-';
+            if(*pos == '-' || *pos == '+') {
+                pos++;
+            }
+            for(; pos != end; pos++) {
+                exponent = std::min(exponent * 10 + (*pos - '0'), 1000000000LL); // Far out of range already
+            }
+            if(negative_exponent) {
+                exponent = -exponent;
+            }
+        }
+        double value = 0;
+        if(found_non_zero && power + exponent > 0) {
+            value = std::numeric_limits<double>::infinity();
+        }
+        return negative ? -value : value;
+    }
+
+    /**
+     * Thrown by Json::parse when the text is not valid json
+    */
+    class JsonParseError : public std::runtime_error {
+    public:
+        size_t offset; // Where in the text the error was found
+        JsonParseError(const std::string& message, size_t offset_)
+            : std::runtime_error(message + " at offset " + std::to_string(offset_)), offset(offset_) {}
     };
+
+    /**
+     * Reads json text into a Json in a single pass, without any separate tokenizing step
+     *  Arrays that only contain numbers are read straight into a double vec, without a Json for each number
+     *  Strings without escape characters are copied once, straight from the text
+     *  true, false and null are read as the numbers 1, 0 and nan
+    */
+    class JsonParser {
+        const char* _begin;
+        const char* _pos;
+        const char* _end;
+
+        void _skip_whitespace() {
+            while(_pos != _end && (*_pos == ' ' || *_pos == '\n' || *_pos == '\r' || *_pos == '\t')) {
+                _pos++;
+            }
+        }
+        char _peek() {
+            _skip_whitespace();
+            if(_pos == _end) {
+                _throw_error("Unexpected end of json");
+            }
+            return *_pos;
+        }
+        void _expect(char c) {
+            if(_peek() != c) {
+                _throw_error(std::string("Expected '") + c + "'");
+            }
+            _pos++;
+        }
+        void _throw_error(const std::string& message) {
+            throw JsonParseError(message, _pos - _begin);
+        }
+        // Numbers, and the literals that are read as numbers
+        bool _is_number_start(char c) {
+            return c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n';
+        }
+        double _parse_number() {
+            static const char* literals[] = {"true", "false", "null"};
+            static const double literal_values[] = {1.0, 0.0, std::numeric_limits<double>::quiet_NaN()};
+            if(*_pos == 't' || *_pos == 'f' || *_pos == 'n') {
+                for(int i = 0; i < 3; i++) {
+                    size_t length = std::strlen(literals[i]);
+                    if((size_t)(_end - _pos) >= length && std::memcmp(_pos, literals[i], length) == 0) {
+                        _pos += length;
+                        return literal_values[i];
+                    }
+                }
+                _throw_error("Invalid literal");
+            }
+            // from_chars also reads e.g. nan, inf and 1., so check the json grammar first
+            const char* number_end = get_number_end(_pos, _end);
+            if(number_end == _pos) {
+                _throw_error("Invalid number");
+            }
+            double number = 0;
+            std::from_chars_result result = std::from_chars(_pos, number_end, number);
+            if(result.ec == std::errc::result_out_of_range && result.ptr == number_end) {
+                number = get_out_of_range_number(_pos, number_end); // Still valid json, e.g. 1e400
+            }
+            else if(result.ec != std::errc() || result.ptr != number_end) {
+                _throw_error("Invalid number");
+            }
+            _pos = number_end;
+            return number;
+        }
+        void _append_utf8(std::string& str, uint32_t code_point) {
+            if(code_point < 0x80) {
+                str += (char)code_point;
+            }
+            else if(code_point < 0x800) {
+                str += (char)(0xC0 | (code_point >> 6));
+                str += (char)(0x80 | (code_point & 0x3F));
+            }
+            else if(code_point < 0x10000) {
+                str += (char)(0xE0 | (code_point >> 12));
+                str += (char)(0x80 | ((code_point >> 6) & 0x3F));
+                str += (char)(0x80 | (code_point & 0x3F));
+            }
+            else {
+                str += (char)(0xF0 | (code_point >> 18));
+                str += (char)(0x80 | ((code_point >> 12) & 0x3F));
+                str += (char)(0x80 | ((code_point >> 6) & 0x3F));
+                str += (char)(0x80 | (code_point & 0x3F));
+            }
+        }
+        uint32_t _parse_hex4() {
+            uint32_t value = 0;
+            std::from_chars_result result = std::from_chars(_pos, std::min(_pos + 4, _end), value, 16);
+            if(result.ec != std::errc() || result.ptr != _pos + 4) {
+                _throw_error("Invalid unicode escape");
+            }
+            _pos += 4;
+            return value;
+        }
+        void _parse_string(std::string& str) {
+            _expect('"');
+            const char* start = _pos;
+            while(_pos != _end && *_pos != '"' && *_pos != '\\') {
+                _pos++;
+            }
+            str.assign(start, _pos); // The common case, no escape characters
+            while(_pos != _end && *_pos == '\\') {
+                _pos++;
+                if(_pos == _end) {
+                    break;
+                }
+                char c = *_pos++;
+                if(c == 'n') str += '\n';
+                else if(c == 't') str += '\t';
+                else if(c == 'r') str += '\r';
+                else if(c == 'b') str += '\b';
+                else if(c == 'f') str += '\f';
+                else if(c == 'u') {
+                    uint32_t code_point = _parse_hex4();
+                    if(code_point >= 0xD800 && code_point < 0xDC00 && _end - _pos >= 6 && _pos[0] == '\\' && _pos[1] == 'u') {
+                        _pos += 2;
+                        code_point = 0x10000 + ((code_point - 0xD800) << 10) + (_parse_hex4() - 0xDC00);
+                    }
+                    _append_utf8(str, code_point);
+                }
+                else str += c; // '"', '\\' and '/'
+                start = _pos;
+                while(_pos != _end && *_pos != '"' && *_pos != '\\') {
+                    _pos++;
+                }
+                str.append(start, _pos);
+            }
+            if(_pos == _end) {
+                _throw_error("Unterminated string");
+            }
+            _pos++;
+        }
+        void _parse_array(Json& json) {
+            _expect('[');
+            json._type = json_type_index::DOUBLE_VEC;
+            if(_peek() == ']') {
+                _pos++;
+                return;
+            }
+            while(true) {
+                if(json._type == json_type_index::DOUBLE_VEC && _is_number_start(_peek())) {
+                    json._double_vec.push_back(_parse_number());
+                }
+                else {
+                    if(json._type == json_type_index::DOUBLE_VEC) {
+                        // Not only numbers after all, move the numbers read so far into the array
+                        json._type = json_type_index::ARRAY;
+                        json._array.resize(json._double_vec.size());
+                        for(size_t i = 0; i < json._double_vec.size(); i++) {
+                            json._array[i] = json._double_vec[i];
+                        }
+                        json._double_vec.clear();
+                    }
+                    json._array.emplace_back();
+                    _parse_value(json._array.back());
+                }
+                if(_peek() == ']') {
+                    _pos++;
+                    return;
+                }
+                _expect(',');
+            }
+        }
+        void _parse_object(Json& json) {
+            _expect('{');
+            json._type = json_type_index::DICT;
+            if(_peek() == '}') {
+                _pos++;
+                return;
+            }
+            std::string key;
+            while(true) {
+                _parse_string(key);
+                _expect(':');
+                _parse_value(json._dict[key]);
+                if(_peek() == '}') {
+                    _pos++;
+                    return;
+                }
+                _expect(',');
+            }
+        }
+        void _parse_value(Json& json) {
+            char c = _peek();
+            if(c == '{') {
+                _parse_object(json);
+            }
+            else if(c == '[') {
+                _parse_array(json);
+            }
+            else if(c == '"') {
+                _parse_string(json._str);
+                json._type = json_type_index::STR;
+            }
+            else if(_is_number_start(c)) {
+                json._double = _parse_number();
+                json._type = json_type_index::DOUBLE;
+            }
+            else {
+                _throw_error(std::string("Unexpected character '") + c + "'");
+            }
+        }
+    public:
+        JsonParser(const char* begin, const char* end) {
+            _begin = begin;
+            _pos = begin;
+            _end = end;
+        }
+        Json parse() {
+            Json json;
+            _parse_value(json);
+            _skip_whitespace();
+            if(_pos != _end) {
+                _throw_error("Unexpected text after json");
+            }
+            return json;
+        }
+    };
+
+    inline Json Json::parse(const char* begin, const char* end) {
+        return JsonParser(begin, end).parse();
+    }
 }
+TestWrapper(TEST_Json_to_string,
+    void test() {
+        json::Json j = json::Json();
+        j["b"] = std::vector<double>({1, 0.1 + 0.2, -2.5e-300});
+        j["a"] = std::string("quote\" newline\n");
+        j["c"]["d"] = 3.0;
+        j["e"] = std::vector<double>();
+        std::string expected = "{\"a\":\"quote\\\" newline\\n\",\"b\":[1,0.30000000000000004,-2.5e-300],\"c\":{\"d\":3},\"e\":[]}";
+        Assert(j.to_string(false) == expected);
+
+        std::string expected_indented = 
+            "{\n"
+            "    \"a\":\"quote\\\" newline\\n\",\n"
+            "    \"b\":[\n"
+            "        1,\n"
+            "        0.30000000000000004,\n"
+            "        -2.5e-300\n"
+            "    ],\n"
+            "    \"c\":{\n"
+            "        \"d\":3\n"
+            "    },\n"
+            "    \"e\":[]\n"
+            "}";
+        Assert(j.to_string() == expected_indented);
+    }
+);
+
+TestWrapper(TEST_Json_parse,
+    void test() {
+        std::string text = "{\"cubes\": [{\"mass_kg\": 10, \"position_m\": [0.1, -2e3, 3]}, {}],"
+            " \"name\": \"tab\\t \\u00e5\", \"numbers\": [1, 2, \"three\"], \"sleeping\": true, \"empty\": []}";
+        json::Json j = json::Json::parse(text);
+        Assert(j.at("cubes").get_array().size() == 2);
+        const json::Json& cube = j.at("cubes").get_array()[0];
+        Assert(cube.at("mass_kg").get_double() == 10);
+        Assert(cube.at("position_m").get_double_vec() == std::vector<double>({0.1, -2e3, 3}));
+        Assert(j.at("cubes").get_array()[1].get_dict().size() == 0);
+        Assert(j.at("name").get_string() == "tab\t \xc3\xa5");
+        Assert(j.at("numbers").get_array()[1].get_double() == 2);
+        Assert(j.at("numbers").get_array()[2].get_string() == "three");
+        Assert(j.at("sleeping").get_double() == 1);
+        Assert(j.at("empty").get_double_vec().size() == 0);
+        Assert(!j.contains("missing"));
+
+        // Writing and reading again should give back exactly the same json
+        json::Json doubles = json::Json();
+        doubles["values"] = std::vector<double>({0.1 + 0.2, 1.0 / 3, 1e-310, -123456789.123456789});
+        std::string written = doubles.to_string(false);
+        Assert(json::Json::parse(written).to_string(false) == written);
+        Assert(json::Json::parse(written).at("values").get_double_vec()[1] == 1.0 / 3);
+
+        // Only the json number grammar is accepted
+        auto is_number = [](const char* text) {
+            const char* text_end = text + std::strlen(text);
+            return json::get_number_end(text, text_end) == text_end;
+        };
+        Assert(is_number("0") && is_number("-0") && is_number("12") && is_number("-1.5"));
+        Assert(is_number("2e8") && is_number("3.25E-2") && is_number("1e+3"));
+        Assert(!is_number("nan") && !is_number("inf") && !is_number("-infinity") && !is_number("+1"));
+        Assert(!is_number(".5") && !is_number("1.") && !is_number("-") && !is_number("1e") && !is_number("1e+"));
+        Assert(!is_number("0x10") && !is_number("01"));
+        Assert(json::Json::parse("[3.25E-2, -0]").get_double_vec()[0] == 3.25e-2);
+
+        // Numbers that do not fit in a double are rounded to 0 or infinity
+        Assert(json::Json::parse("{\"a\":1e-400}").at("a").get_double() == 0);
+        Assert(json::Json::parse("{\"a\":[1e400]}").at("a").get_double_vec()[0] == std::numeric_limits<double>::infinity());
+        Assert(json::Json::parse("[-1e400]").get_double_vec()[0] == -std::numeric_limits<double>::infinity());
+        Assert(std::signbit(json::Json::parse("[-0.0001e-400]").get_double_vec()[0]));
+        Assert(json::Json::parse("[0.00001e-320]").get_double_vec()[0] == 0);
+        Assert(json::Json::parse("[12345e306]").get_double_vec()[0] == std::numeric_limits<double>::infinity());
+
+        // Invalid json throws an error that tells where the problem is
+        auto get_error_offset = [](const std::string& text) {
+            try {
+                json::Json::parse(text);
+            }
+            catch(const json::JsonParseError& error) {
+                return (int)error.offset;
+            }
+            return -1;
+        };
+        Assert(get_error_offset("[1,") == 3);
+        Assert(get_error_offset("[1,]") == 3);
+        Assert(get_error_offset("{\"a\" 1}") == 5);
+        Assert(get_error_offset("[tru]") == 1);
+        Assert(get_error_offset("[nan]") == 1);
+        Assert(get_error_offset("") == 0);
+        Assert(get_error_offset("[1] 2") == 4);
+        Assert(get_error_offset("[1e400]") == -1);
+    }
+);
 }
\ No newline at end of file
@@ -1,6 +1,10 @@
 #include "L4_file_access.h"
 
 #include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+#include <deque>
 
 namespace vicmil {
 /*long long get_time_since_epoch_ms() {
@@ -10,6 +14,267 @@ namespace vicmil {
     return ms.count();
 }*/
 
+/**
+ * Get the time in seconds since some unspecified point in time
+ * Uses a monotonic clock, so the difference between two calls can be used to time things
+*/
+inline double get_steady_time_s() {
+    std::chrono::duration<double> time_s = std::chrono::steady_clock::now().time_since_epoch();
+    return time_s.count();
+}
+
+/**
+ * Turns the time that passes between frames into a whole number of fixed time steps
+ *  The time that is left over is saved to the next frame, so on average the steps keep up with the real time
+ *  If a frame takes too long, only max_steps_per_update steps are run and the rest of the time is dropped,
+ *  otherwise a slow frame would cause even more steps the next frame
+*/
+class FixedTimestepAccumulator {
+    double _accumulated_time_s = 0;
+public:
+    double time_step_s = 1.0 / 60;
+    int max_steps_per_update = 8;
+
+    FixedTimestepAccumulator() {}
+    FixedTimestepAccumulator(double time_step_s_, int max_steps_per_update_) {
+        time_step_s = time_step_s_;
+        max_steps_per_update = max_steps_per_update_;
+    }
+
+    /**
+     * Add the time that has passed since the last call
+     * @return How many time steps should be run
+    */
+    int add_time(double elapsed_time_s) {
+        _accumulated_time_s += elapsed_time_s;
+        int step_count = (int)(_accumulated_time_s / time_step_s);
+        if(step_count > max_steps_per_update) {
+            step_count = max_steps_per_update;
+            _accumulated_time_s = time_step_s * step_count;
+        }
+        _accumulated_time_s -= time_step_s * step_count;
+        return step_count;
+    }
+
+    /**
+     * How far it is between the last step and the next one, between 0 and 1
+     *  Use it to draw the objects between their last two states
+    */
+    double get_interpolation_factor() const {
+        return _accumulated_time_s / time_step_s;
+    }
+};
+TestWrapper(TEST_FixedTimestepAccumulator,
+    void test() {
+        FixedTimestepAccumulator accumulator = FixedTimestepAccumulator(0.01, 4);
+        Assert(accumulator.add_time(0.025) == 2);
+        Assert(abs(accumulator.get_interpolation_factor() - 0.5) < 0.000001);
+        Assert(accumulator.add_time(0.006) == 1);
+        Assert(abs(accumulator.get_interpolation_factor() - 0.1) < 0.000001);
+
+        // A very slow frame only gives max_steps_per_update steps, and the rest is dropped
+        Assert(accumulator.add_time(1.0) == 4);
+        Assert(accumulator.get_interpolation_factor() < 0.000001);
+    }
+);
+
+inline int64_t get_steady_time_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Counts how many times each duration has happened, to get percentiles without storing every value
+ *  The buckets are exact up to 64ns, and then each power of two is split into 32 buckets,
+ *  so a percentile is never more than about 3% off
+*/
+class LatencyHistogram {
+    static const int _SUB_BUCKET_BITS = 5;
+    static const int _SUB_BUCKET_COUNT = 1 << _SUB_BUCKET_BITS;
+    static const int _EXACT_BUCKET_COUNT = 2 * _SUB_BUCKET_COUNT;
+
+    std::vector<uint64_t> _bucket_counts;
+    uint64_t _count = 0;
+    uint64_t _min_ns = 0;
+    uint64_t _max_ns = 0;
+    double _sum_ns = 0;
+
+    static int _get_highest_bit(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - __builtin_clzll(value);
+#else
+        int highest_bit = 0;
+        while(value >>= 1) {
+            highest_bit++;
+        }
+        return highest_bit;
+#endif
+    }
+    static int _get_bucket_index(uint64_t value_ns) {
+        if(value_ns < _EXACT_BUCKET_COUNT) {
+            return value_ns;
+        }
+        int shift = _get_highest_bit(value_ns) - _SUB_BUCKET_BITS;
+        return _EXACT_BUCKET_COUNT + (shift - 1) * _SUB_BUCKET_COUNT + (int)(value_ns >> shift) - _SUB_BUCKET_COUNT;
+    }
+    // The largest value that goes into the bucket
+    static uint64_t _get_bucket_max_ns(int bucket_index) {
+        if(bucket_index < _EXACT_BUCKET_COUNT) {
+            return bucket_index;
+        }
+        int shift = (bucket_index - _EXACT_BUCKET_COUNT) / _SUB_BUCKET_COUNT + 1;
+        uint64_t top_bits = (bucket_index - _EXACT_BUCKET_COUNT) % _SUB_BUCKET_COUNT + _SUB_BUCKET_COUNT;
+        return ((top_bits + 1) << shift) - 1;
+    }
+public:
+    void record_ns(int64_t duration_ns) {
+        uint64_t value_ns = duration_ns > 0 ? duration_ns : 0;
+        int bucket_index = _get_bucket_index(value_ns);
+        if(bucket_index >= _bucket_counts.size()) {
+            _bucket_counts.resize(bucket_index + 1, 0);
+        }
+        _bucket_counts[bucket_index] += 1;
+        _min_ns = _count == 0 ? value_ns : std::min(_min_ns, value_ns);
+        _max_ns = std::max(_max_ns, value_ns);
+        _sum_ns += value_ns;
+        _count += 1;
+    }
+    uint64_t get_count() const {
+        return _count;
+    }
+    double get_min_s() const {
+        return _min_ns / 1e9;
+    }
+    double get_max_s() const {
+        return _max_ns / 1e9;
+    }
+    double get_mean_s() const {
+        return _count == 0 ? 0 : _sum_ns / _count / 1e9;
+    }
+    /**
+     * @param percentile Between 0 and 100, e.g. 99 gives the time that 99% of the values are below
+    */
+    double get_percentile_s(double percentile) const {
+        if(_count == 0) {
+            return 0;
+        }
+        uint64_t target_count = std::max<uint64_t>(1, (uint64_t)std::ceil(_count * percentile / 100.0));
+        uint64_t count = 0;
+        for(int i = 0; i < _bucket_counts.size(); i++) {
+            count += _bucket_counts[i];
+            if(count >= target_count) {
+                return std::min(std::max(_get_bucket_max_ns(i), _min_ns), _max_ns) / 1e9;
+            }
+        }
+        return get_max_s();
+    }
+    void clear() {
+        *this = LatencyHistogram();
+    }
+};
+
+/**
+ * A latency histogram for each named phase of some work, e.g. the phases of a physics step
+ *  Get the index of each phase before timing it from several threads, adding a phase is not thread safe
+ *  Different phases can be timed from different threads at the same time
+*/
+class PhaseStatistics {
+    std::vector<std::string> _names;
+    std::deque<LatencyHistogram> _histograms; // A deque so the histograms never move when a phase is added
+public:
+    bool enabled = true;
+
+    // Get the index of a phase, the phase is added if it does not exist
+    int get_phase_index(const std::string& name) {
+        for(int i = 0; i < _names.size(); i++) {
+            if(_names[i] == name) {
+                return i;
+            }
+        }
+        _names.push_back(name);
+        _histograms.push_back(LatencyHistogram());
+        return _names.size() - 1;
+    }
+    LatencyHistogram& get_histogram(int phase_index) {
+        return _histograms[phase_index];
+    }
+    // Returns nullptr if the phase has never been timed
+    const LatencyHistogram* find_histogram(const std::string& name) const {
+        for(int i = 0; i < _names.size(); i++) {
+            if(_names[i] == name) {
+                return &_histograms[i];
+            }
+        }
+        return nullptr;
+    }
+    const std::vector<std::string>& get_phase_names() const {
+        return _names;
+    }
+    void clear() {
+        for(int i = 0; i < _histograms.size(); i++) {
+            _histograms[i].clear();
+        }
+    }
+    /**
+     * Write a table with the count and latencies in milliseconds of each phase
+    */
+    void write_summary(std::ostream& output) const {
+        output << "phase                         count     p50_ms     p99_ms     max_ms    mean_ms\n";
+        for(int i = 0; i < _names.size(); i++) {
+            const LatencyHistogram& histogram = _histograms[i];
+            char line[160];
+            std::snprintf(line, sizeof(line), "%-26s %8llu %10.4f %10.4f %10.4f %10.4f\n", _names[i].c_str(), 
+                (unsigned long long)histogram.get_count(), histogram.get_percentile_s(50) * 1000, 
+                histogram.get_percentile_s(99) * 1000, histogram.get_max_s() * 1000, histogram.get_mean_s() * 1000);
+            output << line;
+        }
+    }
+};
+
+/**
+ * Adds the time from when it is created until it goes out of scope to a phase
+*/
+class ScopedPhaseTimer {
+    LatencyHistogram* _histogram = nullptr;
+    int64_t _start_ns = 0;
+public:
+    ScopedPhaseTimer(PhaseStatistics& statistics, int phase_index) {
+        if(statistics.enabled) {
+            _histogram = &statistics.get_histogram(phase_index);
+            _start_ns = get_steady_time_ns();
+        }
+    }
+    ScopedPhaseTimer(PhaseStatistics& statistics, const std::string& phase_name) :
+        ScopedPhaseTimer(statistics, statistics.get_phase_index(phase_name)) {}
+    ~ScopedPhaseTimer() {
+        if(_histogram) {
+            _histogram->record_ns(get_steady_time_ns() - _start_ns);
+        }
+    }
+    ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+    ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+};
+TestWrapper(TEST_LatencyHistogram_percentiles,
+    void test() {
+        LatencyHistogram histogram;
+        for(int i = 1; i <= 1000; i++) {
+            histogram.record_ns(i * 1000); // 1us to 1ms
+        }
+        Assert(histogram.get_count() == 1000);
+        Assert(abs(histogram.get_percentile_s(50) - 500e-6) < 500e-6 * 0.035);
+        Assert(abs(histogram.get_percentile_s(99) - 990e-6) < 990e-6 * 0.035);
+        Assert(histogram.get_percentile_s(100) == histogram.get_max_s());
+        Assert(histogram.get_max_s() == 1000e-6);
+        Assert(histogram.get_min_s() == 1e-6);
+        Assert(abs(histogram.get_mean_s() - 500.5e-6) < 1e-12);
+
+        // Small values are exact
+        LatencyHistogram small_histogram;
+        small_histogram.record_ns(3);
+        small_histogram.record_ns(40);
+        Assert(small_histogram.get_percentile_s(50) == 3e-9);
+    }
+);
+
 #ifdef __unix__
 # include <unistd.h>
 #elif defined _WIN32
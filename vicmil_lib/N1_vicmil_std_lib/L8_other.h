@@ -1,4 +1,5 @@
 #include "L7_vector.h"
+#include "heap_allocation_count.h"
 
 namespace vicmil {
     /**
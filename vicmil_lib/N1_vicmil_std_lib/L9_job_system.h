@@ -0,0 +1,333 @@
+#pragma once
+#include "L8_other.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <deque>
+
+namespace vicmil {
+/**
+ * A piece of work that can be run on any thread, once all the jobs it depends on are finished
+*/
+class Job {
+    friend class JobSystem;
+    std::function<void()> _func;
+    std::atomic<int> _remaining_dependencies;
+    std::mutex _mutex; // Protects _finished_locked and _dependents
+    bool _finished_locked = false;
+    std::vector<std::shared_ptr<Job>> _dependents; // Jobs waiting for this job to finish
+    std::atomic<bool> _finished;
+public:
+    Job() {
+        _remaining_dependencies = 0;
+        _finished = false;
+    }
+    bool is_finished() const {
+        return _finished;
+    }
+};
+typedef std::shared_ptr<Job> JobHandle;
+
+/**
+ * A fixed number of threads that run jobs
+ *  Each thread has its own queue of jobs. New jobs are added to the queue of the thread that created them,
+ *  and a thread that runs out of jobs steals from the other queues.
+ *  Threads that wait for a job help out by running other jobs in the meantime
+ *  With a thread count of 1 no threads are created, and all jobs are run by the thread that waits for them
+ *  (Emscripten does not support threads unless it is compiled with pthread support)
+*/
+class JobSystem {
+    struct JobQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+    // One queue per worker thread, queue 0 is used by all threads that are not workers(e.g. the main thread)
+    std::vector<std::unique_ptr<JobQueue>> _queues;
+    std::vector<std::thread> _threads;
+
+    std::mutex _sleep_mutex;
+    std::condition_variable _work_available;
+    std::atomic<int> _queued_job_count;
+    bool _stop = false;
+
+    struct ThreadInfo {
+        JobSystem* job_system = nullptr;
+        int queue_index = 0;
+    };
+    static ThreadInfo& _get_thread_info() {
+        static thread_local ThreadInfo thread_info;
+        return thread_info;
+    }
+    int _get_current_queue_index() {
+        ThreadInfo& thread_info = _get_thread_info();
+        if(thread_info.job_system != this) {
+            return 0;
+        }
+        return thread_info.queue_index;
+    }
+
+    void _push(JobHandle job) {
+        JobQueue& queue = *_queues[_get_current_queue_index()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.push_back(job);
+        }
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _queued_job_count += 1;
+        }
+        _work_available.notify_one();
+    }
+    // Take the newest job in the threads own queue, otherwise steal the oldest job from another queue
+    bool _try_pop(JobHandle& job) {
+        int queue_index = _get_current_queue_index();
+        for(int i = 0; i < _queues.size(); i++) {
+            JobQueue& queue = *_queues[(queue_index + i) % _queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if(queue.jobs.size() == 0) {
+                continue;
+            }
+            if(i == 0) {
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+            }
+            else {
+                job = queue.jobs.front();
+                queue.jobs.pop_front();
+            }
+            _queued_job_count -= 1;
+            return true;
+        }
+        return false;
+    }
+    void _execute(JobHandle job) {
+        job->_func();
+
+        std::vector<JobHandle> dependents;
+        {
+            std::lock_guard<std::mutex> lock(job->_mutex);
+            job->_finished_locked = true;
+            dependents.swap(job->_dependents);
+        }
+        job->_finished = true;
+        for(int i = 0; i < dependents.size(); i++) {
+            if(--dependents[i]->_remaining_dependencies == 0) {
+                _push(dependents[i]);
+            }
+        }
+    }
+    void _worker_loop(int queue_index) {
+        _get_thread_info().job_system = this;
+        _get_thread_info().queue_index = queue_index;
+        while(true) {
+            JobHandle job;
+            if(_try_pop(job)) {
+                _execute(job);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(_sleep_mutex);
+            _work_available.wait(lock, [&] { return _stop || _queued_job_count > 0; });
+            if(_stop) {
+                return;
+            }
+        }
+    }
+public:
+    /**
+     * @param thread_count The total number of threads to use, including the thread waiting for the jobs
+    */
+    JobSystem(int thread_count) {
+        _queued_job_count = 0;
+        if(thread_count < 1) {
+            thread_count = 1;
+        }
+        for(int i = 0; i < thread_count; i++) {
+            _queues.push_back(std::unique_ptr<JobQueue>(new JobQueue()));
+        }
+        for(int i = 1; i < thread_count; i++) {
+            _threads.push_back(std::thread([this, i] { _worker_loop(i); }));
+        }
+    }
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(_sleep_mutex);
+            _stop = true;
+        }
+        _work_available.notify_all();
+        for(int i = 0; i < _threads.size(); i++) {
+            _threads[i].join();
+        }
+    }
+    int get_thread_count() const {
+        return _threads.size() + 1;
+    }
+
+    /**
+     * Add a job that will be run once all its dependencies are finished
+     * @return A handle that can be waited on, or used as a dependency for other jobs
+    */
+    JobHandle add_job(std::function<void()> func, const std::vector<JobHandle>& dependencies = {}) {
+        JobHandle job = std::make_shared<Job>();
+        job->_func = func;
+        job->_remaining_dependencies = 1; // Make sure the job is not started while the dependencies are added
+        for(int i = 0; i < dependencies.size(); i++) {
+            std::lock_guard<std::mutex> lock(dependencies[i]->_mutex);
+            if(!dependencies[i]->_finished_locked) {
+                dependencies[i]->_dependents.push_back(job);
+                job->_remaining_dependencies += 1;
+            }
+        }
+        if(--job->_remaining_dependencies == 0) {
+            _push(job);
+        }
+        return job;
+    }
+
+    /**
+     * Add jobs that call func(i) for every i in [0, count), once all dependencies are finished
+     *  func may be called in any order and from any thread, so it must be safe to call at the same time
+     * @param chunk_size How many iterations each job runs
+     * @return A handle that is finished when all iterations are done
+    */
+    JobHandle add_parallel_for(int count, std::function<void(int)> func, const std::vector<JobHandle>& dependencies = {}, int chunk_size = 16) {
+        std::shared_ptr<std::function<void(int)>> shared_func = std::make_shared<std::function<void(int)>>(func);
+        std::vector<JobHandle> chunk_jobs;
+        for(int start = 0; start < count; start += chunk_size) {
+            int end = std::min(start + chunk_size, count);
+            chunk_jobs.push_back(add_job([shared_func, start, end] {
+                for(int i = start; i < end; i++) {
+                    (*shared_func)(i);
+                }
+            }, dependencies));
+        }
+        if(chunk_jobs.size() == 0) {
+            return add_job([] {}, dependencies);
+        }
+        return add_job([] {}, chunk_jobs);
+    }
+
+    /**
+     * Wait for a job to finish, run other jobs in the meantime
+    */
+    void wait(const JobHandle& job) {
+        while(!job->is_finished()) {
+            JobHandle other_job;
+            if(_try_pop(other_job)) {
+                _execute(other_job);
+            }
+            else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /**
+     * Call func(i) for every i in [0, count) spread out over all threads, and wait for all calls to finish
+    */
+    void parallel_for(int count, std::function<void(int)> func, int chunk_size = 16) {
+        if(_threads.size() == 0 || count <= chunk_size) {
+            for(int i = 0; i < count; i++) {
+                func(i);
+            }
+            return;
+        }
+        wait(add_parallel_for(count, func, {}, chunk_size));
+    }
+};
+TestWrapper(TEST_JobSystem_parallel_for,
+    void test() {
+        JobSystem job_system(4);
+        Assert(job_system.get_thread_count() == 4);
+        for(int repeat = 0; repeat < 20; repeat++) {
+            std::vector<int> values = std::vector<int>(1000, 0);
+            job_system.parallel_for(values.size(), [&](int i) {
+                values[i] += i;
+            });
+            for(int i = 0; i < values.size(); i++) {
+                Assert(values[i] == i);
+            }
+        }
+    }
+);
+TestWrapper(TEST_JobSystem_dependencies,
+    /** Jobs should only start when all the jobs they depend on are done
+    */
+    void test() {
+        for(int thread_count = 1; thread_count <= 4; thread_count++) {
+            JobSystem job_system(thread_count);
+            std::vector<int> values = std::vector<int>(100, 0);
+            std::atomic<int> sum;
+            sum = 0;
+            JobHandle first = job_system.add_parallel_for(values.size(), [&](int i) { values[i] = i; }, {}, 8);
+            JobHandle second = job_system.add_parallel_for(values.size(), [&](int i) { values[i] *= 2; }, {first}, 8);
+            JobHandle third = job_system.add_job([&] {
+                // A job can also wait for other jobs
+                job_system.parallel_for(values.size(), [&](int i) { sum += values[i]; }, 8);
+            }, {second});
+            job_system.wait(third);
+            Assert(first->is_finished() && second->is_finished());
+            Assert(sum == 2 * (99 * 100 / 2));
+        }
+    }
+);
+TestWrapper(TEST_Tracer_write_chrome_trace,
+    void test() {
+        Tracer::get().clear();
+        JobSystem job_system = JobSystem(4);
+        job_system.parallel_for(100, [](int) {
+            TraceZone zone = TraceZone("test zone");
+        });
+        {
+            TraceZone zone = TraceZone("zone with \"quotes\"");
+        }
+        std::ostringstream trace;
+        Tracer::get().write_chrome_trace(trace);
+        std::string trace_str = trace.str();
+        int zone_count = 0;
+        for(size_t found = trace_str.find("\"test zone\""); found != std::string::npos; found = trace_str.find("\"test zone\"", found + 1)) {
+            zone_count++;
+        }
+        Assert(zone_count == 100);
+        Assert(trace_str.find("zone with \\\"quotes\\\"") != std::string::npos);
+        Tracer::get().clear();
+    }
+);
+TestWrapper(TEST_TraceBuffer_read_while_writing,
+    /** Events read while the thread keeps writing should never be half written, even when the buffer wraps around
+    */
+    void test() {
+        TraceBuffer buffer = TraceBuffer(16, 0);
+        std::atomic<bool> done;
+        done = false;
+        std::thread writer = std::thread([&]() {
+            for(int64_t i = 1; i <= 200000; i++) {
+                TraceEvent event;
+                event.name = (i % 2 == 0) ? "even" : "odd";
+                event.start_ns = i;
+                event.duration_ns = 2 * i;
+                buffer.add(event);
+            }
+            done = true;
+        });
+        int read_count = 0;
+        while(!done || read_count == 0) {
+            std::vector<TraceEvent> events = buffer.get_events();
+            for(int i = 0; i < events.size(); i++) {
+                Assert(events[i].duration_ns == 2 * events[i].start_ns);
+                Assert(std::string(events[i].name) == ((events[i].start_ns % 2 == 0) ? "even" : "odd"));
+                Assert(i == 0 || events[i].start_ns == events[i - 1].start_ns + 1);
+            }
+            if(read_count % 16 == 0) {
+                buffer.clear();
+            }
+            read_count++;
+        }
+        writer.join();
+        buffer.clear();
+        Assert(buffer.get_events().size() == 0);
+    }
+);
+}
\ No newline at end of file
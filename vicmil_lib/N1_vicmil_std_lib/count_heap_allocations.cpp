@@ -0,0 +1,90 @@
+/* Replaces the global operator new and delete, to count the heap allocations of the whole program
+ * Only build this file into programs that should count them, e.g. a profiling build, every allocation
+ * then costs an atomic increment. Read the count with vicmil::get_heap_allocation_count
+*/
+#include "heap_allocation_count.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+    void* allocate(std::size_t size) noexcept {
+        vicmil::_get_heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+    void* allocate_aligned(std::size_t size, std::align_val_t alignment) noexcept {
+        vicmil::_get_heap_allocation_counter().fetch_add(1, std::memory_order_relaxed);
+        std::size_t alignment_bytes = static_cast<std::size_t>(alignment);
+        // aligned_alloc needs the size to be a multiple of the alignment
+        std::size_t rounded_size = (size + alignment_bytes - 1) / alignment_bytes * alignment_bytes;
+        return std::aligned_alloc(alignment_bytes, rounded_size == 0 ? alignment_bytes : rounded_size);
+    }
+    void* allocate_or_throw(void* memory) {
+        if(!memory) {
+            throw std::bad_alloc();
+        }
+        return memory;
+    }
+}
+
+void* operator new(std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+void* operator new[](std::size_t size) {
+    return allocate_or_throw(allocate(size));
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(allocate_aligned(size, alignment));
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(allocate_aligned(size, alignment));
+}
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_aligned(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate_aligned(size, alignment);
+}
+
+// Both malloc and aligned_alloc memory is released with free
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+    std::free(memory);
+}
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(memory);
+}
@@ -0,0 +1,21 @@
+/* The number of heap allocations made by the program
+ * Kept apart from the rest of the library, so count_heap_allocations.cpp can include it without
+ * defining the library functions a second time
+*/
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace vicmil {
+    inline std::atomic<uint64_t>& _get_heap_allocation_counter() {
+        static std::atomic<uint64_t> counter = {0};
+        return counter;
+    }
+    /**
+     * The number of heap allocations made so far by all threads
+     *  They are only counted if count_heap_allocations.cpp is built into the program, otherwise it is always 0
+    */
+    inline uint64_t get_heap_allocation_count() {
+        return _get_heap_allocation_counter().load(std::memory_order_relaxed);
+    }
+}
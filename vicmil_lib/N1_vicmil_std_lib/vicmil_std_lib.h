@@ -1,2 +1,2 @@
 #pragma once
-#include "L8_other.h"
\ No newline at end of file
+#include "L9_job_system.h"
\ No newline at end of file
@@ -16,7 +16,9 @@ namespace vicmil {
         class App {
         public:
             // Add graphics setup, programs and other stuff here
-            vicmil::FrameStabilizer frame_stabilizer;
+            // Decides how many game updates to run each frame, so that the updates keep up with real time
+            vicmil::FixedTimestepAccumulator update_accumulator;
+            double last_frame_time_s = -1;
             GraphicsSetup graphics_setup;
             GPUProgram program;
             GPUProgram texture_program;
@@ -26,7 +28,7 @@ namespace vicmil {
             Camera camera;
             App() : 
             graphics_setup(GraphicsSetup::create_setup()) {
-                frame_stabilizer = FrameStabilizer(30);
+                update_accumulator = FixedTimestepAccumulator(1.0 / 30, 8);
                 
                 // Create Vertex Array Object
                 create_vertex_array_object();
@@ -70,11 +72,17 @@ namespace vicmil {
             Debug("emscripten_loop_handler");
             Debug("screen width:  " << globals::screen_width);
             if(globals::main_app != nullptr) {
-                if(globals::main_app->frame_stabilizer.get_time_to_next_frame_s() < 0) {
+                // Run as many fixed game updates as the time since the last frame covers, independent of the frame rate
+                double frame_time_s = get_steady_time_s();
+                if(globals::main_app->last_frame_time_s < 0) {
+                    globals::main_app->last_frame_time_s = frame_time_s;
+                }
+                int update_count = globals::main_app->update_accumulator.add_time(frame_time_s - globals::main_app->last_frame_time_s);
+                globals::main_app->last_frame_time_s = frame_time_s;
+                for(int i = 0; i < update_count; i++) {
                     if(globals::game_update_func.try_call() != 0) {
                         Debug("Game update func not set!");
                     }
-                    globals::main_app->frame_stabilizer.record_frame();
                 }
             }
  
@@ -93,8 +101,26 @@ namespace vicmil {
         }
         void set_game_updates_per_second(unsigned int updates_per_s) {
             if(globals::main_app != nullptr) {
-                globals::main_app->frame_stabilizer = FrameStabilizer(updates_per_s);
+                globals::main_app->update_accumulator.time_step_s = 1.0 / updates_per_s;
+            }
+        }
+        /**
+         * If the rendering is too slow to keep up, at most this many game updates are run each frame and the game slows down
+        */
+        void set_max_game_updates_per_frame(int max_updates) {
+            if(globals::main_app != nullptr) {
+                globals::main_app->update_accumulator.max_steps_per_update = max_updates;
+            }
+        }
+        /**
+         * How far the time has come between the last game update and the next one, between 0 and 1
+         *  Use it in the render function to draw objects between their last two states
+        */
+        double get_game_update_interpolation_factor() {
+            if(globals::main_app == nullptr) {
+                return 1.0;
             }
+            return globals::main_app->update_accumulator.get_interpolation_factor();
         }
         void draw2d_rect() {
             ThrowNotImplemented();